@@ -0,0 +1,75 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef CALLABLE_JOB_HPP
+#define CALLABLE_JOB_HPP
+
+#include "job.hpp"
+#include "inline_function.hpp"
+#include <optional>
+#include <exception>
+#include <type_traits>
+
+namespace adamant {
+namespace concurrency {
+
+/* Job that runs any callable, e.g. a lambda with captures, instead of an Action and its param.
+ * Callables whose captures take up to inline_size bytes are stored within the job, so nothing
+ * is heap-allocated. It is kicked and joined like any other job, and doubles as the handle to
+ * its result: get() joins it and returns whatever the callable returned, or rethrows whatever
+ * it threw. Must be destructed through its own type, and not before joining */
+template <typename Result>
+class CallableJob: public Job {
+    public:
+        static const std::size_t inline_size = 48;
+
+        template <typename Function>
+        CallableJob(Function&& function, JobPriority priority = medium):
+                Job(run, (uintptr_t) this, priority),
+                m_function([this, function = std::forward<Function>(function)]() mutable {
+                    try {
+                        if constexpr (std::is_void_v<Result>) function();
+                        else m_result.emplace(function());
+                    } catch (...) {
+                        m_exception = std::current_exception();
+                    }
+                }) {}
+
+        CallableJob(const CallableJob&) = delete;
+        CallableJob& operator=(const CallableJob&) = delete;
+
+        // Result& or void
+        std::add_lvalue_reference_t<Result> get() {
+            join();
+            if (m_exception) std::rethrow_exception(m_exception);
+            if constexpr (!std::is_void_v<Result>) return *m_result;
+        }
+
+        bool isInline() {
+            return m_function.isInline();
+        }
+
+    private:
+        // Plus the job pointer captured along with the callable
+        InlineFunction<inline_size + sizeof(void*)> m_function;
+        std::conditional_t<std::is_void_v<Result>, bool, std::optional<Result>> m_result{};
+        std::exception_ptr m_exception;
+
+        static void run(uintptr_t param) {
+            ((CallableJob*) param)->m_function();
+        }
+};
+
+template <typename Function>
+CallableJob(Function, JobPriority) -> CallableJob<std::invoke_result_t<Function&>>;
+
+template <typename Function>
+CallableJob(Function) -> CallableJob<std::invoke_result_t<Function&>>;
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
@@ -0,0 +1,173 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "counter.hpp"
+#include "fiber_pool.hpp"
+#include <mutex>
+#include <algorithm>
+#include <vector>
+
+using namespace adamant::concurrency;
+
+namespace {
+
+const unsigned int spin_rounds = 256;
+const std::size_t block_size = 64;    // Counters allocated at once when the pool runs dry
+const std::size_t cache_size = 256;   // Counters kept by each thread before giving some back
+
+/* Counters are taken from and given back to a per-thread cache, which only goes to the shared
+ * free list in whole blocks, so acquiring and releasing seldom lock anything */
+std::mutex& sharedMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<void*>& sharedFree() {
+    static std::vector<void*> free;
+    return free;
+}
+
+struct Cache {
+    std::vector<void*> free;
+    ~Cache() {
+        std::lock_guard<std::mutex> lock(sharedMutex());
+        sharedFree().insert(sharedFree().end(), free.begin(), free.end());
+    }
+};
+
+thread_local Cache t_cache;
+
+inline void spinPause() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+}  // namespace
+
+Counter* Counter::acquire(int value) {
+    std::vector<void*>& free = t_cache.free;
+    if (free.empty()) {
+        std::lock_guard<std::mutex> lock(sharedMutex());
+        std::vector<void*>& shared = sharedFree();
+        std::size_t n = std::min(block_size, shared.size());
+        free.insert(free.end(), shared.end() - n, shared.end());
+        shared.resize(shared.size() - n);
+    }
+    if (free.empty()) {
+        // Never freed, so that a late wake-up always finds the counter it was meant for
+        Counter* block = new Counter[block_size];
+        for (auto i=0; i<block_size; i++) {
+            free.push_back(&block[i]);
+        }
+    }
+    Counter* counter = (Counter*) free.back();
+    free.pop_back();
+    counter->reset(value);
+    return counter;
+}
+
+void Counter::release(Counter* counter) {
+    std::vector<void*>& free = t_cache.free;
+    free.push_back(counter);
+    if (free.size() > cache_size) {
+        std::lock_guard<std::mutex> lock(sharedMutex());
+        sharedFree().insert(sharedFree().end(), free.end() - block_size, free.end());
+        free.resize(free.size() - block_size);
+    }
+}
+
+Counter::Counter(): m_value{0}, m_waiters{closed()} {}
+
+void Counter::reset(int value) {
+    m_value.store(value, std::memory_order_relaxed);
+    m_waiters.store(value == 0 ? closed() : nullptr, std::memory_order_release);
+}
+
+void Counter::decrement() {
+    if (m_value.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    // Nothing here touches the counter after closing it, as it may be released right away
+    Waiter* waiter = m_waiters.exchange(closed(), std::memory_order_acq_rel);
+    while (waiter != nullptr) {
+        Waiter* next = waiter->next;  // The waiter may be gone once notified
+        waiter->notify(waiter);
+        waiter = next;
+    }
+}
+
+bool Counter::isDone() {
+    return m_waiters.load(std::memory_order_acquire) == closed();
+}
+
+void Counter::wait() {
+    // Most jobs that are joined are short, or already finished
+    for (auto i=0; i<spin_rounds; i++) {
+        if (isDone()) return;
+        spinPause();
+    }
+    // Let another fiber keep the worker thread busy while we wait
+    FiberPool* pool = FiberPool::current();
+    bool suspended = false;
+    if (pool != nullptr) {
+        suspended = pool->suspend();
+        // No fiber is left to take over, so run other jobs on this one meanwhile
+        while (!suspended && !isDone() && pool->help()) {}
+    }
+    if (!isDone()) {
+        if (pool != nullptr) {
+            // Lives on the fiber's stack, which is fine as unparking it happens under its mutex
+            Parker parker(true);
+            if (subscribe(&parker)) parker.park();
+        } else {
+            // Unparking ends with a futex wake-up on it, so it must outlive the wait
+            thread_local Parker t_parker(false);
+            t_parker.state.store(0, std::memory_order_relaxed);
+            if (subscribe(&t_parker)) t_parker.park();
+        }
+    }
+    if (suspended) pool->resume();
+}
+
+bool Counter::subscribe(Waiter* waiter) {
+    Waiter* head = m_waiters.load(std::memory_order_acquire);
+    do {
+        if (head == closed()) return false;
+        waiter->next = head;
+    } while (!m_waiters.compare_exchange_weak(head, waiter, std::memory_order_acq_rel,
+                                              std::memory_order_acquire));
+    return true;
+}
+
+// Never notified, only compared against
+Counter::Waiter* Counter::closed() {
+    static Waiter sentinel = {nullptr, nullptr};
+    return &sentinel;
+}
+
+Counter::Parker::Parker(bool fiber): Waiter{nullptr, unpark}, fiber{fiber}, state{0} {}
+
+void Counter::Parker::park() {
+    if (fiber) {
+        std::unique_lock<boost::fibers::mutex> lock(mutex);
+        cv.wait(lock, [this]{ return state.load(std::memory_order_acquire) == 1; });
+    } else {
+        while (state.load(std::memory_order_acquire) == 0) {
+            state.wait(0, std::memory_order_acquire);
+        }
+    }
+}
+
+void Counter::Parker::unpark(Waiter* waiter) {
+    Parker* parker = (Parker*) waiter;
+    if (parker->fiber) {
+        std::lock_guard<boost::fibers::mutex> lock(parker->mutex);
+        parker->state.store(1, std::memory_order_release);
+        parker->cv.notify_one();
+    } else {
+        parker->state.store(1, std::memory_order_release);
+        parker->state.notify_one();
+    }
+}
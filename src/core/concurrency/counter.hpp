@@ -0,0 +1,64 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef COUNTER_HPP
+#define COUNTER_HPP
+
+#include <atomic>
+#include <boost/fiber/mutex.hpp>
+#include <boost/fiber/condition_variable.hpp>
+
+namespace adamant {
+namespace concurrency {
+
+/* Completion counter of a job or group of jobs. Counting down and checking for completion are
+ * plain atomic operations; only waiters that actually have to park register themselves, and
+ * only then does completion wake anybody up. Counters come from a pool, and their memory is
+ * never given back, so a late wake-up can never touch freed memory */
+class Counter {
+    public:
+        /* Gets notified once the counter reaches 0, from the thread that brings it there. The
+         * waiter may be gone as soon as it is notified, so notify must be the last thing that
+         * touches it, and it must not touch the counter */
+        struct Waiter {
+            Waiter* next;
+            void (*notify)(Waiter* waiter);
+        };
+
+        static Counter* acquire(int value);
+        static void release(Counter* counter);
+        void reset(int value);  // Must not be waited on
+        void decrement();       // Wakes up every waiter when reaching 0
+        bool isDone();
+        /* Spins for a while, then parks until done. Within a job, parks its fiber instead,
+         * while the worker thread keeps running other jobs */
+        void wait();
+        // Returns false, without ever notifying, if the counter is already done
+        bool subscribe(Waiter* waiter);
+
+    private:
+        struct Parker: Waiter {
+            bool fiber;  // Parks a fiber on a worker thread rather than a whole thread
+            std::atomic<int> state;  // 1 when unparked
+            boost::fibers::mutex mutex;
+            boost::fibers::condition_variable cv;
+            Parker(bool fiber);
+            void park();
+            static void unpark(Waiter* waiter);
+        };
+
+        std::atomic<int> m_value;
+        /* Stack of waiters, closed once the counter reaches 0. Closing it is the last thing
+         * completion does to the counter, so it marks the counter as done */
+        std::atomic<Waiter*> m_waiters;
+        Counter();
+        static Waiter* closed();
+};
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
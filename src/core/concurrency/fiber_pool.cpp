@@ -0,0 +1,150 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "fiber_pool.hpp"
+#include "profiling.hpp"
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include <boost/fiber/operations.hpp>
+
+using namespace adamant::concurrency;
+
+static thread_local FiberPool* t_pool = nullptr;
+
+// Only the owner thread counts, so there is no need for an atomic RMW
+static inline void countSwitch(std::atomic<uint64_t>& counter) {
+#ifdef ADAMANT_PROFILING
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+#endif
+}
+
+FiberPool::FiberPool(std::size_t n_fibers, std::size_t max_fibers, std::size_t stack_size):
+        m_n_initial_fibers{std::max<std::size_t>(n_fibers, 1)},
+        m_max_fibers{std::max(m_n_initial_fibers, max_fibers)},
+        m_stacks{stack_size, m_n_initial_fibers}, m_n_runners{0}, m_n_parked{0},
+        m_stopping{false}, m_n_switches{0} {}
+
+FiberPool::~FiberPool() {
+    for (Slot* slot : m_slots) {
+        delete slot;
+    }
+}
+
+// Fibers belong to the thread that creates them, so they cannot be spawned by the constructor
+void FiberPool::run(Step step, Step help) {
+    t_pool = this;
+    m_step = step;
+    m_help = help;
+    for (auto i=0; i<m_n_initial_fibers; i++) {
+        m_idle.push_back(spawn());
+    }
+    activate();
+    // The pool may grow while we wait
+    for (auto i=0; i<m_slots.size(); i++) {
+        m_slots[i]->fiber.join();
+    }
+    t_pool = nullptr;
+}
+
+bool FiberPool::suspend() {
+    if (m_n_runners == 1 && m_idle.empty() && m_slots.size() >= m_max_fibers) return false;
+    m_n_runners--;
+    m_n_parked++;
+    if (m_n_runners == 0 && !m_stopping) activate();
+    countSwitch(m_n_switches);
+    return true;
+}
+
+void FiberPool::resume() {
+    m_n_parked--;
+    m_n_runners++;
+}
+
+bool FiberPool::help() {
+    if (!m_help()) return false;
+    if (m_n_parked > 0) {
+        countSwitch(m_n_switches);
+        boost::this_fiber::yield();
+    }
+    return true;
+}
+
+std::size_t FiberPool::getNFibers() {
+    return m_slots.size();
+}
+
+std::size_t FiberPool::getNParked() {
+    return m_n_parked;
+}
+
+uint64_t FiberPool::getNSwitches() {
+    return m_n_switches.load(std::memory_order_relaxed);
+}
+
+FiberPool* FiberPool::current() {
+    return t_pool;
+}
+
+FiberPool::Slot* FiberPool::spawn() {
+    Slot* slot = new Slot;
+    slot->active = false;
+    slot->fiber = boost::fibers::fiber(std::allocator_arg, m_stacks, &FiberPool::loop, this,
+            slot);
+    m_slots.push_back(slot);
+    return slot;
+}
+
+// Only fails while stopping, as suspend() makes the runner help when the pool is exhausted
+void FiberPool::activate() {
+    Slot* slot;
+    if (!m_idle.empty()) {
+        slot = m_idle.back();
+        m_idle.pop_back();
+    } else if (m_slots.size() < m_max_fibers) {
+        slot = spawn();
+    } else {
+        return;
+    }
+    slot->active = true;
+    m_n_runners++;
+    slot->cv.notify_one();
+}
+
+void FiberPool::stop() {
+    m_stopping = true;
+    for (Slot* slot : m_idle) {
+        slot->cv.notify_one();
+    }
+}
+
+void FiberPool::loop(Slot* slot) {
+    while (true) {
+        {
+            std::unique_lock<boost::fibers::mutex> lock(m_mutex);
+            slot->cv.wait(lock, [this, slot]{ return slot->active || m_stopping; });
+        }
+        while (!m_stopping) {
+            // A resumed fiber finished its job while another one was running the thread
+            if (m_n_runners > 1) break;
+            if (!m_step()) {
+                stop();
+                break;
+            }
+            // Give resumed fibers the chance to finish their jobs
+            if (m_n_parked > 0) {
+                countSwitch(m_n_switches);
+                boost::this_fiber::yield();
+            }
+        }
+        if (slot->active) {
+            slot->active = false;
+            m_n_runners--;
+        }
+        if (m_stopping) return;
+        m_idle.push_back(slot);
+    }
+}
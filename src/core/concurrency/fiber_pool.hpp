@@ -0,0 +1,78 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef FIBER_POOL_HPP
+#define FIBER_POOL_HPP
+
+#include <vector>
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <boost/fiber/fiber.hpp>
+#include <boost/fiber/mutex.hpp>
+#include <boost/fiber/condition_variable.hpp>
+#include <boost/fiber/pooled_fixedsize_stack.hpp>
+
+namespace adamant {
+namespace concurrency {
+
+/* Pool of long-lived fibers owned by a single worker thread. Only one fiber of the pool (the
+ * runner) executes the scheduling step at a time. When the runner is about to park, e.g. when
+ * joining an unfinished job, it hands the thread over to an idle fiber, so the core keeps
+ * running jobs. Once a parked fiber is resumed and finishes its job, it goes back to the free
+ * list. Stacks are only allocated when the pool grows, and are recycled from a free list.
+ * If every fiber is parked and the pool cannot grow anymore, the runner helps (runs other
+ * jobs on its own stack) instead of parking, so that the thread never deadlocks */
+class FiberPool {
+    public:
+        /* Runs one scheduling step; returns false when the pool must shut down. When helping,
+         * returns whether a job was run instead */
+        typedef std::function<bool()> Step;
+        FiberPool(std::size_t n_fibers, std::size_t max_fibers, std::size_t stack_size);
+        ~FiberPool();
+        /* Blocks the calling thread until the step returns false and every fiber of the pool,
+         * parked ones included, has finished */
+        void run(Step step, Step help);
+        // To be called by a fiber of the pool before parking; returns false if it must help
+        bool suspend();
+        void resume();  // To be called by a fiber of the pool once it is awake again
+        bool help();    // Runs one job on the calling fiber; returns false if there was none
+        std::size_t getNFibers();
+        std::size_t getNParked();
+        uint64_t getNSwitches();  // Times the thread went to another fiber. Any thread
+        static FiberPool* current();  // Pool of the calling thread, or nullptr
+
+    private:
+        struct Slot {
+            boost::fibers::fiber fiber;
+            boost::fibers::condition_variable cv;
+            bool active;
+        };
+
+        const std::size_t m_n_initial_fibers;
+        const std::size_t m_max_fibers;
+        boost::fibers::pooled_fixedsize_stack m_stacks;
+        std::vector<Slot*> m_slots;
+        std::vector<Slot*> m_idle;  // Free list
+        // All of the pool's fibers live on the same thread, so these need no synchronization
+        boost::fibers::mutex m_mutex;  // Only because slot condition variables require one
+        std::size_t m_n_runners;
+        std::size_t m_n_parked;
+        bool m_stopping;
+        std::atomic<uint64_t> m_n_switches;  // Only counted when profiling
+        Step m_step;
+        Step m_help;
+        Slot* spawn();
+        void activate();
+        void stop();
+        void loop(Slot* slot);
+};
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef INLINE_FUNCTION_HPP
+#define INLINE_FUNCTION_HPP
+
+#include <new>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+namespace adamant {
+namespace concurrency {
+
+/* Type-erased void() callable, such as a lambda with captures. Callables of up to Size bytes
+ * are stored inline, and only bigger ones are heap-allocated. Neither copyable nor movable, as
+ * jobs point to it */
+template <std::size_t Size>
+class InlineFunction {
+    public:
+        template <typename Function>
+        InlineFunction(Function&& function) {
+            typedef std::decay_t<Function> Callable;
+            if constexpr (fitsInline<Callable>()) {
+                m_callable = new (m_storage) Callable(std::forward<Function>(function));
+            } else {
+                m_callable = new Callable(std::forward<Function>(function));
+            }
+            m_invoke = [](void* callable) { (*(Callable*) callable)(); };
+            m_destroy = [](void* callable) {
+                if constexpr (fitsInline<Callable>()) ((Callable*) callable)->~Callable();
+                else delete (Callable*) callable;
+            };
+        }
+
+        ~InlineFunction() {
+            m_destroy(m_callable);
+        }
+
+        InlineFunction(const InlineFunction&) = delete;
+        InlineFunction& operator=(const InlineFunction&) = delete;
+
+        void operator()() {
+            m_invoke(m_callable);
+        }
+
+        bool isInline() {
+            return m_callable == (void*) m_storage;
+        }
+
+    private:
+        alignas(std::max_align_t) unsigned char m_storage[Size];
+        void* m_callable;
+        void (*m_invoke)(void* callable);
+        void (*m_destroy)(void* callable);
+
+        template <typename Callable>
+        static constexpr bool fitsInline() {
+            return sizeof(Callable) <= Size && alignof(Callable) <= alignof(std::max_align_t);
+        }
+};
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
@@ -9,18 +9,26 @@
 using namespace adamant::concurrency;
 
 Job::Job(Action* action, uintptr_t param, JobPriority priority): action{action}, param{param},
-        priority{priority} {
-    status = new JobStatus;
-    status->counter.store(1);  // To be overriden by a job batch, if the job is a part of it
+        priority{priority}, owns_status{true} {
+    status = Counter::acquire(1);  // To be overriden by a job batch, if the job is a part of it
+}
+
+Job::Job(Action* action, uintptr_t param, JobPriority priority, Counter* status):
+        status{status}, action{action}, param{param}, priority{priority}, owns_status{false} {}
+
+Job::~Job() {
+    if (owns_status) Counter::release(status);
+}
+
+void Job::share(Counter* status) {
+    if (owns_status) Counter::release(this->status);
+    this->status = status;
+    owns_status = false;
 }
 
 // TODO: what if we destruct the job scheduler before a job completes?
 void Job::join() {
-    std::unique_lock<std::mutex> lock(status->mutex);
-    if (status->counter.load() != 0) {
-        status->cv.wait(lock, [this]{ return status->counter.load() == 0; });
-    }
-    lock.unlock();
+    status->wait();
 }
 
 Action* Job::getAction() {
@@ -7,10 +7,9 @@
 #ifndef JOB_HPP
 #define JOB_HPP
 
+#include "counter.hpp"
+#include "profiling.hpp"
 #include <cstdint>
-#include <condition_variable>
-#include <mutex>
-#include <atomic>
 
 namespace adamant {
 namespace concurrency {
@@ -21,16 +20,18 @@ typedef enum JobPriority {
     low = 0, medium = 1, high = 2
 } JobPriority;
 
-typedef struct JobStatus {
-    std::mutex mutex;
-    std::condition_variable cv;
-    std::atomic<int> counter;
-} JobStatus;
-
 class Job {
     public:
-        JobStatus* status;  // It's public because of the atomic operations
+        Counter* status;  // It's public because of the atomic operations
+#ifdef ADAMANT_PROFILING
+        uint64_t kick_time;  // In ns, set by the scheduler
+#endif
         Job(Action* action, uintptr_t param, JobPriority priority);
+        /* Used by job batches, whose jobs share the batch's status. A null status makes the job
+         * detached: it cannot be joined, and its action may free it */
+        Job(Action* action, uintptr_t param, JobPriority priority, Counter* status);
+        ~Job();  // Must not be destructed before joining
+        void share(Counter* status);  // Drops the job's own status for a shared one
         void join();
         Action* getAction();
         uintptr_t getParam();
@@ -43,6 +44,7 @@ class Job {
         Action* action;
         uintptr_t param;
         JobPriority priority;
+        bool owns_status;
 };
 
 }  // namespace concurrency
@@ -10,34 +10,32 @@ using namespace adamant::concurrency;
 
 // Generic constructor
 JobBatch::JobBatch(std::vector<Job*> jobs): m_jobs{jobs} {
-    status = new JobStatus;
-    status->counter.store(m_jobs.size());
+    status = Counter::acquire(m_jobs.size());
     // Override each of the jobs' counter
     for (auto job : m_jobs) {     
-        job->status = status;
+        job->share(status);
     }
 }
 
 // SIMD constructor
 JobBatch::JobBatch(Action* action, std::vector<uintptr_t> params, JobPriority priority) {
-    status = new JobStatus;
-    status->counter.store(params.size());
+    status = Counter::acquire(params.size());
+    // The jobs live in one contiguous block, freed along with the batch
+    m_storage.reserve(params.size());
     for (auto i=0; i<params.size(); i++) {
-        Job* job = new Job(action, params[i], priority);
-        // Override each of the jobs' counter
-        job->status = status;
-        m_jobs.push_back(job);
+        m_storage.emplace_back(action, params[i], priority, status);
+        m_jobs.push_back(&m_storage.back());
     }
 }
 
+JobBatch::~JobBatch() {
+    Counter::release(status);
+}
+
 void JobBatch::join() {
-    std::unique_lock<std::mutex> lock(status->mutex);
-    if (status->counter.load() != 0) {
-        status->cv.wait(lock, [this]{ return status->counter.load() == 0; });
-    }
-    lock.unlock();
+    status->wait();
 }
 
-std::vector<Job*> JobBatch::getJobs() {
+const std::vector<Job*>& JobBatch::getJobs() {
     return m_jobs;
 }
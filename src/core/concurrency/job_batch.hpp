@@ -15,16 +15,18 @@ namespace concurrency {
 
 class JobBatch {
     public:
-        JobStatus* status;  // It's public because of the atomic operations
+        Counter* status;  // It's public because of the atomic operations
         // Generic constructor
         JobBatch(std::vector<Job*> jobs);
         // SIMD constructor
         JobBatch(Action* action, std::vector<uintptr_t> params, JobPriority priority);
+        ~JobBatch();  // Must not be destructed before joining
         void join();
-        std::vector<Job*> getJobs();
+        const std::vector<Job*>& getJobs();
 
     private:
         std::vector<Job*> m_jobs;
+        std::vector<Job> m_storage;  // Only used by the SIMD constructor
 };
 
 }  // namespace concurrency
@@ -0,0 +1,166 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "job_graph.hpp"
+#include <algorithm>
+
+using namespace adamant::concurrency;
+
+JobGraph::JobGraph(): m_sorted{true}, m_scheduler{nullptr} {
+    m_status = Counter::acquire(0);
+}
+
+JobGraph::~JobGraph() {
+    for (Node* node : m_nodes) {
+        delete node->job;
+        delete node;
+    }
+    Counter::release(m_status);
+}
+
+JobGraph::NodeId JobGraph::addJob(std::string name, Action* action, uintptr_t param,
+        JobPriority priority) {
+    Node* node = new Node;
+    node->name = name;
+    node->action = action;
+    node->param = param;
+    node->graph = this;
+    node->job = new Job(run, (uintptr_t) node, priority, m_status);
+    node->pending.store(0);
+    m_nodes.push_back(node);
+    m_sorted = false;
+    return m_nodes.size() - 1;
+}
+
+void JobGraph::addDependency(NodeId predecessor, NodeId successor) {
+    m_nodes[predecessor]->successors.push_back(successor);
+    m_nodes[successor]->predecessors.push_back(predecessor);
+    m_sorted = false;
+}
+
+// May throw CyclicGraphException
+void JobGraph::kick(JobScheduler* scheduler) {
+    if (!m_sorted) sort();
+    m_scheduler = scheduler;
+    m_status->reset(m_nodes.size());
+    for (Node* node : m_nodes) {
+        node->pending.store(node->predecessors.size());
+    }
+    m_kicked = std::chrono::steady_clock::now();
+    // Every other job is kicked by its last predecessor
+    for (Node* node : m_nodes) {
+        if (node->predecessors.empty()) scheduler->kickJob(node->job);
+    }
+}
+
+void JobGraph::join() {
+    m_status->wait();
+}
+
+float JobGraph::getWallTime() {
+    std::chrono::steady_clock::time_point last = m_kicked;
+    for (Node* node : m_nodes) {
+        if (node->end > last) last = node->end;
+    }
+    return std::chrono::duration<float, std::milli>(last - m_kicked).count();
+}
+
+float JobGraph::getCriticalPathTime() {
+    float time = 0;
+    for (NodeId id : getCriticalPath()) {
+        time += duration(m_nodes[id]);
+    }
+    return time;
+}
+
+// Longest path weighted by the time each job took, found in topological order
+std::vector<JobGraph::NodeId> JobGraph::getCriticalPath() {
+    if (!m_sorted) sort();
+    std::vector<float> finish(m_nodes.size(), 0);
+    std::vector<int> previous(m_nodes.size(), -1);
+    int last = -1;
+    for (NodeId id : m_order) {
+        Node* node = m_nodes[id];
+        for (NodeId p : node->predecessors) {
+            if (previous[id] == -1 || finish[p] > finish[previous[id]]) previous[id] = p;
+        }
+        finish[id] = duration(node) + (previous[id] == -1 ? 0 : finish[previous[id]]);
+        if (last == -1 || finish[id] > finish[last]) last = id;
+    }
+    std::vector<NodeId> path;
+    for (int id=last; id!=-1; id=previous[id]) {
+        path.push_back(id);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+void JobGraph::dump(std::ostream& out) {
+    std::vector<NodeId> critical_path = getCriticalPath();
+    std::vector<bool> critical(m_nodes.size(), false);
+    for (NodeId id : critical_path) {
+        critical[id] = true;
+    }
+    out << "digraph jobs {\n";
+    out << "    label=\"wall: " << getWallTime() << " ms, critical path: "
+        << getCriticalPathTime() << " ms\";\n";
+    out << "    node [shape=box];\n";
+    for (auto id=0; id<m_nodes.size(); id++) {
+        out << "    n" << id << " [label=\"" << m_nodes[id]->name << "\\n"
+            << duration(m_nodes[id]) << " ms\"" << (critical[id] ? ", color=red" : "")
+            << "];\n";
+    }
+    for (auto id=0; id<m_nodes.size(); id++) {
+        for (NodeId s : m_nodes[id]->successors) {
+            out << "    n" << id << " -> n" << s
+                << (critical[id] && critical[s] ? " [color=red]" : "") << ";\n";
+        }
+    }
+    out << "}\n";
+}
+
+const char* JobGraph::CyclicGraphException::what() const noexcept {
+    return "The job graph has a cycle.";
+}
+
+// Kahn's algorithm
+void JobGraph::sort() {
+    std::vector<unsigned int> n_predecessors(m_nodes.size());
+    m_order.clear();
+    for (auto id=0; id<m_nodes.size(); id++) {
+        n_predecessors[id] = m_nodes[id]->predecessors.size();
+        if (n_predecessors[id] == 0) m_order.push_back(id);
+    }
+    for (auto i=0; i<m_order.size(); i++) {
+        for (NodeId s : m_nodes[m_order[i]]->successors) {
+            if (--n_predecessors[s] == 0) m_order.push_back(s);
+        }
+    }
+    if (m_order.size() != m_nodes.size()) throw CyclicGraphException();
+    m_sorted = true;
+}
+
+float JobGraph::duration(Node* node) {
+    if (node->end < node->start) return 0;
+    return std::chrono::duration<float, std::milli>(node->end - node->start).count();
+}
+
+// Successors are kicked before the job counts as finished, so join() waits for them too
+void JobGraph::run(uintptr_t param) {
+    Node* node = (Node*) param;
+    node->start = std::chrono::steady_clock::now();
+    {
+        ADAMANT_TRACE_ZONE(node->name.c_str());
+        node->action(node->param);
+    }
+    node->end = std::chrono::steady_clock::now();
+    for (NodeId id : node->successors) {
+        Node* successor = node->graph->m_nodes[id];
+        if (successor->pending.fetch_sub(1) == 1) {
+            node->graph->m_scheduler->kickJob(successor->job);
+        }
+    }
+}
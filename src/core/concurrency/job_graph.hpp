@@ -0,0 +1,75 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef JOB_GRAPH_HPP
+#define JOB_GRAPH_HPP
+
+#include "job.hpp"
+#include "job_scheduler.hpp"
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <exception>
+
+namespace adamant {
+namespace concurrency {
+
+/* DAG of jobs. A job is kicked as a continuation of its predecessors, as soon as the last one
+ * of them finishes, so independent branches overlap across workers. The graph is built once
+ * and may be kicked again after joining, e.g. once per frame. Each run measures how long every
+ * job took, which gives the critical path of the run */
+class JobGraph {
+    public:
+        typedef unsigned int NodeId;
+        JobGraph();
+        ~JobGraph();  // Must not be destructed while running
+        NodeId addJob(std::string name, Action* action, uintptr_t param, JobPriority priority);
+        void addDependency(NodeId predecessor, NodeId successor);
+        // May throw CyclicGraphException
+        void kick(JobScheduler* scheduler);
+        void join();
+        // The following refer to the last run, and are only meaningful after joining it
+        float getWallTime();  // In ms, from kicking until the last job finished
+        float getCriticalPathTime();  // In ms
+        std::vector<NodeId> getCriticalPath();
+        // Graphviz DOT, annotated with the times of the last run and its critical path
+        void dump(std::ostream& out);
+
+        struct CyclicGraphException: public std::exception {
+            const char* what() const noexcept;
+        };
+
+    private:
+        struct Node {
+            std::string name;
+            Action* action;
+            uintptr_t param;
+            Job* job;
+            JobGraph* graph;
+            std::vector<NodeId> predecessors;
+            std::vector<NodeId> successors;
+            std::atomic<unsigned int> pending;  // Predecessors yet to finish in this run
+            std::chrono::steady_clock::time_point start;
+            std::chrono::steady_clock::time_point end;
+        };
+
+        std::vector<Node*> m_nodes;
+        std::vector<NodeId> m_order;  // Topological order
+        bool m_sorted;
+        Counter* m_status;  // Shared by every job of the graph
+        JobScheduler* m_scheduler;
+        std::chrono::steady_clock::time_point m_kicked;
+        void sort();
+        float duration(Node* node);
+        static void run(uintptr_t param);
+};
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "job_queue.hpp"
+#include <cstdint>
+
+using namespace adamant::concurrency;
+
+JobQueue::JobQueue(std::size_t capacity): m_mask{capacity - 1}, m_enqueue_pos{0},
+        m_dequeue_pos{0} {
+    m_cells = new Cell[capacity];
+    for (std::size_t i=0; i<capacity; i++) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+JobQueue::~JobQueue() {
+    delete[] m_cells;
+}
+
+bool JobQueue::push(Job* job) {
+    Cell* cell;
+    std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    while (true) {
+        cell = &m_cells[pos & m_mask];
+        std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0) {
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Full queue
+            return false;
+        } else {
+            pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->job = job;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+Job* JobQueue::pop() {
+    Cell* cell;
+    std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    while (true) {
+        cell = &m_cells[pos & m_mask];
+        std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+        if (diff == 0) {
+            if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Empty queue
+            return nullptr;
+        } else {
+            pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    Job* job = cell->job;
+    cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+    return job;
+}
+
+bool JobQueue::empty() const {
+    return m_enqueue_pos.load(std::memory_order_relaxed) <=
+           m_dequeue_pos.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,42 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef JOB_QUEUE_HPP
+#define JOB_QUEUE_HPP
+
+#include "job.hpp"
+#include <atomic>
+#include <cstddef>
+
+namespace adamant {
+namespace concurrency {
+
+/* Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's design). Used for jobs
+ * kicked from threads that are not workers, since those cannot push into a worker's deque */
+class JobQueue {
+    public:
+        JobQueue(std::size_t capacity);  // Capacity must be a power of two
+        ~JobQueue();
+        bool push(Job* job);  // Returns false if the queue is full
+        Job* pop();           // Returns nullptr if the queue is empty
+        bool empty() const;
+
+    private:
+        struct Cell {
+            std::atomic<std::size_t> sequence;
+            Job* job;
+        };
+
+        const std::size_t m_mask;
+        Cell* m_cells;
+        alignas(64) std::atomic<std::size_t> m_enqueue_pos;
+        alignas(64) std::atomic<std::size_t> m_dequeue_pos;
+};
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
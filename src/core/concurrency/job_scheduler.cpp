@@ -8,67 +8,378 @@
 #include <chrono>
 #include <thread>
 #include <vector>
-#include <future>
-#include <boost/fiber/fiber.hpp>
+#include <algorithm>
+#include <tuple>
+#include <string>
+#include <boost/fiber/operations.hpp>
 #include "job_scheduler.hpp"
+#include "task.hpp"
 
 using namespace adamant::concurrency;
 
-void JobScheduler::work(std::shared_future<void> signal) {
-    while(signal.wait_for(std::chrono::seconds(0)) == std::future_status::timeout) {
-        // Wait for a job
-        std::unique_lock<std::mutex> lock(m_mutex);
-        if (m_jobs.empty()) {
-            m_job_available.wait(lock, [this, signal]{
-                return (!m_jobs.empty()) ||
-                signal.wait_for(std::chrono::seconds(0)) != std::future_status::timeout; 
-            });
-            if (signal.wait_for(std::chrono::seconds(0)) != std::future_status::timeout) {
-                break;
+// Lets workers kick jobs straight into their own deques
+static thread_local JobScheduler* t_scheduler = nullptr;
+static thread_local unsigned int t_worker_index = 0;
+
+// Counters are only written by their owner, so there is no need for an atomic RMW
+static inline void increment(std::atomic<uint64_t>& counter, uint64_t amount = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+#ifdef ADAMANT_PROFILING
+static const char* priority_names[] = {"low", "medium", "high"};
+#endif
+
+JobScheduler::Worker::Worker(uint32_t seed): rng_state{seed}, idle_rounds{0},
+        jobs_executed{0}, jobs_stolen{0}, jobs_injected{0}, steal_attempts{0},
+        failed_steals{0}, sleeps{0} {
+    for (auto i=0; i<n_priorities; i++) {
+        deques[i] = new WorkStealingDeque(deque_capacity);
+    }
+#ifdef ADAMANT_PROFILING
+    idle = false;
+    idle_since = 0;
+    idle_time.store(0);
+    for (auto p=0; p<n_priorities; p++) {
+        for (auto& bucket : wait_latencies[p]) {
+            bucket.store(0);
+        }
+    }
+#endif
+    fiber_pool = new FiberPool(fibers_per_worker, max_fibers_per_worker, fiber_stack_size);
+}
+
+JobScheduler::Worker::~Worker() {
+    for (auto i=0; i<n_priorities; i++) {
+        delete deques[i];
+    }
+    delete fiber_pool;
+}
+
+/* Decides the number of workers and the CPUs each one runs on, and which CPUs are reserved.
+ * Returns the affinity of each worker */
+std::vector<std::vector<unsigned int>> JobScheduler::place(const SchedulerConfig& config) {
+    std::vector<Cpu> cpus = m_topology.getCpus();
+    if (config.numa_node >= 0) {
+        std::vector<Cpu> local;
+        for (const Cpu& cpu : cpus) {
+            if (cpu.node == (unsigned int) config.numa_node) local.push_back(cpu);
+        }
+        if (!local.empty()) cpus = local;
+    }
+    bool restricted = cpus.size() < m_topology.getCpus().size();
+    // Always leave at least one CPU to the workers
+    unsigned int n_reserved = std::min<std::size_t>(config.n_reserved_cpus, cpus.size() - 1);
+    std::vector<unsigned int> order;
+    if (config.pinning == explicit_cpus) {
+        if (config.cpus.empty()) throw InvalidConfigException();
+        for (unsigned int id : config.cpus) {
+            if (m_topology.getCpu(id) == nullptr) throw InvalidConfigException();
+        }
+        order = config.cpus;
+        n_reserved = 0;
+    } else {
+        std::sort(cpus.begin(), cpus.end(), [](const Cpu& a, const Cpu& b) {
+            return std::tie(a.node, a.package, a.core, a.id) <
+                   std::tie(b.node, b.package, b.core, b.id);
+        });
+        if (config.pinning == scatter) {
+            // Take the n-th sibling of every core before any (n+1)-th, alternating packages
+            std::vector<std::tuple<unsigned int, unsigned int, unsigned int, unsigned int>> keys;
+            std::vector<unsigned int> siblings(m_topology.getNCores(), 0);
+            std::vector<int> core_ranks(m_topology.getNCores(), -1);
+            std::vector<unsigned int> cores_per_package;
+            for (const Cpu& cpu : cpus) {
+                if (cpu.package >= cores_per_package.size()) {
+                    cores_per_package.resize(cpu.package + 1, 0);
+                }
+                if (core_ranks[cpu.core] == -1) {
+                    core_ranks[cpu.core] = cores_per_package[cpu.package]++;
+                }
+                keys.emplace_back(siblings[cpu.core]++, core_ranks[cpu.core], cpu.package,
+                                  cpu.id);
+            }
+            std::sort(keys.begin(), keys.end());
+            for (auto& key : keys) {
+                order.push_back(std::get<3>(key));
+            }
+        } else {
+            for (const Cpu& cpu : cpus) {
+                order.push_back(cpu.id);
+            }
+        }
+    }
+    std::vector<unsigned int> worker_cpus(order.begin() + n_reserved, order.end());
+    m_n_threads = config.n_threads > 0 ? config.n_threads : worker_cpus.size();
+    std::vector<std::vector<unsigned int>> affinities(m_n_threads);
+    if (config.pinning == unpinned) {
+        // Only kept within the preferred node, if any
+        if (restricted) {
+            for (auto& affinity : affinities) {
+                affinity = order;
             }
         }
-        // Get a job
-        Job* job = m_jobs.top();
-        m_jobs.pop();
-        lock.unlock();
-        /* Execute the job on a fiber, so that a job can sleep or wait (yield) without
-         * blocking a thread/core */
-        boost::fibers::fiber fiber(job->getAction(), job->getParam());
-        fiber.join();
-        job->status->counter.fetch_sub(1);
-        job->status->cv.notify_all();
-    }
-}
-
-// TODO: Affinity with CPU cores
-JobScheduler::JobScheduler(): m_n_cpus{std::thread::hardware_concurrency()},
-        m_n_threads{m_n_cpus - 2} {
-    std::shared_future<void> signal = m_exit_signal.get_future();
+        return affinities;
+    }
+    m_reserved_cpus.assign(order.begin(), order.begin() + n_reserved);
+    for (auto i=0; i<m_n_threads; i++) {
+        affinities[i].push_back(worker_cpus[i % worker_cpus.size()]);
+    }
+    return affinities;
+}
+
+void JobScheduler::work(unsigned int index) {
+    // Before the pool allocates any fiber stack, so that they are local to the CPU's node
+    if (!m_workers[index]->cpus.empty()) pinThisThread(m_workers[index]->cpus);
+    t_scheduler = this;
+    t_worker_index = index;
+#ifdef ADAMANT_PROFILING
+    Tracer::setThreadName("worker " + std::to_string(index));
+#endif
+    m_workers[index]->fiber_pool->run([this, index]{ return step(index); },
+                                      [this, index]{ return help(index); });
+}
+
+// Executed by whichever fiber of the worker's pool is currently running the thread
+bool JobScheduler::step(unsigned int index) {
+    if (m_exiting.load(std::memory_order_acquire)) return false;
+    Worker* worker = m_workers[index];
+    Job* job = findJob(index);
+#ifdef ADAMANT_PROFILING
+    // Sleeping counts as idle too, so it is only accounted for once a job shows up
+    if (job != nullptr && worker->idle) {
+        increment(worker->idle_time, Tracer::now() - worker->idle_since);
+        worker->idle = false;
+    } else if (job == nullptr && !worker->idle) {
+        worker->idle_since = Tracer::now();
+        worker->idle = true;
+    }
+#endif
+    if (job != nullptr) {
+        increment(worker->jobs_executed);
+        execute(job);
+        worker->idle_rounds = 0;
+    } else if (++worker->idle_rounds < spin_rounds) {
+        boost::this_fiber::yield();
+        std::this_thread::yield();
+    } else {
+        sleep(worker);
+        worker->idle_rounds = 0;
+    }
+    return true;
+}
+
+// Executed by a fiber that is joining while no other fiber of the pool can take over
+bool JobScheduler::help(unsigned int index) {
+    Worker* worker = m_workers[index];
+    Job* job = nullptr;
+    // Own jobs first, as they most likely are the ones being joined
+    for (int p=n_priorities-1; p>=0 && job == nullptr; p--) {
+        job = worker->deques[p]->pop();
+    }
+    if (job == nullptr) job = findJob(index);
+    if (job == nullptr) return false;
+    increment(worker->jobs_executed);
+    execute(job);
+    return true;
+}
+
+/* The job runs straight on the pool's fiber, so it can wait (yield) without blocking a
+ * thread/core */
+void JobScheduler::execute(Job* job) {
+#ifdef ADAMANT_PROFILING
+    uint64_t begin = Tracer::now();
+    JobPriority priority = job->getPriority();
+    uint64_t latency = begin > job->kick_time ? begin - job->kick_time : 0;
+    increment(m_workers[t_worker_index]->wait_latencies[priority][
+            LatencyHistogram::bucketOf(latency)]);
+#endif
+    // Detached jobs may be freed by their own action, so the job is not touched afterwards
+    Counter* status = job->status;
+    job->getAction()(job->getParam());
+#ifdef ADAMANT_PROFILING
+    // Before completing, so that the event is recorded by the time the job is joined
+    Tracer::record("job", priority_names[priority], begin, Tracer::now());
+#endif
+    if (status != nullptr) status->decrement();
+}
+
+// Look for jobs from the highest to the lowest priority: own deque, injected jobs, steals
+Job* JobScheduler::findJob(unsigned int index) {
+    Worker* worker = m_workers[index];
+    for (int p=n_priorities-1; p>=0; p--) {
+        Job* job = worker->deques[p]->pop();
+        if (job != nullptr) return job;
+        job = m_injection_queues[p]->pop();
+        if (job != nullptr) {
+            increment(worker->jobs_injected);
+            return job;
+        }
+        job = steal(index, p);
+        if (job != nullptr) return job;
+    }
+    return nullptr;
+}
+
+// Start at a random victim so that thieves do not all gang up on the same worker
+Job* JobScheduler::steal(unsigned int index, unsigned int priority) {
+    Worker* thief = m_workers[index];
+    thief->rng_state ^= thief->rng_state << 13;
+    thief->rng_state ^= thief->rng_state >> 17;
+    thief->rng_state ^= thief->rng_state << 5;
+    unsigned int start = thief->rng_state % m_n_threads;
     for (auto i=0; i<m_n_threads; i++) {
-        m_threads.emplace_back(&JobScheduler::work, this, signal);
+        unsigned int victim = (start + i) % m_n_threads;
+        if (victim == index) continue;
+        WorkStealingDeque* deque = m_workers[victim]->deques[priority];
+        if (deque->empty()) continue;
+        increment(thief->steal_attempts);
+        bool contended;
+        Job* job = deque->steal(contended);
+        if (job != nullptr) {
+            increment(thief->jobs_stolen);
+            return job;
+        }
+        if (contended) increment(thief->failed_steals);
+    }
+    return nullptr;
+}
+
+bool JobScheduler::hasJobs() {
+    for (auto p=0; p<n_priorities; p++) {
+        if (!m_injection_queues[p]->empty()) return true;
+        for (Worker* worker : m_workers) {
+            if (!worker->deques[p]->empty()) return true;
+        }
+    }
+    return false;
+}
+
+/* The fences in sleep() and wake() pair up, so either the sleeper sees the new job or the
+ * kicker sees the sleeper */
+void JobScheduler::sleep(Worker* worker) {
+    std::unique_lock<boost::fibers::mutex> lock(m_sleep_mutex);
+    m_n_sleeping.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!hasJobs() && !m_exiting.load(std::memory_order_acquire)) {
+        increment(worker->sleeps);
+        m_job_available.wait(lock, [this]{
+            return m_wakeups > 0 || m_exiting.load(std::memory_order_acquire);
+        });
+        if (m_wakeups > 0) m_wakeups--;
+    }
+    m_n_sleeping.fetch_sub(1);
+}
+
+void JobScheduler::wake(unsigned int n_jobs) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_n_sleeping.load(std::memory_order_relaxed) == 0) return;
+    {
+        std::lock_guard<boost::fibers::mutex> lock(m_sleep_mutex);
+        unsigned int n_sleeping = m_n_sleeping.load(std::memory_order_relaxed);
+        m_wakeups = std::min(n_sleeping, m_wakeups + std::min(n_jobs, n_sleeping));
+    }
+    if (n_jobs == 1) m_job_available.notify_one();
+    else m_job_available.notify_all();
+}
+
+void JobScheduler::push(Job* job) {
+    unsigned int priority = job->getPriority();
+    if (t_scheduler == this) {
+        m_workers[t_worker_index]->deques[priority]->push(job);
+        return;
+    }
+    while (!m_injection_queues[priority]->push(job)) {
+        // The injection queue is full, so let the workers catch up
+        wake(m_n_threads);
+        std::this_thread::yield();
+    }
+}
+
+JobScheduler::JobScheduler(): JobScheduler(SchedulerConfig()) {}
+
+// May throw InvalidConfigException
+JobScheduler::JobScheduler(const SchedulerConfig& config):
+        m_n_cpus{(unsigned int) m_topology.getCpus().size()}, m_exiting{false},
+        m_n_sleeping{0}, m_wakeups{0} {
+    std::vector<std::vector<unsigned int>> affinities = place(config);
+    for (auto p=0; p<n_priorities; p++) {
+        m_injection_queues[p] = new JobQueue(injection_capacity);
+    }
+    // All workers must exist before any thread starts stealing
+    for (auto i=0; i<m_n_threads; i++) {
+        m_workers.push_back(new Worker(i + 1));
+        m_workers[i]->cpus = affinities[i];
+    }
+    m_timers = new TimerQueue(this);
+    for (auto i=0; i<m_n_threads; i++) {
+        m_threads.emplace_back(&JobScheduler::work, this, i);
     }
 }
 
 JobScheduler::~JobScheduler() {
-    m_exit_signal.set_value();
+    // Timers would otherwise kick jobs into stopped workers
+    delete m_timers;
+    {
+        std::lock_guard<boost::fibers::mutex> lock(m_sleep_mutex);
+        m_exiting.store(true, std::memory_order_release);
+    }
     m_job_available.notify_all();
     for (auto i=0; i<m_threads.size(); i++) {
         m_threads[i].join();
     }
+    for (Worker* worker : m_workers) {
+        delete worker;
+    }
+    for (auto p=0; p<n_priorities; p++) {
+        delete m_injection_queues[p];
+    }
 }
 
 void JobScheduler::kickJob(Job* job) {
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_jobs.push(std::move(job));
-    }
-    m_job_available.notify_one();
+#ifdef ADAMANT_PROFILING
+    job->kick_time = Tracer::now();
+#endif
+    push(job);
+    wake(1);
 }
 
 void JobScheduler::kickJobBatch(JobBatch* job_batch) {
-    for (auto job : job_batch->getJobs()) {
-        kickJob(job);
+    const std::vector<Job*>& jobs = job_batch->getJobs();
+#ifdef ADAMANT_PROFILING
+    uint64_t kick_time = Tracer::now();
+    for (auto job : jobs) {
+        job->kick_time = kick_time;
+    }
+#endif
+    // The batch may be done, and freed, as soon as its last job is pushed
+    std::size_t n_jobs = jobs.size();
+    for (auto job : jobs) {
+        push(job);
     }
+    wake(n_jobs);
+}
+
+void JobScheduler::kickJobAfter(Job* job, std::chrono::nanoseconds delay) {
+    m_timers->kickJobAt(job, TimerQueue::Clock::now() + delay);
+}
+
+ScheduleAwaiter JobScheduler::schedule() {
+    return ScheduleAwaiter(this, std::chrono::nanoseconds(0));
+}
+
+ScheduleAwaiter JobScheduler::sleepFor(std::chrono::nanoseconds delay) {
+    return ScheduleAwaiter(this, delay);
+}
+
+CounterAwaiter JobScheduler::schedule(Job* job) {
+    kickJob(job);
+    return CounterAwaiter(this, job->status);
+}
+
+CounterAwaiter JobScheduler::schedule(JobBatch* job_batch) {
+    kickJobBatch(job_batch);
+    return CounterAwaiter(this, job_batch->status);
 }
 
 unsigned int JobScheduler::getNCpus() {
@@ -78,3 +389,47 @@ unsigned int JobScheduler::getNCpus() {
 unsigned int JobScheduler::getNThreads() {
     return m_n_threads;
 }
+
+const Topology& JobScheduler::getTopology() {
+    return m_topology;
+}
+
+const std::vector<unsigned int>& JobScheduler::getReservedCpus() {
+    return m_reserved_cpus;
+}
+
+const std::vector<unsigned int>& JobScheduler::getWorkerCpus(unsigned int index) {
+    return m_workers[index]->cpus;
+}
+
+std::vector<WorkerMetrics> JobScheduler::getWorkerMetrics() {
+    std::vector<WorkerMetrics> metrics;
+    for (Worker* worker : m_workers) {
+        WorkerMetrics m = {};
+        m.jobs_executed = worker->jobs_executed.load(std::memory_order_relaxed);
+        m.jobs_stolen = worker->jobs_stolen.load(std::memory_order_relaxed);
+        m.jobs_injected = worker->jobs_injected.load(std::memory_order_relaxed);
+        m.steal_attempts = worker->steal_attempts.load(std::memory_order_relaxed);
+        m.failed_steals = worker->failed_steals.load(std::memory_order_relaxed);
+        m.sleeps = worker->sleeps.load(std::memory_order_relaxed);
+        for (auto p=0; p<n_priorities; p++) {
+            m.queue_depth += worker->deques[p]->size();
+        }
+#ifdef ADAMANT_PROFILING
+        m.idle_time = worker->idle_time.load(std::memory_order_relaxed);
+        m.fiber_switches = worker->fiber_pool->getNSwitches();
+        for (auto p=0; p<n_priorities; p++) {
+            for (auto i=0; i<LatencyHistogram::n_buckets; i++) {
+                m.wait_latencies[p].buckets[i] =
+                        worker->wait_latencies[p][i].load(std::memory_order_relaxed);
+            }
+        }
+#endif
+        metrics.push_back(m);
+    }
+    return metrics;
+}
+
+const char* JobScheduler::InvalidConfigException::what() const noexcept {
+    return "The job scheduler configuration pins workers to no CPU, or to a forbidden one.";
+}
@@ -9,33 +9,146 @@
 
 #include "job.hpp"
 #include "job_batch.hpp"
-#include <mutex>
-#include <queue>
+#include "job_queue.hpp"
+#include "work_stealing_deque.hpp"
+#include "fiber_pool.hpp"
+#include "topology.hpp"
+#include "profiling.hpp"
+#include "timer_queue.hpp"
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <thread>
-#include <future>
+#include <cstdint>
+#include <exception>
+#include <boost/fiber/mutex.hpp>
+#include <boost/fiber/condition_variable.hpp>
 
 namespace adamant {
 namespace concurrency {
 
+typedef struct WorkerMetrics {
+    uint64_t jobs_executed;
+    uint64_t jobs_stolen;      // Executed jobs taken from another worker's deque
+    uint64_t jobs_injected;    // Executed jobs taken from the queue of non-worker threads
+    uint64_t steal_attempts;
+    uint64_t failed_steals;    // Steals lost to the owner or to another thief
+    uint64_t sleeps;           // Times the worker ran out of jobs and went to sleep
+    uint64_t queue_depth;      // Jobs currently waiting in the worker's deques
+    // The following are only measured when profiling
+    uint64_t idle_time;        // In ns, looking for jobs or asleep
+    uint64_t fiber_switches;
+    LatencyHistogram wait_latencies[high + 1];  // From kick to start, indexed by JobPriority
+} WorkerMetrics;
+
+typedef enum PinningPolicy {
+    unpinned,       // The OS places the workers
+    compact,        // Neighbouring CPUs, SMT siblings first, so workers share caches
+    scatter,        // One CPU per physical core first, spread across packages
+    explicit_cpus   // The listed CPUs, in order
+} PinningPolicy;
+
+typedef struct SchedulerConfig {
+    unsigned int n_threads = 0;  // 0 for one worker per CPU left after the reserved ones
+    PinningPolicy pinning = unpinned;
+    std::vector<unsigned int> cpus;  // Only for explicit_cpus. Reused when there are more workers
+    int numa_node = -1;  // Preferred node for the workers, -1 for none. Ignored if not allowed
+    /* Kept off the workers for the main and render threads. The first CPUs in pinning order;
+     * when unpinned, they only lower the default number of workers */
+    unsigned int n_reserved_cpus = 2;
+} SchedulerConfig;
+
+// See task.hpp
+class ScheduleAwaiter;
+class CounterAwaiter;
+
+/* Work-stealing scheduler. Each worker owns one lock-free deque per priority, and idle workers
+ * steal from the others. Jobs kicked from other threads go through a lock-free injection
+ * queue per priority. Higher priority jobs are always looked for first.
+ * Workers run jobs on a pool of fibers, so a job that joins another job or batch parks its
+ * fiber while the worker thread keeps running other jobs */
 class JobScheduler {
     public:
         JobScheduler();
+        // May throw InvalidConfigException
+        JobScheduler(const SchedulerConfig& config);
         ~JobScheduler();
         void kickJob(Job* job);
         void kickJobBatch(JobBatch* job_batch);
+        void kickJobAfter(Job* job, std::chrono::nanoseconds delay);
+        // To be awaited by tasks (see task.hpp), which then resume on a worker
+        ScheduleAwaiter schedule();  // Right away
+        ScheduleAwaiter sleepFor(std::chrono::nanoseconds delay);
+        CounterAwaiter schedule(Job* job);  // Once the job is done
+        CounterAwaiter schedule(JobBatch* job_batch);  // Once the batch is done
         unsigned int getNCpus();
         unsigned int getNThreads();
+        const Topology& getTopology();
+        const std::vector<unsigned int>& getReservedCpus();  // Empty when unpinned
+        const std::vector<unsigned int>& getWorkerCpus(unsigned int index);  // Empty if unpinned
+        std::vector<WorkerMetrics> getWorkerMetrics();
+
+        struct InvalidConfigException: public std::exception {
+            const char* what() const noexcept;
+        };
 
     private:
+        static const unsigned int n_priorities = 3;
+        static const std::size_t deque_capacity = 1024;
+        static const std::size_t injection_capacity = 1 << 14;
+        static const unsigned int spin_rounds = 64;
+        static const std::size_t fibers_per_worker = 8;
+        static const std::size_t max_fibers_per_worker = 256;
+        static const std::size_t fiber_stack_size = 64 * 1024;
+
+        struct alignas(64) Worker {
+            WorkStealingDeque* deques[n_priorities];
+            FiberPool* fiber_pool;
+            std::vector<unsigned int> cpus;  // Affinity, empty for any
+            uint32_t rng_state;
+            unsigned int idle_rounds;
+            // Only written by the owner, so relaxed loads and stores suffice
+            std::atomic<uint64_t> jobs_executed;
+            std::atomic<uint64_t> jobs_stolen;
+            std::atomic<uint64_t> jobs_injected;
+            std::atomic<uint64_t> steal_attempts;
+            std::atomic<uint64_t> failed_steals;
+            std::atomic<uint64_t> sleeps;
+#ifdef ADAMANT_PROFILING
+            bool idle;
+            uint64_t idle_since;
+            std::atomic<uint64_t> idle_time;
+            std::atomic<uint64_t> wait_latencies[n_priorities][LatencyHistogram::n_buckets];
+#endif
+            Worker(uint32_t seed);
+            ~Worker();
+        };
+
+        const Topology m_topology;
         const unsigned int m_n_cpus;
-        const unsigned int m_n_threads;
+        unsigned int m_n_threads;
+        std::vector<unsigned int> m_reserved_cpus;
         std::vector<std::thread> m_threads;
-        std::priority_queue<Job*, std::vector<Job*>, Job::GreaterComparator> m_jobs;
-        std::condition_variable m_job_available;
-        std::mutex m_mutex;
-        std::promise<void> m_exit_signal;
-        void work(std::shared_future<void> signal);
+        std::vector<Worker*> m_workers;
+        JobQueue* m_injection_queues[n_priorities];
+        std::atomic<bool> m_exiting;
+        // Only used to put idle workers to sleep, never while kicking or running jobs
+        boost::fibers::mutex m_sleep_mutex;
+        boost::fibers::condition_variable m_job_available;
+        std::atomic<unsigned int> m_n_sleeping;
+        unsigned int m_wakeups;  // Guarded by m_sleep_mutex
+        TimerQueue* m_timers;
+        std::vector<std::vector<unsigned int>> place(const SchedulerConfig& config);
+        void work(unsigned int index);
+        bool step(unsigned int index);
+        bool help(unsigned int index);
+        void push(Job* job);
+        void wake(unsigned int n_jobs);
+        void sleep(Worker* worker);
+        Job* findJob(unsigned int index);
+        Job* steal(unsigned int index, unsigned int priority);
+        bool hasJobs();
+        void execute(Job* job);
 };
 
 }  // namespace concurrency
@@ -0,0 +1,54 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "parallel.hpp"
+#include "job_batch.hpp"
+#include <algorithm>
+
+using namespace adamant::concurrency;
+
+typedef struct Chunk {
+    RangeAction* action;
+    void* context;
+    std::size_t begin;
+    std::size_t end;
+} Chunk;
+
+static void runChunk(uintptr_t param) {
+    Chunk* chunk = (Chunk*) param;
+    chunk->action(chunk->context, chunk->begin, chunk->end);
+}
+
+std::size_t adamant::concurrency::chooseGrain(JobScheduler* scheduler, std::size_t n,
+        std::size_t grain) {
+    if (grain > 0) return grain;
+    std::size_t n_chunks = 4 * (scheduler->getNThreads() + 1);
+    return std::max<std::size_t>(1, (n + n_chunks - 1) / n_chunks);
+}
+
+void adamant::concurrency::parallelFor(JobScheduler* scheduler, std::size_t begin,
+        std::size_t end, std::size_t grain, RangeAction* action, void* context,
+        JobPriority priority) {
+    if (end <= begin) return;
+    grain = chooseGrain(scheduler, end - begin, grain);
+    std::size_t n_chunks = (end - begin + grain - 1) / grain;
+    if (n_chunks == 1) {
+        action(context, begin, end);
+        return;
+    }
+    // Chunk and job records live in contiguous blocks, freed in bulk once the batch completes
+    std::vector<Chunk> chunks(n_chunks - 1);
+    std::vector<uintptr_t> params(n_chunks - 1);
+    for (auto i=1; i<n_chunks; i++) {
+        std::size_t chunk_begin = begin + i * grain;
+        chunks[i-1] = {action, context, chunk_begin, std::min(end, chunk_begin + grain)};
+        params[i-1] = (uintptr_t) &chunks[i-1];
+    }
+    JobBatch batch(runChunk, params, priority);
+    scheduler->kickJobBatch(&batch);
+    action(context, begin, begin + grain);
+    batch.join();
+}
@@ -0,0 +1,66 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include "job.hpp"
+#include "job_scheduler.hpp"
+#include <vector>
+#include <cstddef>
+
+namespace adamant {
+namespace concurrency {
+
+typedef void RangeAction(void* context, std::size_t begin, std::size_t end);
+
+// A grain of 0 picks one that gives each worker a few chunks to balance the load
+std::size_t chooseGrain(JobScheduler* scheduler, std::size_t n, std::size_t grain);
+
+/* Splits [begin, end) into chunks of grain indices and runs the action over each of them
+ * across the scheduler's workers, one chunk per job. The calling thread runs the first chunk
+ * itself, and then joins the rest */
+void parallelFor(JobScheduler* scheduler, std::size_t begin, std::size_t end,
+        std::size_t grain, RangeAction* action, void* context, JobPriority priority = medium);
+
+// Function: void(std::size_t begin, std::size_t end)
+template <typename Function>
+void parallelFor(JobScheduler* scheduler, std::size_t begin, std::size_t end,
+        std::size_t grain, const Function& function, JobPriority priority = medium) {
+    parallelFor(scheduler, begin, end, grain, [](void* context, std::size_t b, std::size_t e) {
+        (*(const Function*) context)(b, e);
+    }, (void*) &function, priority);
+}
+
+/* Map: T(std::size_t begin, std::size_t end), computes the partial result of a chunk
+ * Reduce: T(T lhs, T rhs), combines partial results in index order */
+template <typename T, typename Map, typename Reduce>
+T parallelReduce(JobScheduler* scheduler, std::size_t begin, std::size_t end,
+        std::size_t grain, T identity, const Map& map, const Reduce& reduce,
+        JobPriority priority = medium) {
+    if (end <= begin) return identity;
+    grain = chooseGrain(scheduler, end - begin, grain);
+    /* A cache line per chunk, so that they neither share one nor, as vector<bool> would, write
+     * bits of the same word */
+    struct alignas(64) Partial {
+        T value;
+    };
+    std::vector<Partial> partials((end - begin + grain - 1) / grain, Partial{identity});
+    auto body = [&](std::size_t b, std::size_t e) {
+        partials[(b - begin) / grain].value = map(b, e);
+    };
+    parallelFor(scheduler, begin, end, grain, body, priority);
+    T result = identity;
+    for (const Partial& partial : partials) {
+        result = reduce(result, partial.value);
+    }
+    return result;
+}
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
@@ -0,0 +1,139 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "profiling.hpp"
+#include <mutex>
+#include <chrono>
+#include <iomanip>
+#include <cstring>
+#include <algorithm>
+
+using namespace adamant::concurrency;
+
+uint64_t LatencyHistogram::getCount() const {
+    uint64_t count = 0;
+    for (auto i=0; i<n_buckets; i++) {
+        count += buckets[i];
+    }
+    return count;
+}
+
+uint64_t LatencyHistogram::getPercentile(double fraction) const {
+    uint64_t count = getCount();
+    if (count == 0) return 0;
+    uint64_t rank = std::max<uint64_t>(1, fraction * count);
+    uint64_t seen = 0;
+    for (auto i=0; i<n_buckets; i++) {
+        seen += buckets[i];
+        if (seen >= rank) return (uint64_t) 2 << i;
+    }
+    return (uint64_t) 2 << (n_buckets - 1);
+}
+
+unsigned int LatencyHistogram::bucketOf(uint64_t ns) {
+    unsigned int bucket = ns == 0 ? 0 : 63 - __builtin_clzll(ns);
+    return std::min(bucket, n_buckets - 1);
+}
+
+uint64_t Tracer::now() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count();
+}
+
+Tracer::Ring::Ring(unsigned int tid): tid{tid}, name{"thread " + std::to_string(tid)},
+        events(ring_capacity), n_recorded{0} {}
+
+// Rings outlive their threads, so that the trace can still be dumped after they exit
+std::vector<Tracer::Ring*>& Tracer::rings() {
+    static std::vector<Ring*> rings;
+    return rings;
+}
+
+std::mutex& Tracer::ringsMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+Tracer::Ring* Tracer::ring() {
+    static thread_local Ring* t_ring = nullptr;
+    if (t_ring == nullptr) {
+        std::lock_guard<std::mutex> lock(ringsMutex());
+        t_ring = new Ring(rings().size());
+        rings().push_back(t_ring);
+    }
+    return t_ring;
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    Ring* r = ring();
+    std::lock_guard<std::mutex> lock(ringsMutex());
+    r->name = name;
+}
+
+void Tracer::record(const char* name, const char* category, uint64_t begin, uint64_t end) {
+    Ring* r = ring();
+    uint64_t n = r->n_recorded.load(std::memory_order_relaxed);
+    Event& event = r->events[n & (ring_capacity - 1)];
+    std::strncpy(event.name, name, max_name_length);
+    event.name[max_name_length] = '\0';
+    event.category = category;
+    event.begin = begin;
+    event.end = end;
+    r->n_recorded.store(n + 1, std::memory_order_release);
+}
+
+// Names are only escaped for quotes and backslashes, as they are identifiers in practice
+static void writeString(std::ostream& out, const std::string& string) {
+    out << '"';
+    for (char c : string) {
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+
+void Tracer::dump(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(ringsMutex());
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    for (Ring* r : rings()) {
+        out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+            << "\"tid\":" << r->tid << ",\"args\":{\"name\":";
+        writeString(out, r->name);
+        out << "}}";
+        first = false;
+        uint64_t n = r->n_recorded.load(std::memory_order_acquire);
+        uint64_t first_kept = n > ring_capacity ? n - ring_capacity : 0;
+        for (uint64_t i=first_kept; i<n; i++) {
+            const Event& event = r->events[i & (ring_capacity - 1)];
+            out << ",\n{\"name\":";
+            writeString(out, event.name);
+            out << ",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                << r->tid << ",\"ts\":" << event.begin / 1000.0 << ",\"dur\":"
+                << (event.end - event.begin) / 1000.0 << "}";
+        }
+    }
+    out << "\n]}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(ringsMutex());
+    for (Ring* r : rings()) {
+        r->n_recorded.store(0, std::memory_order_relaxed);
+    }
+}
+
+TraceZone::TraceZone(const char* name): m_name{name}, m_begin{Tracer::now()} {}
+
+TraceZone::~TraceZone() {
+    Tracer::record(m_name, "zone", m_begin, Tracer::now());
+}
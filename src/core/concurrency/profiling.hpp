@@ -0,0 +1,95 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef PROFILING_HPP
+#define PROFILING_HPP
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <ostream>
+
+// Release builds may define ADAMANT_NO_PROFILING to leave every measurement out
+#ifndef ADAMANT_NO_PROFILING
+#define ADAMANT_PROFILING
+#endif
+
+#ifdef ADAMANT_PROFILING
+#define ADAMANT_CONCAT_(a, b) a##b
+#define ADAMANT_CONCAT(a, b) ADAMANT_CONCAT_(a, b)
+// Traces the rest of the enclosing scope under the given name
+#define ADAMANT_TRACE_ZONE(name) \
+    adamant::concurrency::TraceZone ADAMANT_CONCAT(trace_zone_, __LINE__)(name)
+#else
+#define ADAMANT_TRACE_ZONE(name)
+#endif
+
+namespace adamant {
+namespace concurrency {
+
+// Bucket i counts latencies within [2^i, 2^(i+1)) ns, and bucket 0 also counts 0 ns
+typedef struct LatencyHistogram {
+    static const unsigned int n_buckets = 40;
+    uint64_t buckets[n_buckets];
+    uint64_t getCount() const;
+    uint64_t getPercentile(double fraction) const;  // Upper bound, in ns
+    static unsigned int bucketOf(uint64_t ns);
+} LatencyHistogram;
+
+/* Per-thread ring buffers of begin/end events, exported as Chrome trace_event JSON (load it
+ * in chrome://tracing or Perfetto). Each thread only writes to its own ring, so recording takes
+ * no lock; once a ring is full the oldest events are overwritten */
+class Tracer {
+    public:
+        static const std::size_t ring_capacity = 1 << 14;
+        static const std::size_t max_name_length = 31;
+        static uint64_t now();  // In ns
+        static void setThreadName(const std::string& name);
+        // The name is copied, and truncated to max_name_length
+        static void record(const char* name, const char* category, uint64_t begin,
+                           uint64_t end);
+        // Both must be called while no thread is recording, e.g. after joining a frame
+        static void dump(std::ostream& out);
+        static void clear();
+
+    private:
+        struct Event {
+            char name[max_name_length + 1];
+            const char* category;  // Static strings only
+            uint64_t begin;
+            uint64_t end;
+        };
+
+        struct Ring {
+            unsigned int tid;
+            std::string name;
+            std::vector<Event> events;
+            std::atomic<uint64_t> n_recorded;  // Only written by the owner thread, or clear()
+            Ring(unsigned int tid);
+        };
+
+        static std::vector<Ring*>& rings();
+        static std::mutex& ringsMutex();
+        static Ring* ring();  // Of the calling thread
+};
+
+// Records an event from its construction until its destruction
+class TraceZone {
+    public:
+        TraceZone(const char* name);
+        ~TraceZone();
+
+    private:
+        const char* m_name;
+        uint64_t m_begin;
+};
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "task.hpp"
+
+using namespace adamant::concurrency;
+
+Resumption::Resumption(JobScheduler* scheduler): m_scheduler{scheduler},
+        m_job{resume, 0, medium, nullptr} {}
+
+// Nothing is touched after kicking, as the coroutine may be resumed and destroy this meanwhile
+void Resumption::kick(std::coroutine_handle<> handle) {
+    m_job = Job(resume, (uintptr_t) handle.address(), medium, nullptr);
+    m_scheduler->kickJob(&m_job);
+}
+
+void Resumption::kickAfter(std::coroutine_handle<> handle, std::chrono::nanoseconds delay) {
+    m_job = Job(resume, (uintptr_t) handle.address(), medium, nullptr);
+    m_scheduler->kickJobAfter(&m_job, delay);
+}
+
+void Resumption::resume(uintptr_t param) {
+    std::coroutine_handle<>::from_address((void*) param).resume();
+}
+
+ScheduleAwaiter::ScheduleAwaiter(JobScheduler* scheduler, std::chrono::nanoseconds delay):
+        m_resumption{scheduler}, m_delay{delay} {}
+
+bool ScheduleAwaiter::await_ready() {
+    return false;
+}
+
+void ScheduleAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    if (m_delay.count() > 0) m_resumption.kickAfter(handle, m_delay);
+    else m_resumption.kick(handle);
+}
+
+void ScheduleAwaiter::await_resume() {}
+
+CounterAwaiter::CounterAwaiter(JobScheduler* scheduler, Counter* counter):
+        Counter::Waiter{nullptr, resume}, m_resumption{scheduler}, m_counter{counter} {}
+
+bool CounterAwaiter::await_ready() {
+    return m_counter->isDone();
+}
+
+// If the counter is done meanwhile, the coroutine simply goes on with no need to resume it
+bool CounterAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    m_handle = handle;
+    return m_counter->subscribe(this);
+}
+
+void CounterAwaiter::await_resume() {}
+
+void CounterAwaiter::resume(Counter::Waiter* waiter) {
+    CounterAwaiter* awaiter = (CounterAwaiter*) waiter;
+    awaiter->m_resumption.kick(awaiter->m_handle);
+}
+
+bool TaskPromiseBase::FinalAwaiter::await_ready() noexcept {
+    return false;
+}
+
+void TaskPromiseBase::FinalAwaiter::await_resume() noexcept {}
+
+std::suspend_always TaskPromiseBase::initial_suspend() noexcept {
+    return {};
+}
+
+TaskPromiseBase::FinalAwaiter TaskPromiseBase::final_suspend() noexcept {
+    return {};
+}
+
+void TaskPromiseBase::unhandled_exception() {
+    exception = std::current_exception();
+}
+
+void TaskPromiseBase::rethrow() {
+    if (exception) std::rethrow_exception(exception);
+}
+
+Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+void TaskPromise<void>::return_void() {}
+
+void TaskPromise<void>::result() {
+    rethrow();
+}
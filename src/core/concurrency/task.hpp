@@ -0,0 +1,242 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef TASK_HPP
+#define TASK_HPP
+
+#include "job.hpp"
+#include "job_batch.hpp"
+#include "counter.hpp"
+#include "job_scheduler.hpp"
+#include <array>
+#include <chrono>
+#include <utility>
+#include <optional>
+#include <exception>
+#include <coroutine>
+
+namespace adamant {
+namespace concurrency {
+
+/* Resumes a suspended coroutine on one of the scheduler's workers, through a detached job.
+ * The coroutine may destroy it as soon as it is resumed */
+class Resumption {
+    public:
+        Resumption(JobScheduler* scheduler);
+        void kick(std::coroutine_handle<> handle);
+        void kickAfter(std::coroutine_handle<> handle, std::chrono::nanoseconds delay);
+
+    private:
+        JobScheduler* m_scheduler;
+        Job m_job;
+        static void resume(uintptr_t param);
+};
+
+// Resumes on a worker, right away or after a delay
+class ScheduleAwaiter {
+    public:
+        ScheduleAwaiter(JobScheduler* scheduler, std::chrono::nanoseconds delay);
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume();
+
+    private:
+        Resumption m_resumption;
+        std::chrono::nanoseconds m_delay;
+};
+
+// Resumes on a worker once the counter of a job, batch or task is done
+class CounterAwaiter: private Counter::Waiter {
+    public:
+        CounterAwaiter(JobScheduler* scheduler, Counter* counter);
+        bool await_ready();
+        bool await_suspend(std::coroutine_handle<> handle);
+        void await_resume();
+
+    private:
+        Resumption m_resumption;
+        Counter* m_counter;
+        std::coroutine_handle<> m_handle;
+        static void resume(Counter::Waiter* waiter);
+};
+
+template <typename T>
+class Task;
+
+class TaskPromiseBase {
+    public:
+        struct FinalAwaiter {
+            bool await_ready() noexcept;
+            void await_resume() noexcept;
+            // The task may be destroyed as soon as its counter is done
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                TaskPromiseBase& promise = handle.promise();
+                if (promise.continuation) return promise.continuation;
+                if (promise.done != nullptr) promise.done->decrement();
+                return std::noop_coroutine();
+            }
+        };
+
+        std::coroutine_handle<> continuation;  // Awaiting coroutine, if awaited
+        Counter* done = nullptr;  // Only if started
+        std::optional<Resumption> resumption;  // Only if started
+        std::exception_ptr exception;
+        std::suspend_always initial_suspend() noexcept;
+        FinalAwaiter final_suspend() noexcept;
+        void unhandled_exception();
+        void rethrow();
+};
+
+template <typename T>
+class TaskPromise: public TaskPromiseBase {
+    public:
+        Task<T> get_return_object();
+
+        template <typename U>
+        void return_value(U&& value) {
+            m_value.emplace(std::forward<U>(value));
+        }
+
+        T& result() {
+            rethrow();
+            return *m_value;
+        }
+
+    private:
+        std::optional<T> m_value;
+};
+
+template <>
+class TaskPromise<void>: public TaskPromiseBase {
+    public:
+        Task<void> get_return_object();
+        void return_void();
+        void result();
+};
+
+/* Coroutine run by the scheduler's workers. It is lazy: it starts when awaited by another
+ * task, which then resumes once it finishes, or when started from outside of any coroutine,
+ * to be joined like a job. While suspended it only takes its coroutine frame, never a thread
+ * or a fiber. Must not be destructed while running */
+template <typename T = void>
+class Task {
+    public:
+        typedef TaskPromise<T> promise_type;
+
+        Task(Task&& other): m_handle{std::exchange(other.m_handle, nullptr)} {}
+
+        Task& operator=(Task&& other) {
+            if (this != &other) {
+                destroy();
+                m_handle = std::exchange(other.m_handle, nullptr);
+            }
+            return *this;
+        }
+
+        ~Task() {
+            destroy();
+        }
+
+        // Runs it on a worker, to be joined
+        void start(JobScheduler* scheduler) {
+            promise_type& promise = m_handle.promise();
+            promise.done = Counter::acquire(1);
+            promise.resumption.emplace(scheduler);
+            promise.resumption->kick(m_handle);
+        }
+
+        // Like a job's join(), but only for started tasks
+        void join() {
+            m_handle.promise().done->wait();
+        }
+
+        // Only for started tasks
+        bool isDone() {
+            return m_handle.promise().done->isDone();
+        }
+
+        // Only for started tasks, which get joined. T& or void; rethrows if the task threw
+        decltype(auto) get() {
+            join();
+            return m_handle.promise().result();
+        }
+
+        // Awaits a started task
+        CounterAwaiter joined(JobScheduler* scheduler) {
+            return CounterAwaiter(scheduler, m_handle.promise().done);
+        }
+
+        // Awaiting a task starts it, and gives its result (or rethrows)
+        auto operator co_await() {
+            struct Awaiter {
+                std::coroutine_handle<promise_type> handle;
+                bool await_ready() {
+                    return handle.done();
+                }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+                    handle.promise().continuation = awaiting;
+                    return handle;
+                }
+                decltype(auto) await_resume() {
+                    if constexpr (std::is_void_v<T>) handle.promise().result();
+                    else return std::move(handle.promise().result());
+                }
+            };
+            return Awaiter{m_handle};
+        }
+
+    private:
+        std::coroutine_handle<promise_type> m_handle;
+
+        explicit Task(std::coroutine_handle<promise_type> handle): m_handle{handle} {}
+
+        void destroy() {
+            if (!m_handle) return;
+            if (m_handle.promise().done != nullptr) Counter::release(m_handle.promise().done);
+            m_handle.destroy();
+        }
+
+        friend promise_type;
+        template <typename U>
+        friend Counter* kickForAll(JobScheduler* scheduler, Task<U>* task);
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Counter* kickForAll(JobScheduler* scheduler, Job* job) {
+    scheduler->kickJob(job);
+    return job->status;
+}
+
+inline Counter* kickForAll(JobScheduler* scheduler, JobBatch* batch) {
+    scheduler->kickJobBatch(batch);
+    return batch->status;
+}
+
+template <typename T>
+Counter* kickForAll(JobScheduler* scheduler, Task<T>* task) {
+    task->start(scheduler);
+    return task->m_handle.promise().done;
+}
+
+/* Kicks every job, batch and task (given as pointers) at once, and finishes when all of them
+ * have. Tasks keep their results, to be taken with get(). Everything must outlive the task */
+template <typename... Awaitables>
+Task<void> whenAll(JobScheduler* scheduler, Awaitables... awaitables) {
+    std::array<Counter*, sizeof...(Awaitables)> counters = {kickForAll(scheduler, awaitables)...};
+    for (Counter* counter : counters) {
+        co_await CounterAwaiter(scheduler, counter);
+    }
+}
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
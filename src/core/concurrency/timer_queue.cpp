@@ -0,0 +1,58 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "timer_queue.hpp"
+#include "job_scheduler.hpp"
+
+using namespace adamant::concurrency;
+
+TimerQueue::TimerQueue(JobScheduler* scheduler): m_scheduler{scheduler}, m_sequence{0},
+        m_exiting{false}, m_thread{&TimerQueue::run, this} {}
+
+TimerQueue::~TimerQueue() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exiting = true;
+    }
+    m_changed.notify_one();
+    m_thread.join();
+}
+
+void TimerQueue::kickJobAt(Job* job, Clock::time_point deadline) {
+    bool earliest;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        earliest = m_timers.empty() || deadline < m_timers.top().deadline;
+        m_timers.push({deadline, m_sequence++, job});
+    }
+    // Otherwise the thread is already waiting for an earlier deadline
+    if (earliest) m_changed.notify_one();
+}
+
+bool TimerQueue::Timer::operator>(const Timer& other) const {
+    if (deadline != other.deadline) return deadline > other.deadline;
+    return sequence > other.sequence;
+}
+
+void TimerQueue::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_exiting) {
+        if (m_timers.empty()) {
+            m_changed.wait(lock);
+        } else if (m_timers.top().deadline > Clock::now()) {
+            // A copy, as the queue may be reallocated while waiting
+            Clock::time_point deadline = m_timers.top().deadline;
+            m_changed.wait_until(lock, deadline);
+        } else {
+            Job* job = m_timers.top().job;
+            m_timers.pop();
+            // Kicking may take a while if the workers are swamped
+            lock.unlock();
+            m_scheduler->kickJob(job);
+            lock.lock();
+        }
+    }
+}
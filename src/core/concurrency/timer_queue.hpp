@@ -0,0 +1,54 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef TIMER_QUEUE_HPP
+#define TIMER_QUEUE_HPP
+
+#include "job.hpp"
+#include <queue>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <condition_variable>
+
+namespace adamant {
+namespace concurrency {
+
+class JobScheduler;
+
+/* Kicks jobs into a scheduler once their deadline (wall clock) passes. A single thread sleeps
+ * until the earliest deadline, so waiting jobs take no worker */
+class TimerQueue {
+    public:
+        typedef std::chrono::steady_clock Clock;
+        TimerQueue(JobScheduler* scheduler);
+        ~TimerQueue();  // Pending jobs are never kicked
+        void kickJobAt(Job* job, Clock::time_point deadline);
+
+    private:
+        struct Timer {
+            Clock::time_point deadline;
+            uint64_t sequence;  // Jobs with the same deadline are kicked in order
+            Job* job;
+            bool operator>(const Timer& other) const;
+        };
+
+        JobScheduler* m_scheduler;
+        std::mutex m_mutex;
+        std::condition_variable m_changed;
+        std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> m_timers;
+        uint64_t m_sequence;
+        bool m_exiting;
+        std::thread m_thread;
+        void run();
+};
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "timer_wheel.hpp"
+#include "job_scheduler.hpp"
+#include <cmath>
+
+using namespace adamant::concurrency;
+
+TimerWheel::TimerWheel(JobScheduler* scheduler, float tick): m_scheduler{scheduler},
+        m_tick{tick}, m_time{0}, m_now{0}, m_n_pending{0} {
+    for (auto i=0; i<n_slots; i++) {
+        m_heads[i] = none;
+    }
+}
+
+TimerWheel::TimerId TimerWheel::schedule(Job* job, float delay) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t index;
+    if (m_free.empty()) {
+        index = m_timers.size();
+        m_timers.push_back({nullptr, 0, 1, none, none, none});
+    } else {
+        index = m_free.back();
+        m_free.pop_back();
+    }
+    Timer& timer = m_timers[index];
+    timer.job = job;
+    // Never in the past, nor in the tick already processed
+    uint64_t expires = std::ceil((m_time + std::max(delay, 0.0f)) / m_tick);
+    timer.expires = std::max(expires, m_now + 1);
+    insert(index);
+    m_n_pending++;
+    return ((TimerId) timer.generation << 32) | index;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t index = id & UINT32_MAX;
+    if (id == no_timer || index >= m_timers.size()) return false;
+    Timer& timer = m_timers[index];
+    if (timer.generation != (id >> 32) || timer.slot == none) return false;
+    unlink(index);
+    release(index);
+    return true;
+}
+
+void TimerWheel::advance(float elapsed) {
+    std::vector<Job*> expired;
+    advance(elapsed, expired);
+    // Outside of the lock, so that the jobs may reschedule themselves right away
+    for (Job* job : expired) {
+        m_scheduler->kickJob(job);
+    }
+}
+
+void TimerWheel::advance(float elapsed, std::vector<Job*>& expired) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_time += elapsed;
+    uint64_t target = m_time / m_tick;
+    while (m_now < target) {
+        tick(expired);
+    }
+}
+
+double TimerWheel::getTime() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_time;
+}
+
+std::size_t TimerWheel::getNPending() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_n_pending;
+}
+
+/* The first level holds the timers of the next 2^first_bits ticks, one slot per tick. Each of
+ * the following ones covers 2^level_bits times the span of the previous one */
+void TimerWheel::insert(uint32_t index) {
+    Timer& timer = m_timers[index];
+    uint64_t delta = timer.expires - m_now;
+    uint32_t slot;
+    if (delta < ((uint64_t) 1 << first_bits)) {
+        slot = timer.expires & ((1 << first_bits) - 1);
+    } else {
+        unsigned int level = 1;
+        unsigned int shift = first_bits;
+        while (level < n_levels - 1 && delta >= ((uint64_t) 1 << (shift + level_bits))) {
+            level++;
+            shift += level_bits;
+        }
+        // Too far away for the last level, so wait in its furthest slot and cascade again
+        uint64_t expires = timer.expires;
+        if (delta >= ((uint64_t) 1 << (shift + level_bits))) {
+            expires = m_now + ((uint64_t) 1 << (shift + level_bits)) - 1;
+        }
+        slot = (1 << first_bits) + (level - 1) * (1 << level_bits) +
+               ((expires >> shift) & ((1 << level_bits) - 1));
+    }
+    timer.slot = slot;
+    timer.previous = none;
+    timer.next = m_heads[slot];
+    if (timer.next != none) m_timers[timer.next].previous = index;
+    m_heads[slot] = index;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    Timer& timer = m_timers[index];
+    if (timer.previous != none) m_timers[timer.previous].next = timer.next;
+    else m_heads[timer.slot] = timer.next;
+    if (timer.next != none) m_timers[timer.next].previous = timer.previous;
+    timer.slot = none;
+}
+
+void TimerWheel::release(uint32_t index) {
+    m_timers[index].generation++;
+    m_free.push_back(index);
+    m_n_pending--;
+}
+
+// Moves the timers of a slot down to finer levels
+void TimerWheel::cascade(unsigned int level, unsigned int slot) {
+    uint32_t head = (1 << first_bits) + (level - 1) * (1 << level_bits) + slot;
+    uint32_t index = m_heads[head];
+    m_heads[head] = none;
+    while (index != none) {
+        uint32_t next = m_timers[index].next;
+        insert(index);
+        index = next;
+    }
+}
+
+void TimerWheel::tick(std::vector<Job*>& expired) {
+    m_now++;
+    // Coarser levels only come up once the finer ones wrap around
+    if ((m_now & ((1 << first_bits) - 1)) == 0) {
+        unsigned int shift = first_bits;
+        for (auto level=1; level<n_levels; level++) {
+            unsigned int slot = (m_now >> shift) & ((1 << level_bits) - 1);
+            cascade(level, slot);
+            if (slot != 0) break;
+            shift += level_bits;
+        }
+    }
+    uint32_t slot = m_now & ((1 << first_bits) - 1);
+    uint32_t index = m_heads[slot];
+    m_heads[slot] = none;
+    while (index != none) {
+        Timer& timer = m_timers[index];
+        uint32_t next = timer.next;
+        timer.slot = none;
+        expired.push_back(timer.job);
+        release(index);
+        index = next;
+    }
+}
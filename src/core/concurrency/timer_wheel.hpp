@@ -0,0 +1,75 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include "job.hpp"
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace adamant {
+namespace concurrency {
+
+class JobScheduler;
+
+/* Hierarchical timing wheel (Varghese and Lauck) over simulation time, which only moves when
+ * advanced, e.g. once per frame by the elapsed time. Timers are kept in per-slot intrusive
+ * lists, so scheduling, cancelling and firing take O(1). Timers further away than a level
+ * covers wait in a coarser level, and move down a level every time its slot comes up, which
+ * is also O(1) amortized per timer. Thread-safe: jobs may (re)schedule timers while running */
+class TimerWheel {
+    public:
+        typedef uint64_t TimerId;
+        static const TimerId no_timer = 0;
+        // The scheduler kicks expired jobs; tick is the resolution, in ms of simulation time
+        TimerWheel(JobScheduler* scheduler, float tick = 1);
+        TimerId schedule(Job* job, float delay);  // In ms from the current simulation time
+        bool cancel(TimerId id);  // False if it already expired (its job may still be running)
+        void advance(float elapsed);  // In ms. Kicks every job that expires meanwhile
+        // In ms. Hands out every job that expires meanwhile, in order, instead of kicking them
+        void advance(float elapsed, std::vector<Job*>& expired);
+        double getTime();  // In ms
+        std::size_t getNPending();
+
+    private:
+        static const unsigned int n_levels = 4;
+        static const unsigned int first_bits = 8;  // Ticks covered by the first level
+        static const unsigned int level_bits = 6;  // Slots of each coarser level
+        static const unsigned int n_slots = (1 << first_bits) + (n_levels - 1) * (1 << level_bits);
+        static const uint32_t none = UINT32_MAX;
+
+        struct Timer {
+            Job* job;
+            uint64_t expires;  // Tick
+            uint32_t generation;  // Tells reused timers apart
+            uint32_t slot;  // none while free
+            uint32_t previous;
+            uint32_t next;
+        };
+
+        JobScheduler* m_scheduler;
+        const double m_tick;
+        std::mutex m_mutex;
+        double m_time;
+        uint64_t m_now;  // Last tick processed
+        std::vector<Timer> m_timers;
+        std::vector<uint32_t> m_free;
+        uint32_t m_heads[n_slots];
+        std::size_t m_n_pending;
+        void insert(uint32_t index);
+        void unlink(uint32_t index);
+        void release(uint32_t index);
+        void cascade(unsigned int level, unsigned int slot);
+        void tick(std::vector<Job*>& expired);
+};
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
@@ -0,0 +1,121 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "topology.hpp"
+#include <map>
+#include <algorithm>
+#include <set>
+#include <string>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <pthread.h>
+#include <sched.h>
+
+using namespace adamant::concurrency;
+
+static const std::string cpu_path = "/sys/devices/system/cpu/cpu";
+static const std::string node_path = "/sys/devices/system/node/node";
+
+static bool readNumber(const std::string& path, unsigned int& number) {
+    std::ifstream file(path);
+    return (bool) (file >> number);
+}
+
+// Lists such as "0-3,8,10-11"
+static std::vector<unsigned int> readList(const std::string& path) {
+    std::vector<unsigned int> list;
+    std::ifstream file(path);
+    std::string range;
+    while (std::getline(file, range, ',')) {
+        std::istringstream stream(range);
+        unsigned int first, last;
+        char dash;
+        if (!(stream >> first)) continue;
+        if (!(stream >> dash >> last)) last = first;
+        for (auto id=first; id<=last; id++) {
+            list.push_back(id);
+        }
+    }
+    return list;
+}
+
+Topology::Topology() {
+    std::vector<unsigned int> ids;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (auto id=0; id<CPU_SETSIZE; id++) {
+            if (CPU_ISSET(id, &set)) ids.push_back(id);
+        }
+    }
+    if (ids.empty()) {
+        for (auto id=0; id<std::max(1u, std::thread::hardware_concurrency()); id++) {
+            ids.push_back(id);
+        }
+    }
+    // Nodes are only listed by sysfs as the CPUs they hold
+    std::map<unsigned int, unsigned int> nodes;
+    for (auto node=0; ; node++) {
+        std::string path = node_path + std::to_string(node) + "/cpulist";
+        if (!std::ifstream(path)) break;
+        for (unsigned int id : readList(path)) {
+            nodes[id] = node;
+        }
+    }
+    std::map<std::pair<unsigned int, unsigned int>, unsigned int> cores;
+    std::set<unsigned int> packages;
+    std::set<unsigned int> used_nodes;
+    for (unsigned int id : ids) {
+        std::string topology = cpu_path + std::to_string(id) + "/topology/";
+        unsigned int package = 0;
+        unsigned int core_id = id;
+        readNumber(topology + "physical_package_id", package);
+        readNumber(topology + "core_id", core_id);
+        // Core ids repeat across packages
+        auto core = cores.emplace(std::make_pair(package, core_id), cores.size()).first->second;
+        auto node = nodes.count(id) ? nodes[id] : 0;
+        m_cpus.push_back({id, core, package, node});
+        packages.insert(package);
+        used_nodes.insert(node);
+    }
+    m_n_cores = cores.size();
+    m_n_packages = packages.size();
+    m_n_nodes = used_nodes.size();
+}
+
+const std::vector<Cpu>& Topology::getCpus() const {
+    return m_cpus;
+}
+
+const Cpu* Topology::getCpu(unsigned int id) const {
+    for (const Cpu& cpu : m_cpus) {
+        if (cpu.id == id) return &cpu;
+    }
+    return nullptr;
+}
+
+unsigned int Topology::getNCores() const {
+    return m_n_cores;
+}
+
+unsigned int Topology::getNPackages() const {
+    return m_n_packages;
+}
+
+unsigned int Topology::getNNodes() const {
+    return m_n_nodes;
+}
+
+bool adamant::concurrency::pinThisThread(const std::vector<unsigned int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned int id : cpus) {
+        if (id < CPU_SETSIZE) CPU_SET(id, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
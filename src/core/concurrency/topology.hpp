@@ -0,0 +1,47 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef TOPOLOGY_HPP
+#define TOPOLOGY_HPP
+
+#include <vector>
+
+namespace adamant {
+namespace concurrency {
+
+typedef struct Cpu {
+    unsigned int id;       // Logical CPU, as numbered by the OS
+    unsigned int core;     // Physical core, shared by SMT siblings. Unique across packages
+    unsigned int package;  // Socket
+    unsigned int node;     // NUMA node
+} Cpu;
+
+/* CPUs the process is allowed to run on (e.g. within a container or a taskset), read from
+ * sysfs. Anything that cannot be read is assumed to be flat: one core per CPU, one package and
+ * one NUMA node */
+class Topology {
+    public:
+        Topology();
+        const std::vector<Cpu>& getCpus() const;  // Sorted by id
+        const Cpu* getCpu(unsigned int id) const;  // Null if not allowed
+        unsigned int getNCores() const;
+        unsigned int getNPackages() const;
+        unsigned int getNNodes() const;
+
+    private:
+        std::vector<Cpu> m_cpus;
+        unsigned int m_n_cores;
+        unsigned int m_n_packages;
+        unsigned int m_n_nodes;
+};
+
+// Restricts the calling thread to the given CPUs; returns false if the OS refused
+bool pinThisThread(const std::vector<unsigned int>& cpus);
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
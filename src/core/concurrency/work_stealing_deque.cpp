@@ -0,0 +1,108 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "work_stealing_deque.hpp"
+
+using namespace adamant::concurrency;
+
+WorkStealingDeque::Buffer::Buffer(std::size_t capacity): capacity{capacity},
+        mask{capacity - 1} {
+    slots = new std::atomic<Job*>[capacity];
+}
+
+WorkStealingDeque::Buffer::~Buffer() {
+    delete[] slots;
+}
+
+Job* WorkStealingDeque::Buffer::get(int64_t i) const {
+    return slots[i & mask].load(std::memory_order_relaxed);
+}
+
+void WorkStealingDeque::Buffer::put(int64_t i, Job* job) {
+    slots[i & mask].store(job, std::memory_order_relaxed);
+}
+
+WorkStealingDeque::WorkStealingDeque(std::size_t capacity): m_top{0}, m_bottom{0},
+        m_buffer{new Buffer(capacity)} {}
+
+WorkStealingDeque::~WorkStealingDeque() {
+    delete m_buffer.load(std::memory_order_relaxed);
+    for (Buffer* buffer : m_retired) {
+        delete buffer;
+    }
+}
+
+void WorkStealingDeque::push(Job* job) {
+    int64_t b = m_bottom.load(std::memory_order_relaxed);
+    int64_t t = m_top.load(std::memory_order_acquire);
+    Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+    if (b - t > (int64_t) buffer->capacity - 1) {
+        buffer = grow(buffer, b, t);
+    }
+    buffer->put(b, job);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+Job* WorkStealingDeque::pop() {
+    int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+    Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = m_top.load(std::memory_order_relaxed);
+    if (t > b) {
+        // Empty deque
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job* job = buffer->get(b);
+    if (t == b) {
+        // Last job, so we race against thieves for it
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                    std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* WorkStealingDeque::steal(bool& contended) {
+    contended = false;
+    int64_t t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = m_bottom.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+    Buffer* buffer = m_buffer.load(std::memory_order_acquire);
+    Job* job = buffer->get(t);
+    if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                std::memory_order_relaxed)) {
+        contended = true;
+        return nullptr;
+    }
+    return job;
+}
+
+bool WorkStealingDeque::empty() const {
+    return size() == 0;
+}
+
+std::size_t WorkStealingDeque::size() const {
+    int64_t b = m_bottom.load(std::memory_order_relaxed);
+    int64_t t = m_top.load(std::memory_order_relaxed);
+    return b > t ? b - t : 0;
+}
+
+WorkStealingDeque::Buffer* WorkStealingDeque::grow(Buffer* buffer, int64_t bottom,
+        int64_t top) {
+    Buffer* bigger = new Buffer(buffer->capacity * 2);
+    for (int64_t i=top; i<bottom; i++) {
+        bigger->put(i, buffer->get(i));
+    }
+    m_retired.push_back(buffer);
+    m_buffer.store(bigger, std::memory_order_release);
+    return bigger;
+}
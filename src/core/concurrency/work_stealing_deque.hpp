@@ -0,0 +1,57 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef WORK_STEALING_DEQUE_HPP
+#define WORK_STEALING_DEQUE_HPP
+
+#include "job.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace adamant {
+namespace concurrency {
+
+/* Lock-free Chase-Lev deque. The owner thread pushes and pops at the bottom (LIFO, which keeps
+ * caches warm), while any other thread may steal from the top (FIFO). Threads only contend
+ * when stealing, and then only on a CAS of the top index.
+ * Memory orderings follow "Correct and Efficient Work-Stealing for Weak Memory Models"
+ * Nhat Minh Le, Antoniu Pop, Albert Cohen and Francesco Zappa Nardelli */
+class WorkStealingDeque {
+    public:
+        WorkStealingDeque(std::size_t capacity);  // Capacity must be a power of two
+        ~WorkStealingDeque();
+        void push(Job* job);  // Owner only
+        Job* pop();           // Owner only; returns nullptr if empty
+        // Any thread; returns nullptr if empty or if another thread won the race
+        Job* steal(bool& contended);
+        bool empty() const;
+        std::size_t size() const;
+
+    private:
+        struct Buffer {
+            std::size_t capacity;
+            std::size_t mask;
+            std::atomic<Job*>* slots;
+            Buffer(std::size_t capacity);
+            ~Buffer();
+            Job* get(int64_t i) const;
+            void put(int64_t i, Job* job);
+        };
+
+        alignas(64) std::atomic<int64_t> m_top;
+        alignas(64) std::atomic<int64_t> m_bottom;
+        std::atomic<Buffer*> m_buffer;
+        // Thieves may still be reading from old buffers, so they live as long as the deque
+        std::vector<Buffer*> m_retired;
+        Buffer* grow(Buffer* buffer, int64_t bottom, int64_t top);
+};
+
+}  // namespace concurrency
+}  // namespace adamant
+
+#endif
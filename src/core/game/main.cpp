@@ -8,7 +8,9 @@
 #include <chrono>
 #include <vector>
 #include <iostream>
+#include <fstream>
 #include <thread>
+#include <unordered_set>
 #include <SFML/Graphics.hpp>
 #include <SFML/Window/Event.hpp>
 #include <SFML/Window/Keyboard.hpp>
@@ -20,25 +22,121 @@
 #include "../physics/collision_detection_system.hpp"
 #include "../physics/collision_resolution_system.hpp"
 #include "../logic/ai/artificial_player.hpp"
+#include "../concurrency/job_scheduler.hpp"
+#include "../concurrency/job_graph.hpp"
+#include "../concurrency/parallel.hpp"
+#include "../concurrency/timer_wheel.hpp"
 
+using namespace adamant::concurrency;
 using namespace adamant::logic::ai;
 using namespace adamant::logic::elements;
 using namespace adamant::physics::collision;
 using namespace adamant::graphics::elements;
 
+// State shared by the jobs of a frame
+typedef struct Frame {
+    JobScheduler* scheduler;
+    TimerWheel* timer_wheel;  // Simulation time: AI turns and cooldowns
+    float elapsed;
+    std::vector<Elem*> elems;
+    std::vector<Elem*> ai_elems;     // Bots controlled by an AI
+    std::vector<Elem*> other_elems;  // Elems no AI decision depends on
+    std::vector<Job*> expired;  // Timers that fire this frame
+    std::vector<Collision> collisions;
+    std::vector<sf::ConvexShape> snapshot;  // What to draw, decoupled from the simulation
+} Frame;
+
+// Only the AIs whose turn comes up this frame play, along with any other expired timer
+void playAis(uintptr_t param) {
+    Frame* frame = (Frame*) param;
+    frame->expired.clear();
+    frame->timer_wheel->advance(frame->elapsed, frame->expired);
+    auto fire = [frame](std::size_t b, std::size_t e) {
+        for (auto i=b; i<e; i++) {
+            frame->expired[i]->getAction()(frame->expired[i]->getParam());
+        }
+    };
+    parallelFor(frame->scheduler, 0, frame->expired.size(), 1, fire);
+}
+
+void updateElems(JobScheduler* scheduler, std::vector<Elem*>& elems, float elapsed) {
+    parallelFor(scheduler, 0, elems.size(), 0, [&elems, elapsed](std::size_t b, std::size_t e) {
+        for (auto i=b; i<e; i++) {
+            elems[i]->update(elapsed);
+        }
+    });
+}
+
+void updateAiElems(uintptr_t param) {
+    Frame* frame = (Frame*) param;
+    updateElems(frame->scheduler, frame->ai_elems, frame->elapsed);
+}
+
+void updateOtherElems(uintptr_t param) {
+    Frame* frame = (Frame*) param;
+    updateElems(frame->scheduler, frame->other_elems, frame->elapsed);
+}
+
+void detectCollisions(uintptr_t param) {
+    Frame* frame = (Frame*) param;
+    frame->collisions = CollisionDetectionSystem::detect(frame->elems);
+}
+
+void resolveCollisions(uintptr_t param) {
+    Frame* frame = (Frame*) param;
+    CollisionResolutionSystem::resolve(frame->collisions);
+}
+
+void takeSnapshot(uintptr_t param) {
+    Frame* frame = (Frame*) param;
+    frame->snapshot.clear();
+    for (auto elem : frame->elems) {
+        if (elem->isAlive()) {
+            frame->snapshot.push_back(*(sf::ConvexShape*) elem->getShape()->getDrawable());
+        }
+    }
+}
+
+/* AI decisions overlap with the update of elems they do not affect. The frame's simulation
+ * also overlaps with drawing the previous frame, through the snapshot */
+void buildFrameGraph(JobGraph& graph, Frame* frame) {
+    auto play = graph.addJob("play AIs", playAis, (uintptr_t) frame, high);
+    auto update_ais = graph.addJob("update AI elems", updateAiElems, (uintptr_t) frame, high);
+    auto update_others = graph.addJob("update other elems", updateOtherElems,
+            (uintptr_t) frame, high);
+    auto detect = graph.addJob("detect collisions", detectCollisions, (uintptr_t) frame, high);
+    auto resolve = graph.addJob("resolve collisions", resolveCollisions, (uintptr_t) frame,
+            high);
+    auto snapshot = graph.addJob("snapshot", takeSnapshot, (uintptr_t) frame, high);
+    graph.addDependency(play, update_ais);
+    graph.addDependency(update_ais, detect);
+    graph.addDependency(update_others, detect);
+    graph.addDependency(detect, resolve);
+    graph.addDependency(resolve, snapshot);
+}
+
 int main() {
     // TODO: Use tai_clock when C++20 is released; system_clock can be altered by changing the time of the system
     std::chrono::system_clock::time_point last_update = std::chrono::system_clock::now();
+    JobScheduler* scheduler = new JobScheduler();
+#ifdef ADAMANT_PROFILING
+    Tracer::setThreadName("main");
+#endif
+    TimerWheel* timer_wheel = new TimerWheel(scheduler);
+    Ability::setTimerWheel(timer_wheel);
     std::vector<Elem*> elems;
     // Player's bot
     SaiBot* sai = new SaiBot(white_team, {1000, 500});
     elems.push_back(sai);
     // Enemy AI-controlled bots
     std::vector<ArtificialPlayer*> ais;
+    std::unordered_set<Elem*> ai_elems;
     for (int i=0; i<5; i++) {
         SaiBot* new_bot = new SaiBot(black_team, {i*100, 100});
         elems.push_back(new_bot);
-        ais.push_back(new ArtificialPlayer(new_bot, 600, random_movement, random_aiming));
+        ai_elems.insert(new_bot);
+        ais.push_back(new ArtificialPlayer(new_bot, 600, random_movement, random_aiming,
+                    timer_wheel));
     }
     // Obstacles
     for (auto i=0; i<6; i++) {
@@ -47,17 +145,24 @@ int main() {
         elems.push_back(obstacle);
     }
 
+    Frame frame;
+    frame.scheduler = scheduler;
+    frame.timer_wheel = timer_wheel;
+    JobGraph graph;
+    buildFrameGraph(graph, &frame);
+    std::vector<sf::ConvexShape> drawn;  // Snapshot of the previous frame
+    int frames = 0;
+    float critical_path_time = 0;
+    float wall_time = 0;
+    std::chrono::steady_clock::time_point last_report = std::chrono::steady_clock::now();
+
     sf::RenderWindow window(sf::VideoMode(700, 700), "Loading...");
 
     while (window.isOpen()) {
-        // Get and process input
+        // Get and process input; no job of the frame is running at this point
         sf::Event event;
         while (window.pollEvent(event)) {
             if (event.type == sf::Event::Closed) {
-                // Garbage collector
-                for (auto elem : elems) {
-                    delete elem;
-                }
                 window.close();
             } else if (event.type == sf::Event::MouseButtonPressed) {
                 if (event.mouseButton.button == sf::Mouse::Right) {
@@ -70,42 +175,76 @@ int main() {
                     if (casted_ability != nullptr) {
                         elems.push_back(casted_ability); 
                     } 
+                } else if (event.key.code == sf::Keyboard::G) {
+                    // Dump the last frame's job graph, to be rendered with Graphviz
+                    std::ofstream file("frame_graph.dot");
+                    graph.dump(file);
+                } else if (event.key.code == sf::Keyboard::T) {
+                    // Dump the recent jobs of every thread, for chrome://tracing or Perfetto
+                    std::ofstream file("trace.json");
+                    Tracer::dump(file);
                 }
             }
         }
+        if (!window.isOpen()) break;
 
-        // Let AIs play
-        for (auto ai : ais) {
-            ai->play();
+        // Garbage collector
+        for (auto i=0; i<elems.size(); i++) {
+            if (!elems[i]->isAlive()) {
+                elems.erase(elems.begin() + i--);
+            }
         }
 
-        // Update elements
+        // Simulate the frame
         std::chrono::duration<float, std::milli> elapsed = std::chrono::system_clock::now()
             - last_update;
         last_update = std::chrono::system_clock::now();
+        frame.elapsed = elapsed.count();
+        frame.elems = elems;
+        frame.ai_elems.clear();
+        frame.other_elems.clear();
         for (auto elem : elems) {
-            elem->update(elapsed.count());
+            if (ai_elems.count(elem)) frame.ai_elems.push_back(elem);
+            else frame.other_elems.push_back(elem);
         }
+        graph.kick(scheduler);
 
-        std::vector<Collision> collisions = CollisionDetectionSystem::detect(elems);
-        CollisionResolutionSystem::resolve(collisions);
+        // Draw the previous frame meanwhile
+        {
+            ADAMANT_TRACE_ZONE("draw");
+            window.clear();
+            for (auto& shape : drawn) {
+                window.draw(shape);
+            }
+            window.display();
+        }
 
-        // Clear previous frame
-        window.clear();
+        graph.join();
+        std::swap(drawn, frame.snapshot);
 
-        // Draw elements
-        for (auto i=0; i<elems.size(); i++) {
-            // Garbage collector
-            if (!elems[i]->isAlive()) {
-                elems.erase(elems.begin() + i);
-                continue;
-            }
-            window.draw(*elems[i]->getShape()->getDrawable());
+        // Report the average frame and critical path times every second
+        frames++;
+        critical_path_time += graph.getCriticalPathTime();
+        wall_time += graph.getWallTime();
+        if (std::chrono::steady_clock::now() - last_report >= std::chrono::seconds(1)) {
+            std::cout << "Frame: " << wall_time / frames << " ms, critical path: "
+                      << critical_path_time / frames << " ms" << std::endl;
+            frames = 0;
+            critical_path_time = 0;
+            wall_time = 0;
+            last_report = std::chrono::steady_clock::now();
         }
+    }
 
-        // Debuffer the frame
-        window.display();
+    // Garbage collector
+    for (auto ai : ais) {
+        delete ai;
+    }
+    for (auto elem : elems) {
+        delete elem;
     }
+    delete timer_wheel;
+    delete scheduler;
 
     return 0;
 }
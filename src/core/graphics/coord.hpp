@@ -8,6 +8,7 @@
 #define COORD_HPP
 
 #include <cstdint>
+#include <cmath>
 
 namespace adamant {
 namespace graphics {
@@ -17,6 +18,10 @@ typedef struct Coord {
     int_fast16_t y;
 } Coord;
 
+inline float distance(Coord a, Coord b) {
+    return std::hypot((float) (b.x - a.x), (float) (b.y - a.y));
+}
+
 }  // namespace graphics
 }  // namespace adamant
 
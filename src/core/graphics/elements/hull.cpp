@@ -6,83 +6,155 @@
 
 #include "hull.hpp"
 #include <cmath>
-#include <algorithm>
 
+using namespace adamant::graphics;
 using namespace adamant::graphics::elements;
 
-Hull::Hull(Coord origin) {
-    this->origin = origin;
+Hull::Hull(const TriangleMesh* mesh, Coord origin): origin{origin}, m_mesh{mesh},
+        m_left(mesh->getNVertices(), TriangleMesh::none),
+        m_right(mesh->getNVertices(), TriangleMesh::none),
+        m_edges(mesh->getNVertices(), TriangleMesh::none),
+        m_buckets(std::ceil(std::sqrt(mesh->getNVertices())) + 1, TriangleMesh::none),
+        m_start{TriangleMesh::none}, m_size{0} {
+    r.reserve(mesh->getNVertices());
+    theta.reserve(mesh->getNVertices());
+    for (auto v=0; v<mesh->getNVertices(); v++) {
+        double polar_x = mesh->getX(v) - origin.x;
+        double polar_y = mesh->getY(v) - origin.y;
+        r.push_back(std::sqrt(polar_x * polar_x + polar_y * polar_y));
+        double angle = std::atan2(polar_y, polar_x);
+        if (angle < 0) angle += 2 * M_PI;
+        theta.push_back(angle);
+    }
+}
+
+void Hull::init(uint32_t triangle) {
+    for (auto i=0; i<3; i++) {
+        uint32_t e = 3 * triangle + i;
+        uint32_t v = m_mesh->getOrigin(e);
+        m_left[v] = m_mesh->getTarget(e);
+        m_right[v] = m_mesh->getOrigin(TriangleMesh::prev(e));
+        m_edges[v] = e;
+        hash(v);
+    }
+    m_start = m_mesh->getOrigin(3 * triangle);
+    m_size = 3;
 }
 
-/* If there are >3 edges being collinear and a node intersects with them, the node needs to
- * get the closest edge to it (furtherst away from origin), which guarantees that the node can
- * make a non-collinear triangle with the left or right edge of the intersector */
-Edge* Hull::getIntersectingEdge(Node* node) {
+void Hull::split(uint32_t v, uint32_t n, uint32_t v_edge, uint32_t n_edge) {
+    uint32_t left = m_left[v];
+    m_left[v] = n;
+    m_edges[v] = v_edge;
+    m_right[n] = v;
+    m_left[n] = left;
+    m_edges[n] = n_edge;
+    m_right[left] = n;
+    hash(n);
+    m_size++;
+}
+
+void Hull::remove(uint32_t v, uint32_t right_edge) {
+    uint32_t left = m_left[v];
+    uint32_t right = m_right[v];
+    m_left[right] = left;
+    m_edges[right] = right_edge;
+    m_right[left] = right;
+    m_left[v] = TriangleMesh::none;
+    m_right[v] = TriangleMesh::none;
+    m_edges[v] = TriangleMesh::none;
+    // The edge starting at right now covers the angles of v
+    if (m_buckets[bucketOf(v)] == v) m_buckets[bucketOf(v)] = right;
+    if (m_start == v) m_start = left;
+    m_size--;
+}
+
+/* The edge whose angles contain the node's, searched from the last vertex hashed at or before
+ * the node's angle. When a node lies behind a vertex, both edges at that vertex contain its
+ * angle, so the one the node can see is preferred */
+uint32_t Hull::getIntersectingEdge(uint32_t n) {
     // Empty hull
-    if (edges.size() == 0) return nullptr;
-
-    // The center of the hull is inside the hull itself
-    int j = -1;
-    for (int i=0; i<edges.size(); i++) {
-        Edge* e = edges[i];
-        /* The node's angle is within the edge's angles (it intersects with it),
-         * accounting for the exception of when e passes through theta=0 */
-        if (((e->a->theta >= node->theta && e->b->theta <= node->theta && 
-             std::abs(e->a->theta - node->theta) <= M_PI &&
-             std::abs(e->b->theta - node->theta) <= M_PI) || 
-            (e->b->theta >= node->theta && e->a->theta <= node->theta &&
-             std::abs(e->a->theta - node->theta) <= M_PI &&
-             std::abs(e->b->theta - node->theta) <= M_PI) ||
-            (e->a->theta >= node->theta && e->b->theta >= node->theta && 
-             std::abs(e->a->theta - e->b->theta) >= M_PI) ||
-            (e->a->theta <= node->theta && e->b->theta <= node->theta && 
-             std::abs(e->a->theta - e->b->theta) >= M_PI)) && !e->isCollinearWithNode(node)) {
-            // Pick the closest intersector to the node
-            if (j == -1 || e->shortestDistanceTo(node->coord) <
-                edges[j]->shortestDistanceTo(node->coord)) j = i;
+    if (m_size == 0) return TriangleMesh::none;
+
+    uint32_t v = TriangleMesh::none;
+    uint32_t key = bucketOf(n);
+    for (auto i=0; i<m_buckets.size() && v == TriangleMesh::none; i++) {
+        uint32_t candidate = m_buckets[(key + m_buckets.size() - i) % m_buckets.size()];
+        if (candidate != TriangleMesh::none && m_left[candidate] != TriangleMesh::none) {
+            v = candidate;
         }
     }
+    if (v == TriangleMesh::none) v = m_start;
 
-    // We did not find a suitable intersector, so we choose the closest legal edge to the node
-    if (j == -1) {
-        std::vector<Edge*> es = edges;
-        std::sort(es.begin(), es.end(), [&](Edge* lhs, Edge* rhs) {
-            return lhs->shortestDistanceTo(node->coord) < rhs->shortestDistanceTo(node->coord);
-        });
-        std::vector<Edge*> closer;
-        for (int i=0; i<es.size(); i++) {
-            if (es[i]->a == node || es[i]->b == node) continue;
-            Edge* e;
-            Edge* g;
-            bool e_exists = false;
-            bool g_exists = false;
-            try {
-                e = new Edge(node, es[i]->a);
-            } catch (Edge::ExistingEdgeException &ex) {
-                e = ex.getExistingEdge();
-                e_exists = true;
-            }
-            try {
-                g = new Edge(node, es[i]->b);
-            } catch (Edge::ExistingEdgeException &ex) {
-                g = ex.getExistingEdge();
-                g_exists = true;
+    // Walk along the ring towards the node's angle
+    double offset = theta[n] - theta[v];
+    if (offset < -M_PI) offset += 2 * M_PI;
+    else if (offset > M_PI) offset -= 2 * M_PI;
+    bool leftwards = offset >= 0;
+    for (auto i=0; i<m_size; i++) {
+        if (spans(v, n)) {
+            Coord node = m_mesh->getVertex(n);
+            auto sees = [this, node](uint32_t w) {
+                return TriangleMesh::orientation(m_mesh->getVertex(w),
+                        m_mesh->getVertex(m_left[w]), node) < 0;
+            };
+            if (!sees(v)) {
+                if (spans(m_left[v], n) && sees(m_left[v])) return m_left[v];
+                if (spans(m_right[v], n) && sees(m_right[v])) return m_right[v];
             }
-            // Check for legality
-            bool legal = !es[i]->isCollinearWithNode(node) && !e->intersectsWith(closer) &&
-                         !g->intersectsWith(closer);
-            if (!e_exists) delete e;
-            if (!g_exists) delete g;
-            if (legal) {
-                auto pos = std::find(edges.begin(), edges.end(), es[i]);
-                if (pos != edges.end()) j = std::distance(edges.begin(), pos);
-                break;
-            }
-            closer.push_back(es[i]);
+            return v;
         }
+        v = leftwards ? m_left[v] : m_right[v];
     }
 
-    if (j == -1) return nullptr;
+    // The frontier does not wrap the origin, so we choose the closest edge the node sees
+    return getClosestVisibleEdge(n);
+}
+
+uint32_t Hull::getStart() const {
+    return m_start;
+}
+
+std::size_t Hull::getSize() const {
+    return m_size;
+}
+
+uint32_t Hull::bucketOf(uint32_t v) const {
+    uint32_t key = theta[v] / (2 * M_PI) * m_buckets.size();
+    return key < m_buckets.size() ? key : m_buckets.size() - 1;
+}
+
+void Hull::hash(uint32_t v) {
+    m_buckets[bucketOf(v)] = v;
+}
+
+// The node's angle is within the edge's, accounting for edges through theta=0
+bool Hull::spans(uint32_t v, uint32_t n) const {
+    double span = theta[m_left[v]] - theta[v];
+    if (span < 0) span += 2 * M_PI;
+    double offset = theta[n] - theta[v];
+    if (offset < 0) offset += 2 * M_PI;
+    return offset <= span;
+}
+
+uint32_t Hull::getClosestVisibleEdge(uint32_t n) {
+    Coord node = m_mesh->getVertex(n);
+    uint32_t closest = TriangleMesh::none;
+    uint32_t v = m_start;
+    for (auto i=0; i<m_size; i++, v = m_left[v]) {
+        if (v == n || m_left[v] == n) continue;
+        if (TriangleMesh::orientation(m_mesh->getVertex(v), m_mesh->getVertex(m_left[v]),
+                node) >= 0) continue;
+        if (closest == TriangleMesh::none || distanceTo(v, n) < distanceTo(closest, n)) {
+            closest = v;
+        }
+    }
+    return closest;
+}
 
-    return edges[j];
+// From the node to the line through the edge starting at v
+double Hull::distanceTo(uint32_t v, uint32_t n) {
+    Coord a = m_mesh->getVertex(v);
+    Coord b = m_mesh->getVertex(m_left[v]);
+    double length = std::hypot(b.x - a.x, b.y - a.y);
+    return std::abs(TriangleMesh::orientation(a, b, m_mesh->getVertex(n))) / length;
 }
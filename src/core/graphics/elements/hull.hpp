@@ -8,22 +8,66 @@
 #define HULL_HPP
 
 #include "../coord.hpp"
-#include "node.hpp"
-#include "edge.hpp"
+#include "../triangle_mesh.hpp"
 #include <vector>
+#include <cstdint>
+#include <cstddef>
 
 namespace adamant {
 namespace graphics {
 namespace elements {
 
+/* Frontier of the circle-sweep triangulation of a mesh: the ring of its boundary edges, which
+ * goes counter-clockwise around the origin, as a doubly linked list over vertices. Frontier
+ * edges are identified by the vertex they start from; left and right are considered by looking
+ * from the origin. An angular hash on theta finds the edge in front of a node in O(1) expected,
+ * as the frontier spreads evenly around the origin */
 class Hull {
     public:
         Coord origin;
-        std::vector<Edge*> edges;
-        Hull(Coord origin);
-        Edge* getIntersectingEdge(Node* node);
+        std::vector<float> r;  // Polar coordinates of every vertex of the mesh
+        std::vector<float> theta;
+        Hull(const TriangleMesh* mesh, Coord origin);
+        // Starts the ring with a counter-clockwise triangle
+        void init(uint32_t triangle);
+        // Replaces the edge starting at v by the ones v->n and n->left(v)
+        void split(uint32_t v, uint32_t n, uint32_t v_edge, uint32_t n_edge);
+        // Replaces the edges right(v)->v and v->left(v) by the one right(v)->left(v)
+        void remove(uint32_t v, uint32_t right_edge);
+        uint32_t getIntersectingEdge(uint32_t n);  // Its start vertex, or none
+        uint32_t getStart() const;  // Any vertex on the ring
+        std::size_t getSize() const;
+
+        uint32_t getLeft(uint32_t v) const {
+            return m_left[v];
+        }
+
+        uint32_t getRight(uint32_t v) const {
+            return m_right[v];
+        }
+
+        // Half-edge of the mesh from v to left(v)
+        uint32_t getEdge(uint32_t v) const {
+            return m_edges[v];
+        }
+
+        void setEdge(uint32_t v, uint32_t edge) {
+            m_edges[v] = edge;
+        }
 
     private:
+        const TriangleMesh* m_mesh;
+        std::vector<uint32_t> m_left;  // Per vertex, none if not on the ring
+        std::vector<uint32_t> m_right;
+        std::vector<uint32_t> m_edges;
+        std::vector<uint32_t> m_buckets;  // Last vertex added per theta range, maybe removed
+        uint32_t m_start;
+        std::size_t m_size;
+        uint32_t bucketOf(uint32_t v) const;
+        void hash(uint32_t v);
+        bool spans(uint32_t v, uint32_t n) const;
+        uint32_t getClosestVisibleEdge(uint32_t n);
+        double distanceTo(uint32_t v, uint32_t n);
         Hull();
 };
 
@@ -8,17 +8,47 @@
 #include <cmath>
 #include <algorithm>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
+#include <limits>
+#include <functional>
 
 using namespace adamant::logic::elements;
 using namespace adamant::graphics;
 using namespace adamant::graphics::elements;
 
 // May throw InsufficientNodesException or FailedTriangulationException
-NavMesh::NavMesh(std::vector<Terrain*> terrains, MapSize map_size): m_map_size{map_size} {
+NavMesh::NavMesh(std::vector<Terrain*> terrains, MapSize map_size): m_map_size{map_size},
+        m_changed{nullptr}, m_revision{0} {
     triangulate(terrains);
-    removeTrianglesWithin(terrains);
-    populateNodes();
+    for (Terrain* t : terrains) {
+        std::vector<uint32_t> polygon = getPolygon(t);
+        if (constrain(polygon)) block(polygon, true);
+    }
+    indexTriangles();
+    labelComponents();
+}
+
+/* Nothing is read from the file but its header and grid, and the mesh is not copied until the
+ * first obstacle is inserted or removed */
+NavMesh::NavMesh(const std::string& path): m_file{std::make_shared<NavMeshFile>(path)},
+        m_map_size{m_file->getMapSize()}, m_mesh(m_file->getArrays()), m_origin{0, 0},
+        m_changed{nullptr}, m_cell_size{m_file->getCellSize()},
+        m_n_columns(m_map_size.x / m_cell_size + 1),
+        m_cells(m_file->getCells(), m_file->getCells() + m_file->getNCells()), m_revision{0},
+        m_next_component{m_file->getNextComponent()} {
+    if (m_cells.size() != m_n_columns * (m_map_size.y / m_cell_size + 1)) {
+        throw NavMeshFile::InvalidFileException();
+    }
+}
+
+void NavMesh::bake(const std::string& path) const {
+    const uint32_t* uses = m_vertex_uses.empty() && m_file ? m_file->getVertexUses() :
+                                                             m_vertex_uses.data();
+    const uint32_t* components = m_components.empty() && m_file ? m_file->getComponents() :
+                                                                  m_components.data();
+    NavMeshFile::write(path, m_map_size, m_mesh, uses, m_cell_size, m_cells, components,
+            m_next_component);
 }
 
 const char* NavMesh::InsufficientNodesException::what() const throw() {
@@ -29,187 +59,142 @@ const char* NavMesh::FailedTriangulationException::what() const throw() {
     return "No triangles could be created.";
 }
 
-void NavMesh::drawFirstTriangle(std::vector<Node*>& nodes, Hull& frontier) {
-    int i = 0;
-    bool done = false;
-    Triangle* t;
-    while(!done && i < nodes.size()) {
-        for (auto j=i+1; j<nodes.size(); ++j) {
-            for (auto k=j+1; k<nodes.size(); ++k) {
-                if (j <= k) {
-                    try {
-                        t = new Triangle(nodes[i], nodes[j], nodes[k]);
-                    } catch (const Triangle::IllegalTriangleException &e) {
-                        continue;
-                    }
-                    nodes.erase(nodes.begin() + k);
-                    nodes.erase(nodes.begin() + j);
-                    nodes.erase(nodes.begin() + i);
-                    m_mesh.push_back(t);
-                    done = true;
-                    goto end;
-                }    
-            }
+// Terrain nodes first, then the corners of the map. Nodes at the same coordinates are merged
+void NavMesh::addVertices(std::vector<Terrain*>& terrains) {
+    auto add = [this](Coord coord) {
+        auto it = m_vertex_ids.find(keyOf(coord));
+        if (it != m_vertex_ids.end()) {
+            m_vertex_uses[it->second]++;
+        } else {
+            m_vertex_ids[keyOf(coord)] = m_mesh.addVertex(coord);
+            m_vertex_uses.push_back(1);
+        }
+    };
+    for (Terrain* t : terrains) {
+        for (Node* node : t->getShape()->nodes) {
+            add(node->coord);
         }
-        ++i;
-        end:;
     }
+    if (m_mesh.getNVertices() < 3) throw InsufficientNodesException();
+    m_origin = avgCoord(m_mesh.getNVertices());
+    add({0, 0});
+    add({0, m_map_size.y});
+    add({m_map_size.x, m_map_size.y});
+    add({m_map_size.x, 0});
+    // Room for the obstacles inserted later, so that inserting one does not rehash them all
+    m_vertex_ids.reserve(2 * m_mesh.getNVertices());
+}
 
-    // Failed creating initial triangle
-    if (m_mesh.empty()) throw FailedTriangulationException();
-
-    // Order the edges; left and right are considered by looking from the origin of the hull
-    t->defineNeighboursFromCenter(m_origin);
-    frontier.edges.push_back(t->edges[0]);
-    frontier.edges.push_back(t->edges[1]);
-    frontier.edges.push_back(t->edges[2]);
-}
-
-Triangle* NavMesh::legalize(Triangle* candidate) {
-    int i = 0;
-    // TODO: Does not consider legalizations after legalizing once
-    while (i < 3) {
-        Edge* e = candidate->edges[i++];
-        Triangle* neighbour = nullptr;
-        for (Polygon* s : e->shape_ptrs) {
-            // TODO: What if the original terrain was a triangle?
-            if (s->type == Shape::triangle && s != candidate) neighbour = (Triangle*) s;
-        }
-        if (neighbour == nullptr) continue;
-        // Legalize the triangle if it infringes the Delaunay condition
-        float candidate_alpha = candidate->angleOppositeToEdge(e);
-        float neighbour_alpha = neighbour->angleOppositeToEdge(e);
-        if (candidate_alpha + neighbour_alpha > M_PI) {
-            // Flip edges
-            Node* candidate_n = candidate->nodeOppositeToEdge(e);
-            std::vector<Edge*> neighbour_edges = neighbour->adjacentEdges(e);
-            Triangle* new_neighbour;
-            Triangle* new_candidate;
-            try {
-                new_neighbour = new Triangle(neighbour_edges[0], candidate_n);
-            } catch (Triangle::IllegalTriangleException e) {
-                continue;
+/* Tries all possible initial triangles in order of distance to the center of the terrain, and
+ * removes the vertices of the first one from the given ones */
+uint32_t NavMesh::drawFirstTriangle(std::vector<uint32_t>& vertices) {
+    auto distance = [this](uint32_t v) {
+        int64_t x = m_mesh.getX(v) - m_origin.x;
+        int64_t y = m_mesh.getY(v) - m_origin.y;
+        return x * x + y * y;
+    };
+    std::sort(vertices.begin(), vertices.end(), [&distance](uint32_t lhs, uint32_t rhs) {
+        return distance(lhs) < distance(rhs);
+    });
+    for (auto i=0; i<vertices.size(); ++i) {
+        for (auto j=i+1; j<vertices.size(); ++j) {
+            for (auto k=j+1; k<vertices.size(); ++k) {
+                uint32_t a = vertices[i];
+                uint32_t b = vertices[j];
+                uint32_t c = vertices[k];
+                int64_t orientation = TriangleMesh::orientation(m_mesh.getVertex(a),
+                        m_mesh.getVertex(b), m_mesh.getVertex(c));
+                if (orientation == 0) continue;
+                vertices.erase(vertices.begin() + k);
+                vertices.erase(vertices.begin() + j);
+                vertices.erase(vertices.begin() + i);
+                // Always counter-clockwise
+                if (orientation > 0) return m_mesh.addTriangle(a, b, c);
+                return m_mesh.addTriangle(a, c, b);
             }
-            try {
-                new_candidate = new Triangle(neighbour_edges[1], candidate_n);
-            } catch (Triangle::IllegalTriangleException e) {
-                delete new_neighbour;
-                continue;
-            }
-            // Remove neighbour from the mesh 
-            auto pos_m = std::find(m_mesh.begin(), m_mesh.end(), neighbour);
-            if (pos_m != m_mesh.end()) m_mesh.erase(pos_m);
-            delete e;
-            delete neighbour;
-            delete candidate;
-            candidate = new_candidate;
-            // Add the new neighbour to the mesh
-            m_mesh.push_back(new_neighbour);
-            break;
         }
     }
-    return candidate;
+
+    // Failed creating initial triangle
+    throw FailedTriangulationException();
 }
 
-void NavMesh::sideWalk(Edge* edge, Edge* neighbour, Hull& frontier) {
-    while(edge->angleWith(neighbour) < M_PI / 2) {
-        Triangle* t;
-        try { 
-            t = new Triangle(edge, neighbour);
-        } catch (const Triangle::IllegalTriangleException &e) {
-            break;
-        }
+void NavMesh::legalize(uint32_t triangle, Hull& frontier) {
+    m_suspects.assign({3 * triangle, 3 * triangle + 1, 3 * triangle + 2});
+    flipIllegalEdges(&frontier);
+}
 
-        Edge* new_e;
-        if (t->edges[0] != edge && t->edges[0] != neighbour) new_e = t->edges[0];
-        else if (t->edges[1] != edge && t->edges[1] != neighbour) 
-            new_e = t->edges[1];
-        else new_e = t->edges[2];
-        frontier.edges.push_back(new_e);
-
-        // Remove prev. edges from frontier
-        auto pos = std::find(frontier.edges.begin(), frontier.edges.end(), edge);
-        if (pos != frontier.edges.end()) frontier.edges.erase(pos);
-        pos = std::find(frontier.edges.begin(), frontier.edges.end(), neighbour);
-        if (pos != frontier.edges.end()) frontier.edges.erase(pos);
-
-        // Update left & right
-        if (neighbour == edge->left) {
-            new_e->left = edge->left->left;
-            new_e->right = edge->right;
-            edge->left->left->right = new_e;
-            edge->right->left = new_e;
-            edge->left->left = nullptr;
-            edge->left->right = nullptr;
-            edge->left = nullptr;
-            edge->right = nullptr;
-        } else {
-            new_e->left = edge->left;
-            new_e->right = edge->right->right;
-            edge->left->right = new_e;
-            edge->right->right->left = new_e;
-            edge->right->left = nullptr;
-            edge->right->right = nullptr;
-            edge->left = nullptr;
-            edge->right = nullptr;
-        }
-
-        t = legalize(t);
-        m_mesh.push_back(t);
-        if (neighbour == edge->left) neighbour = new_e->left;
-        else neighbour = new_e->right;
-        edge = new_e;
-    } 
-}
-
-void NavMesh::finalWalk(Edge* initial_edge, Hull& frontier) {
-    Edge* edge = initial_edge;
-    do {
-        if (edge->angleWith(edge->left) < M_PI - std::numeric_limits<double>::epsilon()) {
-            Triangle* t;
-            try { 
-                t = new Triangle(edge, edge->left);
-            } catch (const Triangle::IllegalTriangleException &e) {
-                edge = edge->left;
-                continue;
-            }
+/* Lawson's flip algorithm: every flip makes the outer edges of the two triangles it creates
+ * suspect, until no suspect edge is left. The worklist is kept between calls, so flipping
+ * never allocates */
+void NavMesh::flipIllegalEdges(Hull* frontier) {
+    while (!m_suspects.empty()) {
+        uint32_t e = m_suspects.back();
+        m_suspects.pop_back();
+        uint32_t f = m_mesh.getTwin(e);
+        if (f == TriangleMesh::none || m_mesh.isConstrained(e)) continue;
+        // Flip the edge if it infringes the Delaunay condition
+        Coord a = m_mesh.getVertex(m_mesh.getOrigin(e));
+        Coord b = m_mesh.getVertex(m_mesh.getOrigin(TriangleMesh::next(e)));
+        Coord c = m_mesh.getVertex(m_mesh.getOrigin(TriangleMesh::prev(e)));
+        Coord d = m_mesh.getVertex(m_mesh.getOrigin(TriangleMesh::prev(f)));
+        if (TriangleMesh::inCircle(a, b, c, d) <= 0) continue;
+        flip(e);
+        if (frontier != nullptr) {
+            // Frontier edges moved to e and f keep being referenced by their start vertex
+            if (m_mesh.getTwin(e) == TriangleMesh::none) frontier->setEdge(m_mesh.getOrigin(e), e);
+            if (m_mesh.getTwin(f) == TriangleMesh::none) frontier->setEdge(m_mesh.getOrigin(f), f);
+        }
+        m_suspects.insert(m_suspects.end(),
+                {e, TriangleMesh::prev(e), f, TriangleMesh::prev(f)});
+    }
+}
 
-            Edge* new_e;
-            if (t->edges[0] != edge && t->edges[0] != edge->left) new_e = t->edges[0];
-            else if (t->edges[1] != edge && t->edges[1] != edge->left) new_e = t->edges[1];
-            else new_e = t->edges[2];
-            frontier.edges.push_back(new_e);
-
-            // Remove prev. edges from frontier
-            auto pos = std::find(frontier.edges.begin(), frontier.edges.end(), edge);
-            if (pos != frontier.edges.end()) frontier.edges.erase(pos);
-            pos = std::find(frontier.edges.begin(), frontier.edges.end(), edge->left);
-            if (pos != frontier.edges.end()) frontier.edges.erase(pos);
-
-            // Update left & right
-            new_e->left = edge->left->left;
-            new_e->right = edge->right;
-            edge->left->left->right = new_e;
-            edge->right->left = new_e;
-            edge->left->left = nullptr;
-            edge->left->right = nullptr;
-
-            // Update initial edge so we do not loop forever
-            if (initial_edge == edge || initial_edge == edge->left) {
-                initial_edge = new_e->right;
-            }
+/* Closes the frontier at v with the triangle right(v), left(v), v, if v is a reflex vertex of
+ * the frontier (right(v)->v->left(v) turns clockwise) */
+bool NavMesh::fillCorner(uint32_t v, Hull& frontier) {
+    uint32_t p = frontier.getRight(v);
+    uint32_t q = frontier.getLeft(v);
+    if (TriangleMesh::orientation(m_mesh.getVertex(p), m_mesh.getVertex(q),
+            m_mesh.getVertex(v)) <= 0) return false;
+    uint32_t t = m_mesh.addTriangle(p, q, v);
+    m_mesh.link(3 * t + 1, frontier.getEdge(v));
+    m_mesh.link(3 * t + 2, frontier.getEdge(p));
+    frontier.remove(v, 3 * t);
+    legalize(t, frontier);
+    return true;
+}
 
-            // Finish updating left & right
-            edge->left = nullptr;
-            edge->right = nullptr;
+// Fills the basins next to n while their outer angle is under 90 degrees
+void NavMesh::sideWalk(uint32_t n, bool leftwards, Hull& frontier) {
+    while (true) {
+        uint32_t v = leftwards ? frontier.getLeft(n) : frontier.getRight(n);
+        Coord corner = m_mesh.getVertex(v);
+        Coord p = m_mesh.getVertex(frontier.getRight(v));
+        Coord q = m_mesh.getVertex(frontier.getLeft(v));
+        // The outer angle at v is the one from p to q, counter-clockwise
+        int64_t cross = TriangleMesh::orientation(corner, p, q);
+        int64_t dot = (int64_t) (p.x - corner.x) * (q.x - corner.x) +
+                      (int64_t) (p.y - corner.y) * (q.y - corner.y);
+        if (cross <= 0 || dot <= 0 || !fillCorner(v, frontier)) break;
+    }
+}
 
-            t = legalize(t);
-            m_mesh.push_back(t);
-            edge = new_e;
+// Makes the frontier convex, so that the mesh covers the whole map
+void NavMesh::finalWalk(Hull& frontier) {
+    uint32_t v = frontier.getStart();
+    std::size_t n_unchanged = 0;
+    while (n_unchanged < frontier.getSize()) {
+        uint32_t w = frontier.getLeft(v);
+        if (fillCorner(w, frontier)) {
+            // The corner at v may have turned reflex
+            n_unchanged = 0;
+            v = frontier.getRight(v);
         } else {
-            edge = edge->left;
+            n_unchanged++;
+            v = w;
         }
-    } while (edge != initial_edge);
+    }
 }
 
 /* This is a custom implementation of:
@@ -219,157 +204,873 @@ void NavMesh::finalWalk(Edge* initial_edge, Hull& frontier) {
 /* This implementation features restricted areas, corresponding to terrain
  * and other elements of the game */
 void NavMesh::triangulate(std::vector<Terrain*>& terrains) {
+    addVertices(terrains);
+    std::vector<uint32_t> disconnected(m_mesh.getNVertices());
+    for (auto v=0; v<disconnected.size(); v++) {
+        disconnected[v] = v;
+    }
+    uint32_t first = drawFirstTriangle(disconnected);
 
-    // Get nodes
-    for (Terrain* t : terrains) {
-        for (Node* n : t->getShape()->nodes) {
-            m_nodes.push_back(n);
-        }       
-    }
-    if (m_nodes.size() < 3) throw InsufficientNodesException();
-
-    m_mesh = TriangleMesh();
-    m_origin = avgCoord(m_nodes);
-    Hull frontier = Hull(m_origin);
-
-    // Add corner nodes
-    Node* n = new Node({0, 0}, m_origin);
-    m_nodes.push_back(n);
-    n = new Node({0, m_map_size.y}, m_origin);
-    m_nodes.push_back(n);
-    n = new Node({m_map_size.x, m_map_size.y}, m_origin);
-    m_nodes.push_back(n);
-    n = new Node({m_map_size.x, 0}, m_origin);
-    m_nodes.push_back(n);
-    std::vector<Node*> disconnected = m_nodes;
-    for (Node* n : disconnected) {
-        n->setOrigin(m_origin);
-    }
-    // TODO: Either just use nodes, or make disconnected a queue
-    std::sort(disconnected.begin(), disconnected.end(), Node::RComparator());
-
-    // Try all possible initial triangles in order of distance to the origin
-    try {
-        drawFirstTriangle(disconnected, frontier);
-    } catch (const FailedTriangulationException &e) {
-        throw e;
-    }
-
-    // Triangulate all nodes until none are disconnected
-    while(!disconnected.empty()) {
-        n = disconnected[0];
+    // The sweep circle grows from the center of the first triangle, which the frontier wraps
+    m_origin = m_mesh.getCenter(first);
+    Hull frontier = Hull(&m_mesh, m_origin);
+    frontier.init(first);
+    std::sort(disconnected.begin(), disconnected.end(), [&frontier](uint32_t lhs, uint32_t rhs) {
+        if (frontier.r[lhs] != frontier.r[rhs]) return frontier.r[lhs] < frontier.r[rhs];
+        return frontier.theta[lhs] < frontier.theta[rhs];
+    });
+
+    // Triangulate all nodes in order of distance to the origin
+    for (uint32_t n : disconnected) {
         // Create new triangle
-        Edge* intersector = frontier.getIntersectingEdge(n);
-        if (intersector == nullptr) {
-            disconnected.erase(disconnected.begin());
-            continue;
-        } 
-        Triangle* candidate;
-        try {
-            candidate = new Triangle(intersector, n);
-        } catch (const Triangle::IllegalTriangleException &e) {
+        uint32_t v = frontier.getIntersectingEdge(n);
+        if (v == TriangleMesh::none) continue;
+        Coord node = m_mesh.getVertex(n);
+        int64_t side = TriangleMesh::orientation(m_mesh.getVertex(v),
+                m_mesh.getVertex(frontier.getLeft(v)), node);
+        if (side > 0) continue;  // Already within the mesh; should not happen
+        if (side == 0) {
             /* Attempt to create triangles with the right and left edge of intersector
              * One of them is guaranteed to not be collinear with n, because
              * we return the closest intersecting edge to n. Both of them are also
              * guaranteed to form a triangle with n which does not intersect with
              * other triangles, since n and the intersector are collinear */
-            try {
-                candidate = new Triangle(intersector->left, n);
-                intersector = intersector->left;
-            } catch (const Triangle::IllegalTriangleException &e) {
-                try {
-                    candidate = new Triangle(intersector->right, n);
-                    intersector = intersector->right;
-                } catch (const Triangle::IllegalTriangleException &e) {
-                    // Should not happen
-                    disconnected.erase(disconnected.begin());
-                    continue;
-                }
+            uint32_t left = frontier.getLeft(v);
+            uint32_t right = frontier.getRight(v);
+            if (TriangleMesh::orientation(m_mesh.getVertex(left),
+                    m_mesh.getVertex(frontier.getLeft(left)), node) < 0) {
+                v = left;
+            } else if (TriangleMesh::orientation(m_mesh.getVertex(right),
+                    m_mesh.getVertex(v), node) < 0) {
+                v = right;
+            } else {
+                // Should not happen
+                continue;
             }
         }
-        
-        auto pos = std::find(frontier.edges.begin(), frontier.edges.end(), intersector);
-        frontier.edges.erase(pos);
-        disconnected.erase(disconnected.begin());
-        
-        /* Update frontier. We need the intersector as reference, but it may be deleted while
-         * legalizing, so we do this before legalizing */
-        std::vector<Edge*> new_frontier = candidate->adjacentEdges(intersector);
-        Node* left_n = intersector->commonNodeWith(intersector->left);
-        Edge* left_edge = new_frontier[0]->a == left_n || new_frontier[0]->b == left_n ?
-                          new_frontier[0] : new_frontier[1];
-        Edge* right_edge = new_frontier[0] == left_edge ? new_frontier[1] : new_frontier[0];
-        left_edge->left = intersector->left;
-        left_edge->right = right_edge;
-        right_edge->left = left_edge;
-        right_edge->right = intersector->right;
-        intersector->left->right = left_edge;
-        intersector->right->left = right_edge;
-        intersector->left = nullptr;
-        intersector->right = nullptr;
-        frontier.edges.push_back(left_edge);
-        frontier.edges.push_back(right_edge);
-        
-        // Update mesh
-        candidate = legalize(candidate);
-        m_mesh.push_back(candidate);
 
-        sideWalk(left_edge, left_edge->left, frontier);
-        sideWalk(right_edge, right_edge->right, frontier);
+        // The new triangle is w, v, n, across the frontier edge v->w
+        uint32_t w = frontier.getLeft(v);
+        uint32_t t = m_mesh.addTriangle(w, v, n);
+        m_mesh.link(3 * t, frontier.getEdge(v));
+        frontier.split(v, n, 3 * t + 1, 3 * t + 2);
+
+        // Update mesh
+        legalize(t, frontier);
+        sideWalk(n, true, frontier);
+        sideWalk(n, false, frontier);
 
         // TODO: Remove basins
     }
 
-    Edge* initial_edge = frontier.edges[0];
-    finalWalk(initial_edge, frontier);
+    finalWalk(frontier);
 }
 
-void NavMesh::removeTrianglesWithin(std::vector<Terrain*>& terrains) {
-    for (auto i=0; i<m_mesh.size(); ++i) {
-        for (Edge* e : m_mesh[i]->edges) {
-            if (e->a->isRestrictedWith(e->b)) {
-                m_mesh.erase(m_mesh.begin() + i--);
+// False if any of the polygon's edges could not be constrained
+bool NavMesh::constrain(const std::vector<uint32_t>& polygon) {
+    bool closed = true;
+    for (auto i=0; i<polygon.size(); i++) {
+        if (!insertConstraint(polygon[i], polygon[(i + 1) % polygon.size()])) closed = false;
+    }
+    return closed;
+}
+
+/* Frees the edges of the polygon, but the ones that still bound a blocked triangle, i.e. are
+ * shared with another obstacle, and legalizes them */
+void NavMesh::unconstrain(const std::vector<uint32_t>& polygon) {
+    for (auto i=0; i<polygon.size(); i++) {
+        uint32_t a = polygon[i];
+        uint32_t b = polygon[(i + 1) % polygon.size()];
+        while (a != b) {
+            uint32_t v = findCrossings(a, b);
+            if (v == TriangleMesh::none || !m_crossings.empty()) break;
+            uint32_t e = m_mesh.findEdge(a, v);
+            uint32_t f = m_mesh.getTwin(e);
+            if (!m_mesh.isBlocked(TriangleMesh::triangleOf(e)) &&
+                    (f == TriangleMesh::none || !m_mesh.isBlocked(TriangleMesh::triangleOf(f)))) {
+                setConstrained(e, false);
+                m_suspects.push_back(e);
+            }
+            a = v;
+        }
+    }
+    flipIllegalEdges(nullptr);
+}
+
+/* Makes the segment from a to b a constrained edge, or several if it goes through vertices.
+ * The edges crossing it are flipped away (Sloan's algorithm), and the ones created are
+ * legalized again. Fails if it crosses another constraint, i.e. terrain polygons overlap */
+bool NavMesh::insertConstraint(uint32_t a, uint32_t b) {
+    while (a != b) {
+        uint32_t v = findCrossings(a, b);
+        if (v == TriangleMesh::none) return false;
+        for (uint32_t e : m_crossings) {
+            if (m_mesh.isConstrained(e)) return false;
+        }
+        if (m_crossings.empty()) setConstrained(m_mesh.findEdge(a, v));
+        else removeCrossings(a, v);
+        a = v;
+    }
+    return true;
+}
+
+/* Walks from a towards b through the triangles the segment crosses, collecting the edges it
+ * crosses, up to the first vertex on the segment, which is returned */
+uint32_t NavMesh::findCrossings(uint32_t a, uint32_t b) {
+    m_crossings.clear();
+    Coord start = m_mesh.getVertex(a);
+    Coord end = m_mesh.getVertex(b);
+    auto ahead = [start, end](Coord c) {
+        return TriangleMesh::orientation(start, end, c) == 0 &&
+               (c.x - start.x) * (end.x - start.x) + (c.y - start.y) * (end.y - start.y) > 0;
+    };
+
+    // Triangle around a whose corner at a contains the segment, going both ways from any
+    uint32_t e = TriangleMesh::none;
+    uint32_t start_edge = m_mesh.getVertexEdge(a);
+    for (auto clockwise=0; clockwise<2 && e == TriangleMesh::none; clockwise++) {
+        uint32_t f = start_edge;
+        while (f != TriangleMesh::none) {
+            uint32_t x = m_mesh.getTarget(f);
+            uint32_t y = m_mesh.getOrigin(TriangleMesh::prev(f));
+            if (ahead(m_mesh.getVertex(x))) return x;
+            if (ahead(m_mesh.getVertex(y))) return y;
+            if (TriangleMesh::orientation(start, m_mesh.getVertex(x), end) > 0 &&
+                    TriangleMesh::orientation(start, m_mesh.getVertex(y), end) < 0) {
+                e = f;
                 break;
-            }   
-        }
-    }
-}
-
-void NavMesh::populateNodes() {
-    std::unordered_set<Edge*> visited;
-    for (Triangle* t : m_mesh) {
-        // Add intermediate nodes at each edge
-        for (Edge* e : t->edges) {
-            if (visited.find(e) == visited.end()) {
-                visited.insert(e);
-                std::vector<int_fast16_t> xs = {e->a->coord.x, e->b->coord.x};
-                std::vector<int_fast16_t> ys = {e->a->coord.y, e->b->coord.y};
-                std::sort(xs.begin(), xs.end());
-                std::sort(ys.begin(), ys.end());
-                // Do not create intermediate nodes for small edges
-                int diff_x = xs[1] - xs[0];
-                int diff_y = ys[1] - ys[0];
-                if (diff_x >= 10 && diff_y >= 10) {
-                    Node* n = new Node({xs[0] + (diff_x / 2), ys[0] + (diff_y / 2)}, m_origin);
-                    m_nodes.push_back(n);
+            }
+            f = clockwise ? m_mesh.rotateCw(f) : m_mesh.rotateCcw(f);
+            if (f == start_edge) return TriangleMesh::none;
+        }
+    }
+    if (e == TriangleMesh::none) return TriangleMesh::none;
+
+    // Cross triangles until reaching a vertex on the segment
+    uint32_t h = TriangleMesh::next(e);
+    while (true) {
+        m_crossings.push_back(h);
+        uint32_t g = m_mesh.getTwin(h);
+        if (g == TriangleMesh::none) return TriangleMesh::none;
+        uint32_t z = m_mesh.getOrigin(TriangleMesh::prev(g));
+        int64_t side = TriangleMesh::orientation(start, end, m_mesh.getVertex(z));
+        if (side == 0) return z;
+        int64_t x_side = TriangleMesh::orientation(start, end,
+                m_mesh.getVertex(m_mesh.getOrigin(TriangleMesh::next(g))));
+        h = (side > 0) == (x_side > 0) ? TriangleMesh::prev(g) : TriangleMesh::next(g);
+    }
+}
+
+/* Flips the crossing edges whose quads are convex until none crosses the segment from a to b,
+ * which then is an edge, constrained before the others created are legalized. Flips move the
+ * outer edges of the quad between half-edges, so the pending ones are renamed as they go */
+void NavMesh::removeCrossings(uint32_t a, uint32_t b) {
+    Coord start = m_mesh.getVertex(a);
+    Coord end = m_mesh.getVertex(b);
+    auto crosses = [this, start, end](uint32_t e) {
+        int64_t u = TriangleMesh::orientation(start, end, m_mesh.getVertex(m_mesh.getOrigin(e)));
+        int64_t w = TriangleMesh::orientation(start, end, m_mesh.getVertex(m_mesh.getTarget(e)));
+        return (u > 0 && w < 0) || (u < 0 && w > 0);
+    };
+    for (auto i=0; i<m_crossings.size(); i++) {
+        uint32_t e = m_crossings[i];
+        uint32_t f = m_mesh.getTwin(e);
+        // The quad is convex if its diagonals cross
+        Coord p = m_mesh.getVertex(m_mesh.getOrigin(e));
+        Coord q = m_mesh.getVertex(m_mesh.getTarget(e));
+        Coord c = m_mesh.getVertex(m_mesh.getOrigin(TriangleMesh::prev(e)));
+        Coord d = m_mesh.getVertex(m_mesh.getOrigin(TriangleMesh::prev(f)));
+        if (TriangleMesh::orientation(c, d, p) >= 0 || TriangleMesh::orientation(c, d, q) <= 0) {
+            m_crossings.push_back(e);
+            continue;
+        }
+        uint32_t e_next = TriangleMesh::next(e);
+        uint32_t f_next = TriangleMesh::next(f);
+        flip(e);
+        for (auto j=i+1; j<m_crossings.size(); j++) {
+            if (m_crossings[j] == e_next) m_crossings[j] = f;
+            else if (m_crossings[j] == f_next) m_crossings[j] = e;
+        }
+        for (uint32_t& created : m_suspects) {
+            if (created == e_next) created = f;
+            else if (created == f_next) created = e;
+        }
+        // The new diagonal
+        uint32_t c_index = m_mesh.getOrigin(e_next);
+        uint32_t d_index = m_mesh.getTarget(e_next);
+        if ((c_index == a && d_index == b) || (c_index == b && d_index == a)) {
+            setConstrained(e_next);
+        } else if (crosses(e_next)) {
+            m_crossings.push_back(e_next);
+        } else {
+            m_suspects.push_back(e_next);
+        }
+    }
+    m_crossings.clear();
+    flipIllegalEdges(nullptr);
+}
+
+/* Floods the polygon from a triangle inside it, without crossing constrained edges, blocking
+ * or unblocking its triangles */
+void NavMesh::block(const std::vector<uint32_t>& polygon, bool blocked) {
+    uint32_t seed = findTriangleWithin(polygon);
+    if (seed == TriangleMesh::none || m_mesh.isBlocked(seed) == blocked) return;
+    std::vector<uint32_t> pending = {seed};
+    m_mesh.setBlocked(seed, blocked);
+    touch(seed);
+    while (!pending.empty()) {
+        uint32_t t = pending.back();
+        pending.pop_back();
+        for (auto i=0; i<3; i++) {
+            uint32_t neighbour = m_mesh.getNeighbour(t, i);
+            if (neighbour == TriangleMesh::none || m_mesh.isBlocked(neighbour) == blocked ||
+                    m_mesh.isConstrained(3 * t + i)) continue;
+            m_mesh.setBlocked(neighbour, blocked);
+            touch(neighbour);
+            pending.push_back(neighbour);
+        }
+    }
+}
+
+// A triangle around the first vertex of the convex polygon with its centroid inside it
+uint32_t NavMesh::findTriangleWithin(const std::vector<uint32_t>& polygon) {
+    std::size_t size = polygon.size();
+    if (size < 3) return TriangleMesh::none;
+    auto corner = [this, &polygon](uint32_t i) {
+        Coord c = m_mesh.getVertex(polygon[i]);
+        return Coord{3 * c.x, 3 * c.y};
+    };
+    // Orientation of the polygon, as its nodes may go either way
+    int64_t area = 0;
+    for (auto i=1; i+1<size; i++) {
+        area += TriangleMesh::orientation(corner(0), corner(i), corner(i+1));
+    }
+    if (area == 0) return TriangleMesh::none;
+
+    uint32_t start_edge = m_mesh.getVertexEdge(polygon[0]);
+    for (auto clockwise=0; clockwise<2; clockwise++) {
+        uint32_t e = start_edge;
+        while (e != TriangleMesh::none) {
+            // Centroid, scaled by 3 as are the corners so that it is exact
+            Coord a = m_mesh.getVertex(m_mesh.getOrigin(e));
+            Coord b = m_mesh.getVertex(m_mesh.getTarget(e));
+            Coord c = m_mesh.getVertex(m_mesh.getOrigin(TriangleMesh::prev(e)));
+            Coord centroid = {a.x + b.x + c.x, a.y + b.y + c.y};
+            bool within = true;
+            for (auto i=0; i<size && within; i++) {
+                int64_t side = TriangleMesh::orientation(corner(i), corner((i + 1) % size),
+                        centroid);
+                within = area > 0 ? side > 0 : side < 0;
+            }
+            if (within) return TriangleMesh::triangleOf(e);
+            e = clockwise ? m_mesh.rotateCw(e) : m_mesh.rotateCcw(e);
+            if (e == start_edge) return TriangleMesh::none;
+        }
+    }
+    return TriangleMesh::none;
+}
+
+/* Inserts the obstacle's nodes into the mesh, constrains its edges and blocks the triangles
+ * within it. Obstacles reaching out of the map are ignored, and so are the ones overlapping
+ * terrain or other obstacles, as their edges could not all be constrained. Those whose edges
+ * only touch them, along their sides or at their corners, are not */
+std::vector<uint32_t> NavMesh::insertObstacle(Terrain* terrain) {
+    std::vector<uint32_t> changed;
+    std::vector<Node*>& nodes = terrain->getShape()->nodes;
+    for (Node* node : nodes) {
+        if (node->coord.x < 0 || node->coord.y < 0 || node->coord.x > m_map_size.x ||
+                node->coord.y > m_map_size.y) return changed;
+    }
+    for (auto i=0; i<nodes.size(); i++) {
+        if (raycast(nodes[i]->coord, nodes[(i + 1) % nodes.size()]->coord).blocked) {
+            return changed;
+        }
+    }
+    indexVertices();
+    m_changed = &changed;
+    std::vector<uint32_t> polygon;
+    uint32_t hint = m_cells[cellOf(nodes[0]->coord)];
+    for (Node* node : nodes) {
+        polygon.push_back(insertVertex(node->coord, hint));
+    }
+    if (constrain(polygon)) block(polygon, true);
+    m_changed = nullptr;
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    reindexTriangles(changed);
+    splitComponents(changed);
+    m_revision++;
+    return changed;
+}
+
+/* Unblocks the triangles within the obstacle, frees its edges and removes the nodes no other
+ * obstacle uses. The obstacle must have the shape it was inserted with */
+std::vector<uint32_t> NavMesh::removeObstacle(Terrain* terrain) {
+    std::vector<uint32_t> changed;
+    std::vector<uint32_t> polygon = getPolygon(terrain);
+    if (polygon.empty()) return changed;
+    m_changed = &changed;
+    block(polygon, false);
+    unconstrain(polygon);
+    for (auto i=0; i<polygon.size(); i++) {
+        uint32_t v = polygon[i];
+        if (--m_vertex_uses[v] > 0) continue;
+        uint32_t moved = removeVertex(v);
+        // The last vertex took the index of the removed one
+        if (moved != TriangleMesh::none) std::replace(polygon.begin(), polygon.end(), moved, v);
+    }
+    m_changed = nullptr;
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    reindexTriangles(changed);
+    joinComponents(changed);
+    m_revision++;
+    return changed;
+}
+
+// Vertices of the terrain's polygon, or none if any of its nodes is not a vertex
+std::vector<uint32_t> NavMesh::getPolygon(Terrain* terrain) {
+    indexVertices();
+    std::vector<uint32_t> polygon;
+    for (Node* node : terrain->getShape()->nodes) {
+        auto it = m_vertex_ids.find(keyOf(node->coord));
+        if (it == m_vertex_ids.end()) return {};
+        polygon.push_back(it->second);
+    }
+    return polygon;
+}
+
+// Of a loaded nav mesh, which are only needed to update it
+void NavMesh::indexVertices() {
+    if (!m_vertex_uses.empty() || !m_file) return;
+    const uint32_t* uses = m_file->getVertexUses();
+    m_vertex_uses.assign(uses, uses + m_mesh.getNVertices());
+    m_vertex_ids.reserve(2 * m_mesh.getNVertices());
+    for (auto v=0; v<m_mesh.getNVertices(); v++) {
+        m_vertex_ids[keyOf(m_mesh.getVertex(v))] = v;
+    }
+}
+
+/* Adds a vertex at the coordinates, unless there is one, splitting the triangle or the edge it
+ * falls on and legalizing around it. Locating starts from the hint, which is left at a
+ * triangle around the vertex */
+uint32_t NavMesh::insertVertex(Coord coord, uint32_t& hint) {
+    auto it = m_vertex_ids.find(keyOf(coord));
+    if (it != m_vertex_ids.end()) {
+        m_vertex_uses[it->second]++;
+        return it->second;
+    }
+    uint32_t t = locate(coord, hint);
+    uint32_t v = m_mesh.addVertex(coord);
+    m_vertex_ids[keyOf(coord)] = v;
+    m_vertex_uses.push_back(1);
+    uint32_t on_edge = TriangleMesh::none;
+    for (auto i=0; i<3; i++) {
+        uint32_t e = 3 * t + i;
+        if (TriangleMesh::orientation(m_mesh.getVertex(m_mesh.getOrigin(e)),
+                m_mesh.getVertex(m_mesh.getTarget(e)), coord) == 0) on_edge = e;
+    }
+    if (on_edge == TriangleMesh::none) {
+        uint32_t added = m_mesh.splitTriangle(t, v);
+        touch(t);
+        touch(added);
+        touch(added + 1);
+        m_suspects.assign({3 * t, 3 * added, 3 * (added + 1)});
+    } else {
+        uint32_t twin = m_mesh.getTwin(on_edge);
+        uint32_t added = m_mesh.splitEdge(on_edge, v);
+        touch(t);
+        touch(added);
+        m_suspects.assign({TriangleMesh::prev(on_edge), 3 * added + 1});
+        if (twin != TriangleMesh::none) {
+            touch(TriangleMesh::triangleOf(twin));
+            touch(added + 1);
+            m_suspects.insert(m_suspects.end(), {TriangleMesh::prev(twin), 3 * (added + 1) + 1});
+        }
+    }
+    flipIllegalEdges(nullptr);
+    hint = TriangleMesh::triangleOf(m_mesh.getVertexEdge(v));
+    return v;
+}
+
+/* Walks from t towards the coordinates, across any edge they are beyond, trying a different
+ * edge first at every step so that the walk cannot cycle. None if out of the mesh */
+uint32_t NavMesh::locate(Coord coord, uint32_t t) const {
+    for (auto step=0; t != TriangleMesh::none; step++) {
+        uint32_t beyond = TriangleMesh::none;
+        for (auto i=0; i<3 && beyond == TriangleMesh::none; i++) {
+            uint32_t e = 3 * t + (step + i) % 3;
+            if (TriangleMesh::orientation(m_mesh.getVertex(m_mesh.getOrigin(e)),
+                    m_mesh.getVertex(m_mesh.getTarget(e)), coord) < 0) beyond = e;
+        }
+        if (beyond == TriangleMesh::none) return t;
+        t = m_mesh.getNeighbour(t, beyond % 3);
+    }
+    return TriangleMesh::none;
+}
+
+/* A walkable triangle sharing the vertex or the edge of t the coordinates are on, if t is
+ * blocked, turning around the vertex as casts do. t if there is none */
+uint32_t NavMesh::toWalkable(Coord coord, uint32_t t) const {
+    if (t == TriangleMesh::none || !m_mesh.isBlocked(t)) return t;
+    for (auto i=0; i<3; i++) {
+        uint32_t e = 3 * t + i;
+        Coord a = m_mesh.getVertex(m_mesh.getOrigin(e));
+        if (a.x != coord.x || a.y != coord.y) continue;
+        // Every triangle around the vertex goes towards it
+        uint32_t blocking;
+        uint32_t u = turn(e, coord, false, blocking);
+        return u == TriangleMesh::none ? t : u;
+    }
+    for (auto i=0; i<3; i++) {
+        uint32_t e = 3 * t + i;
+        Coord a = m_mesh.getVertex(m_mesh.getOrigin(e));
+        Coord b = m_mesh.getVertex(m_mesh.getTarget(e));
+        uint32_t f = m_mesh.getTwin(e);
+        if (TriangleMesh::orientation(a, b, coord) != 0 || f == TriangleMesh::none) continue;
+        if (!m_mesh.isBlocked(TriangleMesh::triangleOf(f))) return TriangleMesh::triangleOf(f);
+    }
+    return t;
+}
+
+/* Walks from t, containing the start of the segment, across the edge it leaves each triangle
+ * through, up to the one containing its end. It leaves through the edge whose origin is on its
+ * right and target on its left, or else through the vertex on it furthest along, around which
+ * it turns to the triangle it goes on into. The start may be on an edge or a vertex of t too,
+ * so it first moves to the triangle the segment goes into from there */
+RayHit NavMesh::cast(Coord from, Coord to, uint32_t t) const {
+    const RayHit start = {true, from, TriangleMesh::none};
+    if (t == TriangleMesh::none) return start;
+    bool on_vertex = false;
+    for (auto i=0; i<3 && !on_vertex; i++) {
+        Coord a = m_mesh.getVertex(m_mesh.getOrigin(3 * t + i));
+        if (a.x != from.x || a.y != from.y) continue;
+        uint32_t blocking;
+        t = turn(3 * t + i, to, false, blocking);
+        on_vertex = true;
+    }
+    for (auto i=0; i<3 && !on_vertex; i++) {
+        uint32_t e = 3 * t + i;
+        Coord a = m_mesh.getVertex(m_mesh.getOrigin(e));
+        Coord b = m_mesh.getVertex(m_mesh.getTarget(e));
+        if (TriangleMesh::orientation(a, b, from) != 0) continue;
+        // Into the twin if beyond the edge, or if along it and t is blocked
+        int64_t side = TriangleMesh::orientation(a, b, to);
+        uint32_t twin = m_mesh.getTwin(e);
+        if (twin == TriangleMesh::none && side < 0) return start;
+        if (twin != TriangleMesh::none && (side < 0 || (side == 0 && m_mesh.isBlocked(t)))) {
+            t = TriangleMesh::triangleOf(twin);
+        }
+        break;
+    }
+    if (t == TriangleMesh::none || m_mesh.isBlocked(t)) return start;
+
+    while (true) {
+        bool within = true;
+        uint32_t exit = TriangleMesh::none;
+        uint32_t corner = TriangleMesh::none;  // Half-edge from the vertex it leaves through
+        int64_t furthest = 0;
+        for (auto i=0; i<3; i++) {
+            uint32_t e = 3 * t + i;
+            Coord a = m_mesh.getVertex(m_mesh.getOrigin(e));
+            Coord b = m_mesh.getVertex(m_mesh.getTarget(e));
+            if (TriangleMesh::orientation(a, b, to) < 0) within = false;
+            int64_t side = TriangleMesh::orientation(from, to, a);
+            if (side < 0 && TriangleMesh::orientation(from, to, b) > 0) exit = e;
+            int64_t along = (int64_t) (a.x - from.x) * (to.x - from.x) +
+                            (int64_t) (a.y - from.y) * (to.y - from.y);
+            if (side == 0 && along > furthest) {
+                furthest = along;
+                corner = e;
+            }
+        }
+        if (within) return {false, to, TriangleMesh::none};
+        if (exit == TriangleMesh::none) {
+            uint32_t blocking;
+            t = turn(corner, to, true, blocking);
+            if (t == TriangleMesh::none) {
+                return {true, m_mesh.getVertex(m_mesh.getOrigin(corner)), blocking};
+            }
+            continue;
+        }
+        if (!isCrossable(exit)) {
+            Coord a = m_mesh.getVertex(m_mesh.getOrigin(exit));
+            Coord b = m_mesh.getVertex(m_mesh.getTarget(exit));
+            int64_t before = TriangleMesh::orientation(a, b, from);
+            int64_t after = TriangleMesh::orientation(a, b, to);
+            double r = (double) before / (before - after);
+            Coord point = {(int_fast16_t) std::lround(from.x + r * (to.x - from.x)),
+                           (int_fast16_t) std::lround(from.y + r * (to.y - from.y))};
+            return {true, point, exit};
+        }
+        t = TriangleMesh::triangleOf(m_mesh.getTwin(exit));
+    }
+}
+
+/* Walkable triangle around the origin of e that the segment to the coordinates goes into past
+ * it, turning both ways from the triangle of e. If crossing, only across edges path finding
+ * crosses, leaving the first one that stops it in blocking. None if there is no such triangle */
+uint32_t NavMesh::turn(uint32_t e, Coord to, bool crossing, uint32_t& blocking) const {
+    Coord v = m_mesh.getVertex(m_mesh.getOrigin(e));
+    blocking = TriangleMesh::none;
+    for (bool ccw : {true, false}) {
+        uint32_t f = e;
+        do {
+            uint32_t u = TriangleMesh::triangleOf(f);
+            Coord x = m_mesh.getVertex(m_mesh.getTarget(f));
+            Coord y = m_mesh.getVertex(m_mesh.getOrigin(TriangleMesh::prev(f)));
+            if (!m_mesh.isBlocked(u) && TriangleMesh::orientation(v, x, to) >= 0 &&
+                    TriangleMesh::orientation(v, y, to) <= 0) return u;
+            uint32_t crossed = ccw ? TriangleMesh::prev(f) : f;
+            if (crossing && !isCrossable(crossed)) {
+                if (blocking == TriangleMesh::none) blocking = crossed;
+                break;
+            }
+            f = ccw ? m_mesh.rotateCcw(f) : m_mesh.rotateCw(f);
+        } while (f != TriangleMesh::none && f != e);
+    }
+    return TriangleMesh::none;
+}
+
+/* Flips the edges around v away until three are left, and collapses their triangles into one.
+ * Each flip closes the ear of v's link whose circumcircle holds no other vertex of it, so the
+ * mesh stays Delaunay (Devillers). Vertices on the boundary of the map or of an obstacle are
+ * kept. Returns the old index of the vertex that took v's, or none if v was kept */
+uint32_t NavMesh::removeVertex(uint32_t v) {
+    Coord center = m_mesh.getVertex(v);
+    while (true) {
+        // The edges from v, counter-clockwise
+        m_fan.clear();
+        uint32_t start = m_mesh.getVertexEdge(v);
+        uint32_t e = start;
+        do {
+            if (m_mesh.isConstrained(e) || m_mesh.isBlocked(TriangleMesh::triangleOf(e))) {
+                return TriangleMesh::none;
+            }
+            m_fan.push_back(e);
+            e = m_mesh.rotateCcw(e);
+        } while (e != TriangleMesh::none && e != start);
+        if (e == TriangleMesh::none) return TriangleMesh::none;
+        if (m_fan.size() == 3) break;
+
+        // Flipping v->x leaves the ear x, y, w, where y follows x around v and w precedes it
+        std::size_t n = m_fan.size();
+        uint32_t ear = TriangleMesh::none;
+        for (auto i=0; i<n && ear == TriangleMesh::none; i++) {
+            Coord x = m_mesh.getVertex(m_mesh.getTarget(m_fan[i]));
+            Coord y = m_mesh.getVertex(m_mesh.getTarget(m_fan[(i + 1) % n]));
+            Coord w = m_mesh.getVertex(m_mesh.getTarget(m_fan[(i + n - 1) % n]));
+            /* Only if the quad v, w, x, y is convex, or with v on wy when four edges are left,
+             * as the flat triangle v, w, y is collapsed right after */
+            int64_t side = TriangleMesh::orientation(y, w, center);
+            if (side > 0 || (side == 0 && n > 4) || TriangleMesh::orientation(y, w, x) <= 0) {
+                continue;
+            }
+            bool empty = true;
+            for (auto j=2; j<n-1 && empty; j++) {
+                Coord z = m_mesh.getVertex(m_mesh.getTarget(m_fan[(i + j) % n]));
+                empty = TriangleMesh::inCircle(x, y, w, z) <= 0;
+            }
+            if (empty) ear = m_fan[i];
+        }
+        if (ear == TriangleMesh::none) {
+            // Undo the harm of the flips so far
+            for (uint32_t e : m_fan) {
+                m_suspects.push_back(TriangleMesh::next(e));
+            }
+            flipIllegalEdges(nullptr);
+            return TriangleMesh::none;
+        }
+        flip(ear);
+    }
+
+    std::size_t n_triangles = m_mesh.getNTriangles();
+    for (uint32_t e : m_fan) {
+        touch(TriangleMesh::triangleOf(e));
+    }
+    // Moved to the removed triangles' indices
+    touch(n_triangles - 1);
+    touch(n_triangles - 2);
+    uint32_t t = m_mesh.collapse(v);
+    m_suspects.assign({3 * t, 3 * t + 1, 3 * t + 2});
+    flipIllegalEdges(nullptr);
+
+    m_vertex_ids.erase(keyOf(center));
+    uint32_t last = m_mesh.removeVertex(v);
+    if (last != v) {
+        m_vertex_ids[keyOf(m_mesh.getVertex(v))] = v;
+        m_vertex_uses[v] = m_vertex_uses[last];
+    }
+    m_vertex_uses.pop_back();
+    return last;
+}
+
+/* Uniform grid over the map, of about two triangles per cell, holding for each cell the last
+ * triangle whose centroid falls in it, or else one around the cell's center. Locating walks
+ * from there, which takes a few steps whatever the size of the map */
+void NavMesh::indexTriangles() {
+    std::size_t n_triangles = std::max<std::size_t>(m_mesh.getNTriangles(), 1);
+    m_cell_size = std::max(1.0, std::sqrt(2.0 * m_map_size.x * m_map_size.y / n_triangles));
+    m_n_columns = m_map_size.x / m_cell_size + 1;
+    uint32_t n_rows = m_map_size.y / m_cell_size + 1;
+    m_cells.assign(m_n_columns * n_rows, TriangleMesh::none);
+    for (uint32_t t=0; t<m_mesh.getNTriangles(); t++) {
+        m_cells[cellOf(m_mesh.getCenter(t))] = t;
+    }
+    uint32_t last = 0;
+    for (uint32_t c=0; c<m_cells.size(); c++) {
+        if (m_cells[c] == TriangleMesh::none) {
+            int_fast16_t x = c % m_n_columns * m_cell_size + m_cell_size / 2;
+            int_fast16_t y = c / m_n_columns * m_cell_size + m_cell_size / 2;
+            Coord center = {std::min<int_fast16_t>(x, m_map_size.x),
+                            std::min<int_fast16_t>(y, m_map_size.y)};
+            uint32_t t = locate(center, last);
+            m_cells[c] = t == TriangleMesh::none ? last : t;
+        }
+        last = m_cells[c];
+    }
+}
+
+/* Points the cells at the triangles changed by an update which are still in the mesh. Cells
+ * pointing at a removed index are only noticed when locating, as walking from anywhere works */
+void NavMesh::reindexTriangles(const std::vector<uint32_t>& changed) {
+    for (uint32_t t : changed) {
+        if (t < m_mesh.getNTriangles()) m_cells[cellOf(m_mesh.getCenter(t))] = t;
+    }
+}
+
+// Of coordinates within the map
+uint32_t NavMesh::cellOf(Coord coord) const {
+    return coord.y / m_cell_size * m_n_columns + coord.x / m_cell_size;
+}
+
+// Floods the walkable triangles across the edges path finding crosses, one label per component
+void NavMesh::labelComponents() {
+    std::size_t n_triangles = m_mesh.getNTriangles();
+    m_components.assign(n_triangles, TriangleMesh::none);
+    m_reached.assign(n_triangles, TriangleMesh::none);
+    // Room for the triangles inserted later, so that inserting one does not copy them all
+    m_components.reserve(2 * n_triangles);
+    m_reached.reserve(2 * n_triangles);
+    m_next_component = 0;
+    std::vector<uint32_t> pending;
+    for (uint32_t t=0; t<n_triangles; t++) {
+        if (m_mesh.isBlocked(t) || m_components[t] != TriangleMesh::none) continue;
+        m_components[t] = m_next_component;
+        pending.assign(1, t);
+        while (!pending.empty()) {
+            uint32_t u = pending.back();
+            pending.pop_back();
+            for (auto i=0; i<3; i++) {
+                if (!isCrossable(3 * u + i)) continue;
+                uint32_t neighbour = TriangleMesh::triangleOf(m_mesh.getTwin(3 * u + i));
+                if (m_components[neighbour] != TriangleMesh::none) continue;
+                m_components[neighbour] = m_next_component;
+                pending.push_back(neighbour);
+            }
+        }
+        m_next_component++;
+    }
+}
+
+// Copied from the file on the first update, and unlabelled at the triangles changed by it
+void NavMesh::resizeComponents(const std::vector<uint32_t>& changed) {
+    std::size_t n_triangles = m_mesh.getNTriangles();
+    if (m_components.empty() && m_file) {
+        const uint32_t* components = m_file->getComponents();
+        m_components.reserve(2 * n_triangles);
+        m_components.assign(components, components + m_file->getArrays().n_triangles);
+        m_reached.reserve(2 * n_triangles);
+    }
+    m_components.resize(n_triangles, TriangleMesh::none);
+    m_reached.resize(n_triangles, TriangleMesh::none);
+    for (uint32_t t : changed) {
+        if (t < n_triangles) m_components[t] = TriangleMesh::none;
+    }
+}
+
+/* Inserting an obstacle can only split components, around the triangles it changed. A search
+ * starts from each walkable one and each walkable neighbour of them, taking a step each in
+ * turn, and searches join as they meet. So the pieces split off are labelled anew once their
+ * searches run out, having gone only through them, while the last search left goes on through
+ * a component which keeps its label, and stops as soon as it reaches a triangle not changed */
+void NavMesh::splitComponents(const std::vector<uint32_t>& changed) {
+    struct Search {
+        uint32_t parent;  // Joined into, or itself
+        std::size_t head;
+        std::vector<uint32_t> queue;
+        bool labelled;  // Reached a triangle not changed
+    };
+
+    resizeComponents(changed);
+    std::vector<Search> searches;
+    std::vector<uint32_t> reached;
+    auto start = [&](uint32_t t) {
+        if (m_mesh.isBlocked(t) || m_reached[t] != TriangleMesh::none) return;
+        m_reached[t] = searches.size();
+        reached.push_back(t);
+        searches.push_back({(uint32_t) searches.size(), 0, {t},
+                            m_components[t] != TriangleMesh::none});
+    };
+    for (uint32_t t : changed) {
+        if (t >= m_mesh.getNTriangles()) continue;
+        start(t);
+        for (auto i=0; i<3; i++) {
+            uint32_t f = m_mesh.getTwin(3 * t + i);
+            if (f != TriangleMesh::none) start(TriangleMesh::triangleOf(f));
+        }
+    }
+    auto find = [&searches](uint32_t s) {
+        while (searches[s].parent != s) {
+            s = searches[s].parent = searches[searches[s].parent].parent;
+        }
+        return s;
+    };
+    // Into the one with more left to search, which is returned
+    auto join = [&searches](uint32_t s, uint32_t r) {
+        if (searches[s].queue.size() - searches[s].head >
+                searches[r].queue.size() - searches[r].head) std::swap(s, r);
+        Search& from = searches[s];
+        Search& into = searches[r];
+        into.queue.insert(into.queue.end(), from.queue.begin() + from.head, from.queue.end());
+        into.labelled = into.labelled || from.labelled;
+        from.parent = r;
+        from.queue.clear();
+        from.head = 0;
+        return r;
+    };
+
+    std::vector<uint32_t> active(searches.size());
+    for (uint32_t s=0; s<searches.size(); s++) {
+        active[s] = s;
+    }
+    while (active.size() > 1 || (active.size() == 1 && !searches[find(active[0])].labelled)) {
+        for (auto i=0; i<active.size();) {
+            uint32_t s = active[i];
+            if (searches[s].parent != s || searches[s].head == searches[s].queue.size()) {
+                active[i] = active.back();
+                active.pop_back();
+                continue;
+            }
+            uint32_t t = searches[s].queue[searches[s].head++];
+            for (auto k=0; k<3; k++) {
+                if (!isCrossable(3 * t + k)) continue;
+                uint32_t u = TriangleMesh::triangleOf(m_mesh.getTwin(3 * t + k));
+                if (m_reached[u] == TriangleMesh::none) {
+                    m_reached[u] = s;
+                    reached.push_back(u);
+                    searches[s].queue.push_back(u);
+                    if (m_components[u] != TriangleMesh::none) searches[s].labelled = true;
+                } else if (find(m_reached[u]) != s) {
+                    s = join(s, find(m_reached[u]));
                 }
             }
+            i++;  // The one joined into is in the list too, and this one goes on its turn
+        }
+    }
+
+    uint32_t last = active.empty() ? TriangleMesh::none : find(active[0]);
+    std::vector<uint32_t> labels(searches.size(), TriangleMesh::none);
+    for (uint32_t t : reached) {
+        if (last != TriangleMesh::none && find(m_reached[t]) == last &&
+                m_components[t] != TriangleMesh::none) {
+            labels[last] = m_components[t];
+            break;
+        }
+    }
+    for (uint32_t t : reached) {
+        uint32_t s = find(m_reached[t]);
+        if (labels[s] == TriangleMesh::none) labels[s] = m_next_component++;
+        m_components[t] = labels[s];
+        m_reached[t] = TriangleMesh::none;
+    }
+}
+
+/* Removing an obstacle can only join components, though it also moves triangles from the end
+ * to the indices of the ones removed, anywhere. The triangles it changed connected to each
+ * other take the label of the first component around them, or a new one, and the components
+ * around them with other labels are flooded over with it */
+void NavMesh::joinComponents(const std::vector<uint32_t>& changed) {
+    resizeComponents(changed);
+    std::vector<uint32_t> pending, piece, joined;
+    for (uint32_t t : changed) {
+        if (t >= m_mesh.getNTriangles() || m_mesh.isBlocked(t) ||
+                m_components[t] != TriangleMesh::none) continue;
+        uint32_t label = TriangleMesh::none;
+        piece.assign(1, t);
+        m_reached[t] = 0;
+        for (auto i=0; i<piece.size(); i++) {
+            for (auto k=0; k<3; k++) {
+                if (!isCrossable(3 * piece[i] + k)) continue;
+                uint32_t u = TriangleMesh::triangleOf(m_mesh.getTwin(3 * piece[i] + k));
+                if (m_components[u] == TriangleMesh::none && m_reached[u] == TriangleMesh::none) {
+                    m_reached[u] = 0;
+                    piece.push_back(u);
+                } else if (m_components[u] != TriangleMesh::none && label == TriangleMesh::none) {
+                    label = m_components[u];
+                } else if (m_components[u] != TriangleMesh::none && m_components[u] != label) {
+                    joined.push_back(u);
+                }
+            }
+        }
+        if (label == TriangleMesh::none) label = m_next_component++;
+        for (uint32_t u : piece) {
+            m_components[u] = label;
+            m_reached[u] = TriangleMesh::none;
+        }
+        for (uint32_t u : joined) {
+            if (m_components[u] == label) continue;
+            m_components[u] = label;
+            pending.push_back(u);
+        }
+        joined.clear();
+        while (!pending.empty()) {
+            uint32_t u = pending.back();
+            pending.pop_back();
+            for (auto k=0; k<3; k++) {
+                if (!isCrossable(3 * u + k)) continue;
+                uint32_t neighbour = TriangleMesh::triangleOf(m_mesh.getTwin(3 * u + k));
+                if (m_components[neighbour] == label) continue;
+                m_components[neighbour] = label;
+                pending.push_back(neighbour);
+            }
         }
-        // Add middle node
-        Coord center = t->getCenter();
-        Node* n = new Node(center, m_origin);
-        m_nodes.push_back(n);
     }
 }
 
-Coord NavMesh::avgCoord(std::vector<Node*>& nodes) const {
+void NavMesh::flip(uint32_t e) {
+    touch(TriangleMesh::triangleOf(e));
+    touch(TriangleMesh::triangleOf(m_mesh.getTwin(e)));
+    m_mesh.flip(e);
+}
+
+// Both sides change, as paths may no longer cross between them, or now may
+void NavMesh::setConstrained(uint32_t e, bool constrained) {
+    touch(TriangleMesh::triangleOf(e));
+    uint32_t f = m_mesh.getTwin(e);
+    if (f != TriangleMesh::none) touch(TriangleMesh::triangleOf(f));
+    m_mesh.setConstrained(e, constrained);
+}
+
+// Records the triangle as changed, during an update
+void NavMesh::touch(uint32_t t) {
+    if (m_changed != nullptr) m_changed->push_back(t);
+}
+
+uint32_t NavMesh::keyOf(Coord coord) {
+    return ((uint32_t) (uint16_t) coord.x << 16) | (uint16_t) coord.y;
+}
+
+// Center of the bounding box of the first vertices
+Coord NavMesh::avgCoord(std::size_t n_vertices) const {
     Coord max = {0, 0};  // Assuming no negative values, as coordinates are always positive
     Coord min = {m_map_size.x, m_map_size.y};
-    for (auto n : nodes) {
-        if (n->coord.x > max.x) max.x = n->coord.x;
-        if (n->coord.x < min.x) min.x = n->coord.x;
-        if (n->coord.y > max.y) max.y = n->coord.y;
-        if (n->coord.y < min.y) min.y = n->coord.y;
+    for (auto v=0; v<n_vertices; v++) {
+        Coord coord = m_mesh.getVertex(v);
+        if (coord.x > max.x) max.x = coord.x;
+        if (coord.x < min.x) min.x = coord.x;
+        if (coord.y > max.y) max.y = coord.y;
+        if (coord.y < min.y) min.y = coord.y;
     }
     return {(max.x + min.x) / 2, (max.y + min.y) / 2};
 }
@@ -378,10 +1079,180 @@ MapSize NavMesh::getMapSize() const {
     return m_map_size;
 }
 
-TriangleMesh NavMesh::getMesh() const {
+const TriangleMesh& NavMesh::getMesh() const {
     return m_mesh;
 }
 
-std::vector<Node*> NavMesh::getNodes() const {
-    return m_nodes;
+uint32_t NavMesh::getRevision() const {
+    return m_revision;
+}
+
+uint32_t NavMesh::getComponent(uint32_t t) const {
+    return m_components.empty() && m_file ? m_file->getComponents()[t] : m_components[t];
+}
+
+/* Best-first through the triangles around the coordinates, blocked or not, by their distance
+ * to them, up to the first one in the component, as the segment to its nearest point only
+ * crosses nearer ones. That point, on an edge, is often located across it or rounded out of
+ * it, so the ones around it are tried, and then the ones towards its center. The coordinates
+ * are returned if the component is not in the mesh */
+Coord NavMesh::findNearest(Coord coord, uint32_t component) const {
+    auto isIn = [this](Coord c, uint32_t component) {
+        uint32_t t = findTriangle(c);
+        return t != TriangleMesh::none && getComponent(t) == component;
+    };
+    // Distance to the nearest point of the triangle, which is left in x and y
+    auto nearest = [this, coord](uint32_t t, double& x, double& y) {
+        double best = std::numeric_limits<double>::infinity();
+        x = coord.x;
+        y = coord.y;
+        bool within = true;
+        for (auto i=0; i<3; i++) {
+            Coord a = m_mesh.getVertex(m_mesh.getOrigin(3 * t + i));
+            Coord b = m_mesh.getVertex(m_mesh.getTarget(3 * t + i));
+            if (TriangleMesh::orientation(a, b, coord) >= 0) continue;
+            within = false;
+            double dx = b.x - a.x, dy = b.y - a.y;
+            double r = ((coord.x - a.x) * dx + (coord.y - a.y) * dy) / (dx * dx + dy * dy);
+            r = std::min(std::max(r, 0.0), 1.0);
+            double d = std::hypot(a.x + r * dx - coord.x, a.y + r * dy - coord.y);
+            if (d >= best) continue;
+            best = d;
+            x = a.x + r * dx;
+            y = a.y + r * dy;
+        }
+        return within ? 0 : best;
+    };
+    Coord clamped = {std::min<int_fast16_t>(std::max<int_fast16_t>(coord.x, 0), m_map_size.x),
+                     std::min<int_fast16_t>(std::max<int_fast16_t>(coord.y, 0), m_map_size.y)};
+    uint32_t first = findTriangle(clamped);
+    auto greater = std::greater<std::pair<double, uint32_t>>();
+    std::vector<std::pair<double, uint32_t>> open = {{0, first}};
+    std::unordered_set<uint32_t> seen = {first};
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), greater);
+        uint32_t t = open.back().second;
+        open.pop_back();
+        if (getComponent(t) == component) {
+            double x, y;
+            nearest(t, x, y);
+            Coord center = m_mesh.getCenter(t);
+            Coord best = center;
+            double best_d = std::numeric_limits<double>::infinity();
+            for (auto d_x=-1; d_x<=1; d_x++) {
+                for (auto d_y=-1; d_y<=1; d_y++) {
+                    Coord c = {(int_fast16_t) (std::lround(x) + d_x),
+                               (int_fast16_t) (std::lround(y) + d_y)};
+                    double d = std::hypot(c.x - coord.x, c.y - coord.y);
+                    if (d >= best_d || !isIn(c, component)) continue;
+                    best = c;
+                    best_d = d;
+                }
+            }
+            // On an edge of a thin triangle, they may all be across it
+            double length = std::hypot(center.x - x, center.y - y);
+            for (auto i=1; i<length && best_d == std::numeric_limits<double>::infinity(); i++) {
+                Coord c = {(int_fast16_t) std::lround(x + (center.x - x) * i / length),
+                           (int_fast16_t) std::lround(y + (center.y - y) * i / length)};
+                if (isIn(c, component)) return c;
+            }
+            return best;
+        }
+        for (auto i=0; i<3; i++) {
+            uint32_t f = m_mesh.getTwin(3 * t + i);
+            if (f == TriangleMesh::none) continue;
+            uint32_t u = TriangleMesh::triangleOf(f);
+            if (!seen.insert(u).second) continue;
+            double x, y;
+            open.push_back({nearest(u, x, y), u});
+            std::push_heap(open.begin(), open.end(), greater);
+        }
+    }
+    return coord;
+}
+
+// Walks from the triangle indexed at the coordinates' cell
+uint32_t NavMesh::findTriangle(Coord coord) const {
+    if (coord.x < 0 || coord.y < 0 || coord.x > m_map_size.x || coord.y > m_map_size.y) {
+        return TriangleMesh::none;
+    }
+    uint32_t start = m_cells[cellOf(coord)];
+    return toWalkable(coord, locate(coord, start < m_mesh.getNTriangles() ? start : 0));
+}
+
+/* Units are usually close to the one before them, e.g. when sorted or grouped, so each walk
+ * starts from the previous triangle if the coordinates share its cell */
+void NavMesh::findTriangles(const std::vector<Coord>& coords,
+        std::vector<uint32_t>& triangles) const {
+    triangles.resize(coords.size());
+    uint32_t last_cell = TriangleMesh::none;
+    uint32_t last = TriangleMesh::none;
+    for (auto i=0; i<coords.size(); i++) {
+        Coord coord = coords[i];
+        if (coord.x < 0 || coord.y < 0 || coord.x > m_map_size.x || coord.y > m_map_size.y) {
+            triangles[i] = TriangleMesh::none;
+            continue;
+        }
+        uint32_t cell = cellOf(coord);
+        uint32_t start = cell == last_cell ? last : m_cells[cell];
+        last = locate(coord, start < m_mesh.getNTriangles() ? start : 0);
+        last_cell = cell;
+        triangles[i] = toWalkable(coord, last);
+    }
+}
+
+RayHit NavMesh::raycast(Coord from, Coord to) const {
+    return cast(from, to, findTriangle(from));
+}
+
+/* Rays from the same coordinates, as a unit casting several, start from the triangle found
+ * for the first one, and otherwise locating them walks from the last one if in its cell */
+void NavMesh::raycast(const std::vector<Ray>& rays, std::vector<RayHit>& hits) const {
+    hits.resize(rays.size());
+    uint32_t last_cell = TriangleMesh::none;
+    uint32_t last = TriangleMesh::none;
+    Coord last_from = {-1, -1};
+    for (auto i=0; i<rays.size(); i++) {
+        Coord from = rays[i].from;
+        if (from.x < 0 || from.y < 0 || from.x > m_map_size.x || from.y > m_map_size.y) {
+            hits[i] = cast(from, rays[i].to, TriangleMesh::none);
+            continue;
+        }
+        if (from.x != last_from.x || from.y != last_from.y) {
+            uint32_t cell = cellOf(from);
+            uint32_t start = cell == last_cell ? last : m_cells[cell];
+            last = locate(from, start < m_mesh.getNTriangles() ? start : 0);
+            last_cell = cell;
+            last_from = from;
+        }
+        hits[i] = cast(from, rays[i].to, last);
+    }
+}
+
+// Walkable ones only
+std::vector<Coord> NavMesh::getNodes() const {
+    std::vector<Coord> nodes;
+    for (auto v=0; v<m_mesh.getNVertices(); v++) {
+        nodes.push_back(m_mesh.getVertex(v));
+    }
+    for (auto e=0; e<m_mesh.getNHalfEdges(); e++) {
+        // Add intermediate nodes at each edge, once
+        uint32_t twin = m_mesh.getTwin(e);
+        if (twin != TriangleMesh::none && twin < e) continue;
+        if (m_mesh.isBlocked(TriangleMesh::triangleOf(e)) && (twin == TriangleMesh::none ||
+                m_mesh.isBlocked(TriangleMesh::triangleOf(twin)))) continue;
+        Coord a = m_mesh.getVertex(m_mesh.getOrigin(e));
+        Coord b = m_mesh.getVertex(m_mesh.getTarget(e));
+        // Do not create intermediate nodes for small edges
+        int diff_x = std::abs(a.x - b.x);
+        int diff_y = std::abs(a.y - b.y);
+        if (diff_x >= 10 && diff_y >= 10) {
+            nodes.push_back({std::min(a.x, b.x) + (diff_x / 2), std::min(a.y, b.y) + (diff_y / 2)});
+        }
+    }
+    for (auto t=0; t<m_mesh.getNTriangles(); t++) {
+        // Add middle node
+        if (!m_mesh.isBlocked(t)) nodes.push_back(m_mesh.getCenter(t));
+    }
+    return nodes;
 }
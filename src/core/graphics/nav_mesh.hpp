@@ -8,40 +8,146 @@
 #define NAV_MESH_HPP
 
 #include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
 #include <exception>
 #include "map_size.hpp"
 #include "./coord.hpp"
-#include "./elements/node.hpp"
-#include "./elements/triangle.hpp"
+#include "./triangle_mesh.hpp"
+#include "./nav_mesh_file.hpp"
 #include "./elements/hull.hpp"
 #include "../logic/elements/terrain.hpp"
 
 namespace adamant {
 namespace graphics {
 
-using TriangleMesh = std::vector<graphics::elements::Triangle*>;
+typedef struct Ray {
+    Coord from;
+    Coord to;
+} Ray;
+
+typedef struct RayHit {
+    bool blocked;  // Whether the segment leaves walkable space before its end
+    Coord point;  // Where it first does, rounded, or its end
+    // Half-edge it leaves through, of the last walkable triangle, one at the vertex if through one
+    uint32_t edge;
+} RayHit;
 
 class NavMesh {
+    std::shared_ptr<const NavMeshFile> m_file;  // The mesh views it until first modified
     const MapSize m_map_size;
     TriangleMesh m_mesh;
     Coord m_origin;
-    std::vector<graphics::elements::Node*> m_nodes;
+    std::unordered_map<uint32_t, uint32_t> m_vertex_ids;  // By packed coordinates, once indexed
+    std::vector<uint32_t> m_vertex_uses;  // Obstacles and corners at each vertex
+    std::vector<uint32_t> m_suspects;  // Half-edges left to legalize
+    std::vector<uint32_t> m_crossings;  // Half-edges crossing the constraint being inserted
+    std::vector<uint32_t> m_fan;  // Half-edges around the vertex being removed
+    std::vector<uint32_t>* m_changed;  // Triangles changed by the current update, if any
+    int_least16_t m_cell_size;  // Of the point-location grid, in pixels
+    uint32_t m_n_columns;
+    std::vector<uint32_t> m_cells;  // A triangle near each cell, to walk from
+    uint32_t m_revision;  // Number of updates
+    std::vector<uint32_t> m_components;  // Per triangle, none if blocked, once labelled
+    uint32_t m_next_component;  // Labels are not reused, as components split and join
+    std::vector<uint32_t> m_reached;  // Search that reached each triangle, when labelling
 
-    void drawFirstTriangle(std::vector<graphics::elements::Node*>& nodes, graphics::elements::Hull& frontier);
-    graphics::elements::Triangle* legalize(graphics::elements::Triangle* candidate);
-    void sideWalk(graphics::elements::Edge* edge, graphics::elements::Edge* neighbour, graphics::elements::Hull& frontier);
-    void finalWalk(graphics::elements::Edge* initial_edge, graphics::elements::Hull& frontier);
+    void addVertices(std::vector<logic::elements::Terrain*>& terrains);
+    uint32_t drawFirstTriangle(std::vector<uint32_t>& vertices);
+    void legalize(uint32_t triangle, graphics::elements::Hull& frontier);
+    void flipIllegalEdges(graphics::elements::Hull* frontier);
+    bool fillCorner(uint32_t v, graphics::elements::Hull& frontier);
+    void sideWalk(uint32_t n, bool leftwards, graphics::elements::Hull& frontier);
+    void finalWalk(graphics::elements::Hull& frontier);
     void triangulate(std::vector<logic::elements::Terrain*>& terrains);
-    void removeTrianglesWithin(std::vector<logic::elements::Terrain*>& terrains);
-    void populateNodes();
-    Coord avgCoord(std::vector<graphics::elements::Node*>& nodes) const;
+    bool constrain(const std::vector<uint32_t>& polygon);
+    void unconstrain(const std::vector<uint32_t>& polygon);
+    bool insertConstraint(uint32_t a, uint32_t b);
+    uint32_t findCrossings(uint32_t a, uint32_t b);
+    void removeCrossings(uint32_t a, uint32_t b);
+    void block(const std::vector<uint32_t>& polygon, bool blocked);
+    uint32_t findTriangleWithin(const std::vector<uint32_t>& polygon);
+    std::vector<uint32_t> getPolygon(logic::elements::Terrain* terrain);
+    void indexVertices();
+    uint32_t insertVertex(Coord coord, uint32_t& hint);
+    uint32_t locate(Coord coord, uint32_t t) const;
+    uint32_t toWalkable(Coord coord, uint32_t t) const;
+    RayHit cast(Coord from, Coord to, uint32_t t) const;
+    uint32_t turn(uint32_t e, Coord to, bool crossing, uint32_t& blocking) const;
+    void indexTriangles();
+    void reindexTriangles(const std::vector<uint32_t>& changed);
+    uint32_t cellOf(Coord coord) const;
+    void labelComponents();
+    void resizeComponents(const std::vector<uint32_t>& changed);
+    void splitComponents(const std::vector<uint32_t>& changed);
+    void joinComponents(const std::vector<uint32_t>& changed);
+    uint32_t removeVertex(uint32_t v);
+    void flip(uint32_t e);
+    void setConstrained(uint32_t e, bool constrained = true);
+    void touch(uint32_t t);
+    static uint32_t keyOf(Coord coord);
+    Coord avgCoord(std::size_t n_vertices) const;
 
     public:
         // May throw InsufficientNodesException or FailedTriangulationException
         NavMesh(std::vector<logic::elements::Terrain*> terrains, MapSize map_size);
+        // Maps a baked nav mesh. May throw NavMeshFile::InvalidFileException
+        explicit NavMesh(const std::string& path);
+        // Writes the nav mesh to be loaded as above. May throw NavMeshFile::FailedWriteException
+        void bake(const std::string& path) const;
         MapSize getMapSize() const;
-        TriangleMesh getMesh() const;
-        std::vector<elements::Node*> getNodes() const;
+        const TriangleMesh& getMesh() const;
+        std::vector<Coord> getNodes() const;  // Vertices, edge midpoints and triangle centers
+        /* Triangle containing the coordinates, or none if out of the map. Blocked only if they
+         * are within an obstacle, not on its border, where a walkable one shares them */
+        uint32_t findTriangle(Coord coord) const;
+        // The same for many coordinates at once, into the given vector
+        void findTriangles(const std::vector<Coord>& coords,
+                std::vector<uint32_t>& triangles) const;
+        /* Both retriangulate only around the obstacle, and return the sorted indices of the
+         * triangles changed, including the ones past the new number of triangles, removed.
+         * None if the obstacle was ignored, e.g. as it overlaps terrain */
+        std::vector<uint32_t> insertObstacle(logic::elements::Terrain* terrain);
+        std::vector<uint32_t> removeObstacle(logic::elements::Terrain* terrain);
+        uint32_t getRevision() const;  // Changes with every update
+        // Shared by the walkable triangles connected to each other, none for blocked ones
+        uint32_t getComponent(uint32_t t) const;
+        // Nearest coordinates to the given ones within a triangle of the component
+        Coord findNearest(Coord coord, uint32_t component) const;
+        /* Walks the triangles along the segment up to the first edge path finding does not
+         * cross, going around the vertices it passes through on whichever side it can. Only
+         * grazing an obstacle does not block it. Blocked at the start, with no edge, if it
+         * goes into no walkable triangle from there */
+        RayHit raycast(Coord from, Coord to) const;
+        // The same for many rays at once, into the given vector
+        void raycast(const std::vector<Ray>& rays, std::vector<RayHit>& hits) const;
+
+        // Between walkable triangles, not along an obstacle, so path finding goes through it
+        bool isCrossable(uint32_t e) const {
+            uint32_t f = m_mesh.getTwin(e);
+            return f != TriangleMesh::none && !m_mesh.isConstrained(e) &&
+                   !m_mesh.isBlocked(TriangleMesh::triangleOf(e)) &&
+                   !m_mesh.isBlocked(TriangleMesh::triangleOf(f));
+        }
+
+        // Where searches moving between edges go through it, rounded down
+        Coord getMidpoint(uint32_t e) const {
+            Coord a = m_mesh.getVertex(m_mesh.getOrigin(e));
+            Coord b = m_mesh.getVertex(m_mesh.getTarget(e));
+            return {(a.x + b.x) / 2, (a.y + b.y) / 2};
+        }
+
+        // Calls visit(e, u, midpoint of e) for each crossable half-edge e of t, into u
+        template <typename Visit>
+        void forEachCrossing(uint32_t t, Visit visit) const {
+            for (auto k=0; k<3; k++) {
+                uint32_t e = 3 * t + k;
+                if (!isCrossable(e)) continue;
+                visit(e, TriangleMesh::triangleOf(m_mesh.getTwin(e)), getMidpoint(e));
+            }
+        }
 
         struct InsufficientNodesException: public std::exception {
             const char* what() const noexcept;
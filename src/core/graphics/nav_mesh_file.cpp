@@ -0,0 +1,171 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "nav_mesh_file.hpp"
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace adamant::graphics;
+
+static_assert(sizeof(int_least16_t) == 2, "Coordinates are stored as 16-bit integers");
+
+static const char magic[8] = {'A', 'D', 'N', 'A', 'V', 'M', 'S', 'H'};
+static const uint32_t byte_order = 0x01020304;
+
+const uint32_t NavMeshFile::version;
+
+// May throw InvalidFileException
+NavMeshFile::NavMeshFile(const std::string& path): m_data{nullptr}, m_size{0},
+        m_header{nullptr} {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw InvalidFileException();
+    struct stat status;
+    if (fstat(fd, &status) < 0 || (std::size_t) status.st_size < sizeof(Header)) {
+        close(fd);
+        throw InvalidFileException();
+    }
+    m_size = status.st_size;
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // The mapping keeps the file open
+    if (data == MAP_FAILED) throw InvalidFileException();
+    m_data = (const uint8_t*) data;
+    m_header = (const Header*) m_data;
+
+    // Only the layout is checked, so that no page of the arrays is read before it is needed
+    bool valid = std::memcmp(m_header->magic, magic, sizeof(magic)) == 0 &&
+                 m_header->version == version && m_header->byte_order == byte_order &&
+                 m_header->cell_size > 0;
+    for (auto i=0; i<n_arrays && valid; i++) {
+        uint64_t offset = m_header->offsets[i];
+        std::size_t length = getLength((Array) i, *m_header);
+        valid = offset % 8 == 0 && offset >= sizeof(Header) && offset <= m_size &&
+                length <= m_size - offset;
+    }
+    if (!valid) {
+        munmap((void*) m_data, m_size);
+        throw InvalidFileException();
+    }
+}
+
+NavMeshFile::~NavMeshFile() {
+    munmap((void*) m_data, m_size);
+}
+
+const char* NavMeshFile::InvalidFileException::what() const throw() {
+    return "The nav mesh file is missing, truncated or of another version.";
+}
+
+const char* NavMeshFile::FailedWriteException::what() const throw() {
+    return "The nav mesh file could not be written.";
+}
+
+MapSize NavMeshFile::getMapSize() const {
+    return {m_header->map_x, m_header->map_y};
+}
+
+TriangleMesh::Arrays NavMeshFile::getArrays() const {
+    return {m_header->n_vertices, m_header->n_triangles, getArray<int_least16_t>(xs),
+            getArray<int_least16_t>(ys), getArray<uint32_t>(vertex_edges),
+            getArray<uint32_t>(origins), getArray<uint32_t>(twins), getArray<uint8_t>(flags)};
+}
+
+const uint32_t* NavMeshFile::getVertexUses() const {
+    return getArray<uint32_t>(vertex_uses);
+}
+
+int_least16_t NavMeshFile::getCellSize() const {
+    return m_header->cell_size;
+}
+
+const uint32_t* NavMeshFile::getCells() const {
+    return getArray<uint32_t>(cells);
+}
+
+std::size_t NavMeshFile::getNCells() const {
+    return m_header->n_cells;
+}
+
+const uint32_t* NavMeshFile::getComponents() const {
+    return getArray<uint32_t>(components);
+}
+
+uint32_t NavMeshFile::getNextComponent() const {
+    return m_header->next_component;
+}
+
+/* Written next to the path and then renamed over it, so that processes which mapped the old
+ * file keep reading it whole. May throw FailedWriteException */
+void NavMeshFile::write(const std::string& path, MapSize map_size, const TriangleMesh& mesh,
+        const uint32_t* uses, int_least16_t cell_size, const std::vector<uint32_t>& grid,
+        const uint32_t* components, uint32_t next_component) {
+    const TriangleMesh::Arrays& arrays = mesh.getArrays();
+    const void* data[n_arrays] = {arrays.xs, arrays.ys, arrays.vertex_edges, uses,
+                                  arrays.origins, arrays.twins, arrays.flags, grid.data(),
+                                  components};
+    Header header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byte_order = byte_order;
+    header.map_x = map_size.x;
+    header.map_y = map_size.y;
+    header.n_vertices = arrays.n_vertices;
+    header.n_triangles = arrays.n_triangles;
+    header.cell_size = cell_size;
+    header.n_cells = grid.size();
+    header.next_component = next_component;
+    uint64_t offset = (sizeof(Header) + 7) / 8 * 8;
+    for (auto i=0; i<n_arrays; i++) {
+        header.offsets[i] = offset;
+        offset += (getLength((Array) i, header) + 7) / 8 * 8;
+    }
+
+    std::string tmp_path = path + ".tmp";
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    const char padding[8] = {};
+    file.write((const char*) &header, sizeof(Header));
+    file.write(padding, header.offsets[0] - sizeof(Header));
+    for (auto i=0; i<n_arrays; i++) {
+        std::size_t length = getLength((Array) i, header);
+        if (length > 0) file.write((const char*) data[i], length);
+        file.write(padding, (8 - length % 8) % 8);
+    }
+    file.close();
+    if (!file || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw FailedWriteException();
+    }
+}
+
+template <typename T>
+const T* NavMeshFile::getArray(Array array) const {
+    return (const T*) (m_data + m_header->offsets[array]);
+}
+
+// In bytes
+std::size_t NavMeshFile::getLength(Array array, const Header& header) {
+    switch (array) {
+        case xs:
+        case ys:
+            return header.n_vertices * sizeof(int_least16_t);
+        case vertex_edges:
+        case vertex_uses:
+            return header.n_vertices * sizeof(uint32_t);
+        case origins:
+        case twins:
+            return 3 * (std::size_t) header.n_triangles * sizeof(uint32_t);
+        case flags:
+            return header.n_triangles * sizeof(uint8_t);
+        case components:
+            return header.n_triangles * sizeof(uint32_t);
+        default:
+            return header.n_cells * sizeof(uint32_t);
+    }
+}
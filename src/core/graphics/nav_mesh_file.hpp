@@ -0,0 +1,85 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef NAV_MESH_FILE_HPP
+#define NAV_MESH_FILE_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+#include "map_size.hpp"
+#include "./triangle_mesh.hpp"
+
+namespace adamant {
+namespace graphics {
+
+/* Baked nav mesh, mapped read-only into memory. The file is a header followed by the arrays of
+ * the mesh, as they are in memory, each at an offset from the start of the file aligned to 8
+ * bytes, so the mesh reads them in place and processes mapping the same file share its pages.
+ * Neighbours are the twins of the half-edges, and the nodes are derived from the triangles.
+ * The point-location grid is stored too, but copied when loaded, as it is small, while the
+ * connected components of the triangles are read in place as the mesh is */
+class NavMeshFile {
+    public:
+        static const uint32_t version = 3;  // Bumped on any change of the layout
+
+        // May throw InvalidFileException
+        explicit NavMeshFile(const std::string& path);
+        ~NavMeshFile();
+        NavMeshFile(const NavMeshFile&) = delete;
+        NavMeshFile& operator=(const NavMeshFile&) = delete;
+        MapSize getMapSize() const;
+        TriangleMesh::Arrays getArrays() const;
+        const uint32_t* getVertexUses() const;  // Obstacles and corners at each vertex
+        int_least16_t getCellSize() const;  // Of the point-location grid
+        const uint32_t* getCells() const;
+        std::size_t getNCells() const;
+        const uint32_t* getComponents() const;  // Per triangle
+        uint32_t getNextComponent() const;  // Label for the next one split off
+        // May throw FailedWriteException
+        static void write(const std::string& path, MapSize map_size, const TriangleMesh& mesh,
+                const uint32_t* uses, int_least16_t cell_size, const std::vector<uint32_t>& grid,
+                const uint32_t* components, uint32_t next_component);
+
+        struct InvalidFileException: public std::exception {
+            const char* what() const noexcept;
+        };
+
+        struct FailedWriteException: public std::exception {
+            const char* what() const noexcept;
+        };
+
+    private:
+        enum Array {xs, ys, vertex_edges, vertex_uses, origins, twins, flags, cells, components,
+                    n_arrays};
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;  // Reads differently if written on a machine of other endianness
+            int16_t map_x;
+            int16_t map_y;
+            uint32_t n_vertices;
+            uint32_t n_triangles;
+            uint32_t cell_size;
+            uint32_t n_cells;
+            uint32_t next_component;
+            uint64_t offsets[n_arrays];  // In bytes, from the start of the file
+        };
+
+        const uint8_t* m_data;
+        std::size_t m_size;
+        const Header* m_header;
+        template <typename T> const T* getArray(Array array) const;
+        static std::size_t getLength(Array array, const Header& header);
+};
+
+}  // namespace graphics
+}  // namespace adamant
+
+#endif
@@ -0,0 +1,357 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "triangle_mesh.hpp"
+#include <algorithm>
+
+using namespace adamant::graphics;
+
+const uint32_t TriangleMesh::none;
+const uint8_t TriangleMesh::blocked_flag;
+
+TriangleMesh::TriangleMesh(): m_view{false} {
+    refresh();
+}
+
+TriangleMesh::TriangleMesh(const Arrays& arrays): m_arrays(arrays), m_view{true} {}
+
+// The copy of an owned mesh reads from its own vectors
+TriangleMesh::TriangleMesh(const TriangleMesh& other): m_arrays(other.m_arrays),
+        m_view{other.m_view}, m_xs(other.m_xs), m_ys(other.m_ys), m_origins(other.m_origins),
+        m_twins(other.m_twins), m_flags(other.m_flags), m_vertex_edges(other.m_vertex_edges) {
+    if (!m_view) refresh();
+}
+
+TriangleMesh& TriangleMesh::operator=(const TriangleMesh& other) {
+    if (this == &other) return *this;
+    m_arrays = other.m_arrays;
+    m_view = other.m_view;
+    m_xs = other.m_xs;
+    m_ys = other.m_ys;
+    m_origins = other.m_origins;
+    m_twins = other.m_twins;
+    m_flags = other.m_flags;
+    m_vertex_edges = other.m_vertex_edges;
+    if (!m_view) refresh();
+    return *this;
+}
+
+// To be called whenever the vectors may have been reallocated or resized
+void TriangleMesh::refresh() {
+    m_arrays = {m_xs.size(), m_flags.size(), m_xs.data(), m_ys.data(), m_vertex_edges.data(),
+                m_origins.data(), m_twins.data(), m_flags.data()};
+}
+
+// Copies the viewed arrays before the first modification
+void TriangleMesh::detach() {
+    if (!m_view) return;
+    std::size_t n_vertices = m_arrays.n_vertices;
+    std::size_t n_half_edges = 3 * m_arrays.n_triangles;
+    m_xs.assign(m_arrays.xs, m_arrays.xs + n_vertices);
+    m_ys.assign(m_arrays.ys, m_arrays.ys + n_vertices);
+    m_vertex_edges.assign(m_arrays.vertex_edges, m_arrays.vertex_edges + n_vertices);
+    m_origins.assign(m_arrays.origins, m_arrays.origins + n_half_edges);
+    m_twins.assign(m_arrays.twins, m_arrays.twins + n_half_edges);
+    m_flags.assign(m_arrays.flags, m_arrays.flags + m_arrays.n_triangles);
+    m_view = false;
+    refresh();
+}
+
+uint32_t TriangleMesh::addVertex(Coord coord) {
+    detach();
+    m_xs.push_back(coord.x);
+    m_ys.push_back(coord.y);
+    m_vertex_edges.push_back(none);
+    refresh();
+    return m_xs.size() - 1;
+}
+
+uint32_t TriangleMesh::addTriangle(uint32_t a, uint32_t b, uint32_t c) {
+    detach();
+    uint32_t t = getNTriangles();
+    m_origins.insert(m_origins.end(), {a, b, c});
+    m_twins.insert(m_twins.end(), {none, none, none});
+    m_flags.push_back(0);
+    m_vertex_edges[a] = 3 * t;
+    m_vertex_edges[b] = 3 * t + 1;
+    m_vertex_edges[c] = 3 * t + 2;
+    refresh();
+    return t;
+}
+
+void TriangleMesh::link(uint32_t e, uint32_t f) {
+    detach();
+    if (e != none) m_twins[e] = f;
+    if (f != none) m_twins[f] = e;
+}
+
+/* abc becomes abv, and bcv and cav are added, taking over the edges bc and ca */
+uint32_t TriangleMesh::splitTriangle(uint32_t t, uint32_t v) {
+    detach();
+    uint32_t a = m_origins[3 * t];
+    uint32_t b = m_origins[3 * t + 1];
+    uint32_t c = m_origins[3 * t + 2];
+    uint32_t bc_twin = m_twins[3 * t + 1];
+    uint32_t ca_twin = m_twins[3 * t + 2];
+    bool bc_constrained = isConstrained(3 * t + 1);
+    bool ca_constrained = isConstrained(3 * t + 2);
+    uint32_t bcv = addTriangle(b, c, v);
+    uint32_t cav = addTriangle(c, a, v);
+    setBlocked(bcv, isBlocked(t));
+    setBlocked(cav, isBlocked(t));
+    m_origins[3 * t + 2] = v;
+    link(3 * bcv, bc_twin);
+    link(3 * cav, ca_twin);
+    setEdgeConstrained(3 * bcv, bc_constrained);
+    setEdgeConstrained(3 * cav, ca_constrained);
+    setEdgeConstrained(3 * t + 1, false);
+    setEdgeConstrained(3 * t + 2, false);
+    link(3 * t + 1, 3 * bcv + 2);
+    link(3 * bcv + 1, 3 * cav + 2);
+    link(3 * cav + 1, 3 * t + 2);
+    m_vertex_edges[v] = 3 * t + 2;
+    return bcv;
+}
+
+/* With e = ab in abc, and its twin ba in bad: abc becomes avc and vbc is added, then bad becomes
+ * bvd and vad is added. Both halves of ab keep its constraint */
+uint32_t TriangleMesh::splitEdge(uint32_t e, uint32_t v) {
+    detach();
+    uint32_t f = m_twins[e];
+    uint32_t e_next = next(e);
+    uint32_t b = m_origins[e_next];
+    uint32_t c = m_origins[prev(e)];
+    uint32_t bc_twin = m_twins[e_next];
+    bool bc_constrained = isConstrained(e_next);
+    bool constrained = isConstrained(e);
+    uint32_t vbc = addTriangle(v, b, c);
+    setBlocked(vbc, isBlocked(triangleOf(e)));
+    m_origins[e_next] = v;
+    link(3 * vbc + 1, bc_twin);
+    link(e_next, 3 * vbc + 2);
+    setEdgeConstrained(3 * vbc, constrained);
+    setEdgeConstrained(3 * vbc + 1, bc_constrained);
+    setEdgeConstrained(e_next, false);
+    if (f != none) {
+        uint32_t f_next = next(f);
+        uint32_t a = m_origins[f_next];
+        uint32_t d = m_origins[prev(f)];
+        uint32_t ad_twin = m_twins[f_next];
+        bool ad_constrained = isConstrained(f_next);
+        uint32_t vad = addTriangle(v, a, d);
+        setBlocked(vad, isBlocked(triangleOf(f)));
+        m_origins[f_next] = v;
+        link(3 * vad + 1, ad_twin);
+        link(f_next, 3 * vad + 2);
+        setEdgeConstrained(3 * vad, constrained);
+        setEdgeConstrained(3 * vad + 1, ad_constrained);
+        setEdgeConstrained(f_next, false);
+        link(e, 3 * vad);
+        link(f, 3 * vbc);
+    }
+    return vbc;
+}
+
+/* The triangle of the first edge around v takes the outer edges of the other two, which are
+ * removed, so that v is left without triangles */
+uint32_t TriangleMesh::collapse(uint32_t v) {
+    detach();
+    uint32_t edges[3] = {m_vertex_edges[v], none, none};
+    edges[1] = rotateCcw(edges[0]);
+    edges[2] = rotateCcw(edges[1]);
+    uint32_t origins[3], twins[3];
+    bool constrained[3];
+    for (auto i=0; i<3; i++) {
+        uint32_t outer = next(edges[i]);
+        origins[i] = m_origins[outer];
+        twins[i] = m_twins[outer];
+        constrained[i] = isConstrained(outer);
+    }
+    uint32_t t = triangleOf(edges[0]);
+    for (auto i=0; i<3; i++) {
+        m_origins[3 * t + i] = origins[i];
+        link(3 * t + i, twins[i]);
+        setEdgeConstrained(3 * t + i, constrained[i]);
+        m_vertex_edges[origins[i]] = 3 * t + i;
+    }
+    m_vertex_edges[v] = none;
+
+    // Removing the higher index first, as it may move the triangle at the lower one
+    uint32_t first = std::max(triangleOf(edges[1]), triangleOf(edges[2]));
+    uint32_t second = std::min(triangleOf(edges[1]), triangleOf(edges[2]));
+    for (uint32_t removed : {first, second}) {
+        if (t == getNTriangles() - 1) t = removed;
+        removeTriangle(removed);
+    }
+    return t;
+}
+
+void TriangleMesh::removeTriangle(uint32_t t) {
+    detach();
+    uint32_t last = getNTriangles() - 1;
+    if (t != last) {
+        for (auto i=0; i<3; i++) {
+            uint32_t e = 3 * t + i;
+            m_origins[e] = m_origins[3 * last + i];
+            link(e, m_twins[3 * last + i]);
+            if (m_vertex_edges[m_origins[e]] == 3 * last + i) m_vertex_edges[m_origins[e]] = e;
+        }
+        m_flags[t] = m_flags[last];
+    }
+    m_origins.resize(3 * last);
+    m_twins.resize(3 * last);
+    m_flags.resize(last);
+    refresh();
+}
+
+uint32_t TriangleMesh::removeVertex(uint32_t v) {
+    detach();
+    uint32_t last = getNVertices() - 1;
+    if (v != last) {
+        m_xs[v] = m_xs[last];
+        m_ys[v] = m_ys[last];
+        m_vertex_edges[v] = m_vertex_edges[last];
+        // Rename the half-edges starting at the last vertex, going both ways around it
+        uint32_t start = m_vertex_edges[v];
+        uint32_t e = start;
+        do {
+            m_origins[e] = v;
+            e = rotateCcw(e);
+        } while (e != none && e != start);
+        if (e == none) {
+            for (e = rotateCw(start); e != none; e = rotateCw(e)) {
+                m_origins[e] = v;
+            }
+        }
+    }
+    m_xs.pop_back();
+    m_ys.pop_back();
+    m_vertex_edges.pop_back();
+    refresh();
+    return last;
+}
+
+/* Before: e = ab, next(e) = bc, prev(e) = ca; f = twin(e) = ba, next(f) = ad, prev(f) = db
+ * After:  e = ad, next(e) = dc, prev(e) = ca; f = bc,            next(f) = cd, prev(f) = db */
+void TriangleMesh::flip(uint32_t e) {
+    detach();
+    uint32_t f = m_twins[e];
+    uint32_t e_next = next(e);
+    uint32_t f_next = next(f);
+    uint32_t c = m_origins[prev(e)];
+    uint32_t d = m_origins[prev(f)];
+    uint32_t ad_twin = m_twins[f_next];
+    uint32_t bc_twin = m_twins[e_next];
+    bool ad_constrained = isConstrained(f_next);
+    bool bc_constrained = isConstrained(e_next);
+    m_origins[e_next] = d;
+    m_origins[f_next] = c;
+    link(e, ad_twin);
+    link(f, bc_twin);
+    link(e_next, f_next);
+    setEdgeConstrained(e, ad_constrained);
+    setEdgeConstrained(f, bc_constrained);
+    setEdgeConstrained(e_next, false);
+    setEdgeConstrained(f_next, false);
+    // The half-edges that b and a started from may now start from d and c
+    m_vertex_edges[m_origins[e]] = e;
+    m_vertex_edges[m_origins[f]] = f;
+    m_vertex_edges[c] = prev(e);
+    m_vertex_edges[d] = prev(f);
+}
+
+// Rotates around a both ways, as a may be on the boundary
+uint32_t TriangleMesh::findEdge(uint32_t a, uint32_t b) const {
+    uint32_t start = getVertexEdge(a);
+    if (start == none) return none;
+    uint32_t e = start;
+    do {
+        if (getTarget(e) == b) return e;
+        if (getOrigin(prev(e)) == b && getTwin(prev(e)) == none) return prev(e);
+        e = rotateCcw(e);
+    } while (e != none && e != start);
+    if (e == start) return none;
+    for (e = rotateCw(start); e != none; e = rotateCw(e)) {
+        if (getTarget(e) == b) return e;
+    }
+    return none;
+}
+
+void TriangleMesh::setConstrained(uint32_t e, bool constrained) {
+    detach();
+    setEdgeConstrained(e, constrained);
+    if (m_twins[e] != none) setEdgeConstrained(m_twins[e], constrained);
+}
+
+void TriangleMesh::setEdgeConstrained(uint32_t e, bool constrained) {
+    uint8_t bit = 1 << e % 3;
+    if (constrained) m_flags[e / 3] |= bit;
+    else m_flags[e / 3] &= ~bit;
+}
+
+void TriangleMesh::setBlocked(uint32_t t, bool blocked) {
+    detach();
+    if (blocked) m_flags[t] |= blocked_flag;
+    else m_flags[t] &= ~blocked_flag;
+}
+
+/* An unconstrained edge is illegal if the vertex across it lies within the circumcircle of its
+ * triangle. With no illegal edges, no circumcircle contains a vertex of the mesh visible from
+ * within it, past constrained edges (constrained Delaunay) */
+std::size_t TriangleMesh::getNIllegalEdges() const {
+    std::size_t n_illegal = 0;
+    for (uint32_t e=0; e<getNHalfEdges(); e++) {
+        uint32_t f = getTwin(e);
+        if (f == none || f < e || isConstrained(e)) continue;
+        if (inCircle(getVertex(getOrigin(e)), getVertex(getTarget(e)),
+                getVertex(getOrigin(prev(e))), getVertex(getOrigin(prev(f)))) > 0) {
+            n_illegal++;
+        }
+    }
+    return n_illegal;
+}
+
+void TriangleMesh::clear() {
+    m_view = false;
+    m_xs.clear();
+    m_ys.clear();
+    m_origins.clear();
+    m_twins.clear();
+    m_flags.clear();
+    m_vertex_edges.clear();
+    refresh();
+}
+
+std::size_t TriangleMesh::getMemoryUsage() const {
+    return 2 * getNVertices() * sizeof(int_least16_t) +
+           (getNVertices() + 2 * getNHalfEdges()) * sizeof(uint32_t) + getNTriangles();
+}
+
+const TriangleMesh::Arrays& TriangleMesh::getArrays() const {
+    return m_arrays;
+}
+
+Coord TriangleMesh::getCenter(uint32_t t) const {
+    Coord a = getVertex(getOrigin(3 * t));
+    Coord b = getVertex(getOrigin(3 * t + 1));
+    Coord c = getVertex(getOrigin(3 * t + 2));
+    return {(a.x + b.x + c.x) / 3, (a.y + b.y + c.y) / 3};
+}
+
+int64_t TriangleMesh::orientation(Coord a, Coord b, Coord c) {
+    return (int64_t) (b.x - a.x) * (c.y - a.y) - (int64_t) (b.y - a.y) * (c.x - a.x);
+}
+
+// Exact for any 16-bit coordinates, as the determinant is evaluated in 128 bits
+int TriangleMesh::inCircle(Coord a, Coord b, Coord c, Coord d) {
+    int64_t adx = a.x - d.x, ady = a.y - d.y;
+    int64_t bdx = b.x - d.x, bdy = b.y - d.y;
+    int64_t cdx = c.x - d.x, cdy = c.y - d.y;
+    __int128 det = (__int128) (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy) +
+                   (__int128) (bdx * bdx + bdy * bdy) * (cdx * ady - adx * cdy) +
+                   (__int128) (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady);
+    return (det > 0) - (det < 0);
+}
@@ -0,0 +1,181 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef TRIANGLE_MESH_HPP
+#define TRIANGLE_MESH_HPP
+
+#include "coord.hpp"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace adamant {
+namespace graphics {
+
+/* Index-based half-edge (DCEL) triangle mesh, stored in contiguous arrays. Triangle t owns the
+ * half-edges 3t, 3t+1 and 3t+2, in counter-clockwise order (positive area), so next and prev
+ * are implicit, and the triangle of a half-edge is its index / 3. Each half-edge stores the
+ * vertex it starts from and its twin in the neighbouring triangle, which also makes the twin
+ * array the per-triangle neighbour array. Vertex coordinates are kept apart, in SoA form.
+ * Constrained edges, e.g. obstacle boundaries, are marked per half-edge and never flipped, and
+ * triangles within obstacles are kept as blocked, so that obstacles can come and go. Both are
+ * bits of a flags byte per triangle: the constraints of its three half-edges, then blocked.
+ * A mesh may also be a read-only view of arrays it does not own, e.g. a mapped file, which
+ * are only copied once it is first modified */
+class TriangleMesh {
+    public:
+        static const uint32_t none = UINT32_MAX;  // No twin (boundary), vertex or triangle
+
+        struct Arrays {
+            std::size_t n_vertices;
+            std::size_t n_triangles;
+            const int_least16_t* xs;  // Per vertex
+            const int_least16_t* ys;
+            const uint32_t* vertex_edges;
+            const uint32_t* origins;  // Per half-edge
+            const uint32_t* twins;
+            const uint8_t* flags;  // Per triangle
+        };
+
+        TriangleMesh();
+        explicit TriangleMesh(const Arrays& arrays);  // Views them, which must outlive it
+        TriangleMesh(const TriangleMesh& other);
+        TriangleMesh(TriangleMesh&& other) = default;
+        TriangleMesh& operator=(const TriangleMesh& other);
+        TriangleMesh& operator=(TriangleMesh&& other) = default;
+        uint32_t addVertex(Coord coord);
+        uint32_t addTriangle(uint32_t a, uint32_t b, uint32_t c);  // Counter-clockwise
+        void link(uint32_t e, uint32_t f);  // Makes the half-edges twins
+        // Splits t into three at v, within it; returns the first triangle added, out of two
+        uint32_t splitTriangle(uint32_t t, uint32_t v);
+        // Splits the edge of e and its triangles at v, on it; returns the first triangle added
+        uint32_t splitEdge(uint32_t e, uint32_t v);
+        // Replaces the three triangles around v by one, removing two; returns its index
+        uint32_t collapse(uint32_t v);
+        // The last triangle takes its index; nothing may refer to it anymore
+        void removeTriangle(uint32_t t);
+        // The last vertex takes its index; returns the old index of the last one
+        uint32_t removeVertex(uint32_t v);
+        /* Replaces the edge shared by the triangles of e and its twin by the other diagonal of
+         * their quad. Both triangles keep their indices, as do e and its twin, and the edge
+         * that follows e in its new triangle is the new diagonal. Of the outer edges, the ones
+         * before e and before its twin keep their half-edges, the one after e moves to its
+         * twin, and the one after its twin moves to e. The edge must not be constrained */
+        void flip(uint32_t e);
+        uint32_t findEdge(uint32_t a, uint32_t b) const;  // a->b, else boundary b->a, else none
+        void setConstrained(uint32_t e, bool constrained = true);  // Along with its twin
+        std::size_t getNIllegalEdges() const;  // 0 if the mesh is Delaunay
+        void clear();
+        std::size_t getMemoryUsage() const;  // In bytes, of the arrays in use
+        const Arrays& getArrays() const;
+        void setBlocked(uint32_t t, bool blocked);
+
+        std::size_t getNVertices() const {
+            return m_arrays.n_vertices;
+        }
+
+        std::size_t getNTriangles() const {
+            return m_arrays.n_triangles;
+        }
+
+        std::size_t getNHalfEdges() const {
+            return 3 * m_arrays.n_triangles;
+        }
+
+        Coord getVertex(uint32_t v) const {
+            return {m_arrays.xs[v], m_arrays.ys[v]};
+        }
+
+        int_fast16_t getX(uint32_t v) const {
+            return m_arrays.xs[v];
+        }
+
+        int_fast16_t getY(uint32_t v) const {
+            return m_arrays.ys[v];
+        }
+
+        uint32_t getOrigin(uint32_t e) const {
+            return m_arrays.origins[e];
+        }
+
+        uint32_t getTwin(uint32_t e) const {
+            return m_arrays.twins[e];
+        }
+
+        bool isConstrained(uint32_t e) const {
+            return m_arrays.flags[e / 3] & (1 << e % 3);
+        }
+
+        // Within an obstacle, so not walkable
+        bool isBlocked(uint32_t t) const {
+            return m_arrays.flags[t] & blocked_flag;
+        }
+
+        // Any half-edge starting at v, or none if no triangle has it
+        uint32_t getVertexEdge(uint32_t v) const {
+            return m_arrays.vertex_edges[v];
+        }
+
+        // Next half-edge from the same vertex, counter-clockwise; none at the boundary
+        uint32_t rotateCcw(uint32_t e) const {
+            return m_arrays.twins[prev(e)];
+        }
+
+        // Next half-edge from the same vertex, clockwise; none at the boundary
+        uint32_t rotateCw(uint32_t e) const {
+            uint32_t twin = m_arrays.twins[e];
+            return twin == none ? none : next(twin);
+        }
+
+        // Vertex e points to
+        uint32_t getTarget(uint32_t e) const {
+            return m_arrays.origins[next(e)];
+        }
+
+        // Triangle across the i-th edge of t, or none
+        uint32_t getNeighbour(uint32_t t, unsigned int i) const {
+            uint32_t twin = m_arrays.twins[3 * t + i];
+            return twin == none ? none : twin / 3;
+        }
+
+        Coord getCenter(uint32_t t) const;  // Centroid
+
+        static uint32_t next(uint32_t e) {
+            return e % 3 == 2 ? e - 2 : e + 1;
+        }
+
+        static uint32_t prev(uint32_t e) {
+            return e % 3 == 0 ? e + 2 : e - 1;
+        }
+
+        static uint32_t triangleOf(uint32_t e) {
+            return e / 3;
+        }
+
+        // Twice the signed area of abc: positive if counter-clockwise, 0 if collinear
+        static int64_t orientation(Coord a, Coord b, Coord c);
+        // 1 if d is inside the circumcircle of the counter-clockwise abc, 0 if on it, else -1
+        static int inCircle(Coord a, Coord b, Coord c, Coord d);
+
+    private:
+        static const uint8_t blocked_flag = 1 << 3;
+        Arrays m_arrays;  // Where all reads go: the vectors below, or the viewed memory
+        bool m_view;  // Nothing owned yet
+        std::vector<int_least16_t> m_xs;
+        std::vector<int_least16_t> m_ys;
+        std::vector<uint32_t> m_origins;  // Per half-edge
+        std::vector<uint32_t> m_twins;  // Per half-edge
+        std::vector<uint8_t> m_flags;  // Per triangle
+        std::vector<uint32_t> m_vertex_edges;  // Per vertex
+        void refresh();
+        void detach();
+        void setEdgeConstrained(uint32_t e, bool constrained);
+};
+
+}  // namespace graphics
+}  // namespace adamant
+
+#endif
@@ -4,16 +4,24 @@
  * Date  : 30.07.2020
  */
 
-#include <chrono>
 #include "artificial_player.hpp"
 
+using namespace adamant::concurrency;
 using namespace adamant::logic::ai;
 using namespace adamant::logic::elements;
 
 ArtificialPlayer::ArtificialPlayer(Bot* bot, float update_interval, ArtificialMovementPolicy
-        movement_policy, ArtificialAimingPolicy aiming_policy): m_bot{bot}, 
-        m_update_interval{update_interval}, m_movement_policy{movement_policy}, 
-        m_aiming_policy{aiming_policy}, m_last_played{std::chrono::steady_clock::now()} {}
+        movement_policy, ArtificialAimingPolicy aiming_policy, TimerWheel* timer_wheel):
+        m_bot{bot}, m_update_interval{update_interval}, m_movement_policy{movement_policy},
+        m_aiming_policy{aiming_policy}, m_timer_wheel{timer_wheel},
+        m_play_job(playJob, (uintptr_t) this, high, nullptr) {
+    m_timer = m_timer_wheel->schedule(&m_play_job, m_update_interval);
+}
+
+// Must not be destructed while playing
+ArtificialPlayer::~ArtificialPlayer() {
+    m_timer_wheel->cancel(m_timer);
+}
 
 float ArtificialPlayer::getUpdateInterval() {
     return m_update_interval;
@@ -40,16 +48,18 @@ void ArtificialPlayer::setAimingPolicy(ArtificialAimingPolicy aiming_policy) {
 }
 
 void ArtificialPlayer::play() {
-    auto now = std::chrono::steady_clock::now();
-    std::chrono::duration<float, std::milli> elapsed = now - m_last_played;
-    if (elapsed.count() >= m_update_interval) {
-        // Movement
-        if (m_movement_policy == random_movement) {
-            moveBotRandomly();
-        }
-        // TODO: Aiming
-        m_last_played = now;
+    // Movement
+    if (m_movement_policy == random_movement) {
+        moveBotRandomly();
     }
+    // TODO: Aiming
+}
+
+// A new interval takes effect from the next time the AI plays
+void ArtificialPlayer::playJob(uintptr_t param) {
+    ArtificialPlayer* ai = (ArtificialPlayer*) param;
+    ai->play();
+    ai->m_timer = ai->m_timer_wheel->schedule(&ai->m_play_job, ai->m_update_interval);
 }
 
 void ArtificialPlayer::moveBotRandomly() {
@@ -7,8 +7,9 @@
 #ifndef ARTIFICIAL_PLAYER_HPP
 #define ARTIFICIAL_PLAYER_HPP
 
-#include <chrono>
 #include "../elements/bot.hpp"
+#include "../../concurrency/job.hpp"
+#include "../../concurrency/timer_wheel.hpp"
 
 namespace adamant {
 namespace logic {
@@ -22,25 +23,32 @@ typedef enum ArtificialAimingPolicy {
     random_aiming = 0
 } ArtificialAimingPolicy;
 
+/* Plays every update interval of simulation time, through a timer of the given wheel that
+ * reschedules itself, so idle AIs cost nothing until their timer fires */
 class ArtificialPlayer {
     public:
         ArtificialPlayer(logic::elements::Bot* bot, float update_interval,
-                ArtificialMovementPolicy movement_policy, ArtificialAimingPolicy aiming_policy);
+                ArtificialMovementPolicy movement_policy, ArtificialAimingPolicy aiming_policy,
+                concurrency::TimerWheel* timer_wheel);
+        ~ArtificialPlayer();
         float getUpdateInterval();
         void setUpdateInterval(float update_interval);
         ArtificialMovementPolicy getMovementPolicy();
         void setMovementPolicy(ArtificialMovementPolicy movement_policy);
         ArtificialAimingPolicy getAimingPolicy();
         void setAimingPolicy(ArtificialAimingPolicy aiming_policy);
-        void play();
+        void play();  // Right away, regardless of the interval
 
     private:
         logic::elements::Bot* m_bot;
         float m_update_interval;  // In ms
-        std::chrono::steady_clock::time_point m_last_played;
         ArtificialMovementPolicy m_movement_policy;
         ArtificialAimingPolicy m_aiming_policy;
+        concurrency::TimerWheel* m_timer_wheel;
+        concurrency::Job m_play_job;  // Detached, kicked by the timer wheel
+        concurrency::TimerWheel::TimerId m_timer;
         void moveBotRandomly();
+        static void playJob(uintptr_t param);
         // TODO: add accuracy when implementing ability-casting
 };
 
@@ -4,19 +4,30 @@
  * Date  : 30.07.2020
  */
 
-#include <chrono>
 #include "ability.hpp"
 #include "elem.hpp"
 #include "bot.hpp"
 
+using namespace adamant::concurrency;
 using namespace adamant::logic::elements;
 using namespace adamant::graphics;
 using namespace adamant::graphics::elements;
 
 Ability::Ability(ElemType type, bool alive, ConvexPolygon* shape, Coord center, Team team,
         Bot* bot, time_t cd, int bounding_sphere_radius): Elem(type, alive, shape, center,
-        team, bounding_sphere_radius), m_bot{bot}, m_cd{cd},
-        m_last_used{std::chrono::steady_clock::time_point(std::chrono::seconds(0))} {}
+        team, bounding_sphere_radius), m_bot{bot}, m_cd{cd}, m_last_used{0}, m_ready{true},
+        m_cooldown_job(endCooldown, (uintptr_t) this, high, nullptr),
+        m_cooldown_timer{TimerWheel::no_timer} {}
+
+TimerWheel* Ability::s_timer_wheel = nullptr;
+
+Ability::~Ability() {
+    if (s_timer_wheel != nullptr) s_timer_wheel->cancel(m_cooldown_timer);
+}
+
+void Ability::setTimerWheel(TimerWheel* timer_wheel) {
+    s_timer_wheel = timer_wheel;
+}
 
 time_t Ability::getCd() {
     return m_cd;
@@ -26,6 +37,21 @@ void Ability::setCd(time_t cd) {
     m_cd = cd;
 }
 
-std::chrono::steady_clock::time_point Ability::getLastUsed() {
+double Ability::getLastUsed() {
     return m_last_used;
 }
+
+bool Ability::isReady() {
+    return m_ready;
+}
+
+void Ability::startCooldown() {
+    if (s_timer_wheel == nullptr) return;
+    m_last_used = s_timer_wheel->getTime();
+    m_ready = false;
+    m_cooldown_timer = s_timer_wheel->schedule(&m_cooldown_job, m_cd);
+}
+
+void Ability::endCooldown(uintptr_t param) {
+    ((Ability*) param)->m_ready = true;
+}
@@ -8,9 +8,11 @@
 #define ABILITY_HPP
 
 #include <vector>
-#include <chrono>
+#include <atomic>
 #include "elem.hpp"
 #include "../../physics/movement_manager.hpp"
+#include "../../concurrency/job.hpp"
+#include "../../concurrency/timer_wheel.hpp"
 
 namespace adamant {
 namespace logic {
@@ -23,11 +25,17 @@ typedef enum AbilityKey {
     q, w, e, r
 } AbilityKey;
 
+/* Cooldowns run on simulation time, through the timer wheel set for every ability. Without
+ * one, abilities are always ready */
 class Ability: public Elem {
     public:
-        time_t getCd();
+        ~Ability();
+        static void setTimerWheel(concurrency::TimerWheel* timer_wheel);
+        time_t getCd();  // In ms
         void setCd(time_t cd);
-        std::chrono::steady_clock::time_point getLastUsed();
+        double getLastUsed();  // In ms of simulation time
+        bool isReady();
+        void startCooldown();  // Once casted
         virtual bool cast(graphics::Coord target) = 0;
         virtual void update(float ms) = 0;
         virtual void handleBotCollision(Bot* bot) = 0;
@@ -35,11 +43,18 @@ class Ability: public Elem {
     protected:
         Bot* m_bot;
         time_t m_cd;
-        std::chrono::steady_clock::time_point m_last_used;
+        double m_last_used;
+        std::atomic<bool> m_ready;
+        concurrency::Job m_cooldown_job;  // Detached, kicked by the timer wheel
+        concurrency::TimerWheel::TimerId m_cooldown_timer;
         Ability();
         Ability(ElemType type, bool alive, graphics::elements::ConvexPolygon* shape, 
                 graphics::Coord center, Team team, Bot* bot, time_t cd,
                 int bounding_sphere_radius);
+
+    private:
+        static concurrency::TimerWheel* s_timer_wheel;
+        static void endCooldown(uintptr_t param);
 };
 
 }  // namespace elements
@@ -56,7 +56,8 @@ Ability* Bot::useAbility(AbilityKey key, Coord target) {
         default:
             break;
     }
-    if (ability != nullptr && ability->cast(target)) {
+    if (ability != nullptr && ability->isReady() && ability->cast(target)) {
+        ability->startCooldown();
         return ability;
     }
     return nullptr;
@@ -0,0 +1,352 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "cluster_graph.hpp"
+#include "../graphics/triangle_mesh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace adamant::physics::movement;
+using namespace adamant::graphics;
+
+ClusterGraph::ClusterGraph(const NavMesh* nav_mesh, int_least16_t cluster_size):
+        m_nav_mesh{nav_mesh}, m_cluster_size{cluster_size}, m_search{0} {
+    MapSize map_size = nav_mesh->getMapSize();
+    if (m_cluster_size <= 0) {
+        std::size_t n_triangles = std::max<std::size_t>(nav_mesh->getMesh().getNTriangles(), 1);
+        m_cluster_size = std::max(1.0, std::sqrt(256.0 * map_size.x * map_size.y / n_triangles));
+    }
+    m_n_columns = map_size.x / m_cluster_size + 1;
+    m_n_clusters = m_n_columns * (map_size.y / m_cluster_size + 1);
+    rebuild();
+}
+
+void ClusterGraph::rebuild() {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    m_clusters.resize(mesh.getNTriangles());
+    m_member_indices.resize(mesh.getNTriangles());
+    m_members.assign(m_n_clusters, {});
+    for (uint32_t t=0; t<mesh.getNTriangles(); t++) {
+        addMember(t, clusterOf(mesh.getCenter(t)));
+    }
+    std::vector<uint32_t> crossings, free;
+    for (uint32_t e=0; e<mesh.getNHalfEdges(); e++) {
+        if (crosses(e)) crossings.push_back(e);
+    }
+    m_entrances.clear();
+    m_cluster_entrances.assign(m_n_clusters, {});
+    findEntrances(crossings, free);
+    m_costs.assign(m_n_clusters, {});
+    m_dirty.assign(m_n_clusters, false);
+    m_touched.assign(m_n_clusters, false);
+    for (uint32_t c=0; c<m_n_clusters; c++) {
+        sortEntrances(c);
+        computeCosts(c);
+    }
+    m_revision = m_nav_mesh->getRevision();
+}
+
+/* The clusters the changed triangles were or are in are dirty: their entrances are found again
+ * from their own triangles, and their costs recomputed. The ones next to them lose their
+ * entrances to them and get the new ones, and are only recomputed if that changed anything */
+void ClusterGraph::update(const std::vector<uint32_t>& changed) {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    std::vector<uint32_t> dirty, touched;
+    auto mark = [this, &dirty](uint32_t c) {
+        if (m_dirty[c]) return;
+        m_dirty[c] = true;
+        dirty.push_back(c);
+    };
+    for (uint32_t t : changed) {
+        if (t >= m_clusters.size() || m_clusters[t] == TriangleMesh::none) continue;
+        mark(m_clusters[t]);
+        removeMember(t);
+    }
+    m_clusters.resize(mesh.getNTriangles(), TriangleMesh::none);
+    m_member_indices.resize(mesh.getNTriangles());
+    for (uint32_t t : changed) {
+        if (t >= mesh.getNTriangles() || m_clusters[t] != TriangleMesh::none) continue;
+        addMember(t, clusterOf(mesh.getCenter(t)));
+        mark(m_clusters[t]);
+    }
+
+    // Entrances of the dirty clusters are freed, and the ones next to them keep the others
+    std::vector<uint32_t> free;
+    std::vector<std::vector<std::pair<uint32_t, Coord>>> before;  // Per touched cluster
+    for (uint32_t c : dirty) {
+        for (uint32_t x : m_cluster_entrances[c]) {
+            const Entrance& entrance = m_entrances[x];
+            uint32_t other = entrance.clusters[entrance.clusters[0] == c ? 1 : 0];
+            if (m_dirty[other] && other < c) continue;
+            free.push_back(x);
+            if (m_dirty[other] || m_touched[other]) continue;
+            m_touched[other] = true;
+            touched.push_back(other);
+            before.emplace_back();
+            for (uint32_t y : m_cluster_entrances[other]) {
+                before.back().push_back({getSide(y, other), m_entrances[y].position});
+            }
+        }
+    }
+    for (uint32_t x : free) {
+        m_entrances[x].edge = TriangleMesh::none;
+    }
+    for (uint32_t c : dirty) {
+        m_cluster_entrances[c].clear();
+    }
+    for (uint32_t c : touched) {
+        std::vector<uint32_t>& entrances = m_cluster_entrances[c];
+        entrances.erase(std::remove_if(entrances.begin(), entrances.end(), [this](uint32_t x) {
+            return m_entrances[x].edge == TriangleMesh::none;
+        }), entrances.end());
+    }
+
+    // Each crossing is found from its lower cluster, or from the dirty one if that is clean
+    std::vector<uint32_t> crossings;
+    for (uint32_t c : dirty) {
+        for (uint32_t t : m_members[c]) {
+            for (auto k=0; k<3; k++) {
+                uint32_t e = 3 * t + k, f = mesh.getTwin(e);
+                if (crosses(e)) {
+                    crossings.push_back(e);
+                } else if (f != TriangleMesh::none && crosses(f) &&
+                           !m_dirty[m_clusters[TriangleMesh::triangleOf(f)]]) {
+                    crossings.push_back(f);
+                }
+            }
+        }
+    }
+    std::sort(crossings.begin(), crossings.end());
+    findEntrances(crossings, free);
+
+    // The last entrances fill the slots left free
+    std::sort(free.begin(), free.end());
+    for (uint32_t x : free) {
+        while (!m_entrances.empty() && m_entrances.back().edge == TriangleMesh::none) {
+            m_entrances.pop_back();
+        }
+        if (x >= m_entrances.size()) break;
+        m_entrances[x] = m_entrances.back();
+        m_entrances.pop_back();
+        for (uint32_t c : m_entrances[x].clusters) {
+            std::vector<uint32_t>& entrances = m_cluster_entrances[c];
+            *std::find(entrances.begin(), entrances.end(), m_entrances.size()) = x;
+        }
+    }
+
+    for (uint32_t c : dirty) {
+        sortEntrances(c);
+        computeCosts(c);
+        m_dirty[c] = false;
+    }
+    for (auto i=0; i<touched.size(); i++) {
+        uint32_t c = touched[i];
+        sortEntrances(c);
+        const std::vector<uint32_t>& entrances = m_cluster_entrances[c];
+        bool unchanged = before[i].size() == entrances.size();
+        for (auto j=0; j<entrances.size() && unchanged; j++) {
+            Coord position = m_entrances[entrances[j]].position;
+            unchanged = before[i][j].first == getSide(entrances[j], c) &&
+                        before[i][j].second.x == position.x &&
+                        before[i][j].second.y == position.y;
+        }
+        if (!unchanged) computeCosts(c);
+        m_touched[c] = false;
+    }
+    m_revision = m_nav_mesh->getRevision();
+}
+
+bool ClusterGraph::isCurrent() const {
+    return m_revision == m_nav_mesh->getRevision();
+}
+
+int_least16_t ClusterGraph::getClusterSize() const {
+    return m_cluster_size;
+}
+
+std::size_t ClusterGraph::getNClusters() const {
+    return m_n_clusters;
+}
+
+std::size_t ClusterGraph::getNEntrances() const {
+    return m_entrances.size();
+}
+
+uint32_t ClusterGraph::clusterOf(Coord coord) const {
+    return coord.y / m_cluster_size * m_n_columns + coord.x / m_cluster_size;
+}
+
+void ClusterGraph::addMember(uint32_t t, uint32_t cluster) {
+    m_clusters[t] = cluster;
+    m_member_indices[t] = m_members[cluster].size();
+    m_members[cluster].push_back(t);
+}
+
+// Swapping in the last triangle of its cluster
+void ClusterGraph::removeMember(uint32_t t) {
+    std::vector<uint32_t>& members = m_members[m_clusters[t]];
+    uint32_t last = members.back();
+    members[m_member_indices[t]] = last;
+    m_member_indices[last] = m_member_indices[t];
+    members.pop_back();
+    m_clusters[t] = TriangleMesh::none;
+}
+
+// Walkable, from the triangle of a lower cluster to the one of a higher one
+bool ClusterGraph::crosses(uint32_t e) const {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    uint32_t f = mesh.getTwin(e);
+    if (f == TriangleMesh::none || mesh.isConstrained(e)) return false;
+    uint32_t t = TriangleMesh::triangleOf(e);
+    uint32_t u = TriangleMesh::triangleOf(f);
+    return m_clusters[t] < m_clusters[u] && !mesh.isBlocked(t) && !mesh.isBlocked(u);
+}
+
+/* The crossings, sorted, are joined into runs at the vertices they share with other crossings
+ * between the same clusters (union-find), and each run becomes an entrance at its edge closest
+ * to the run's mean midpoint. Entrances take the free slots first, and are added to the ones of
+ * their clusters, to be sorted */
+void ClusterGraph::findEntrances(const std::vector<uint32_t>& crossings,
+        std::vector<uint32_t>& free) {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    std::vector<uint32_t> parents(crossings.size());
+    auto find = [&parents](uint32_t i) {
+        while (parents[i] != i) {
+            parents[i] = parents[parents[i]];
+            i = parents[i];
+        }
+        return i;
+    };
+    std::vector<std::pair<uint64_t, uint32_t>> ends;  // By clusters and vertex
+    ends.reserve(2 * crossings.size());
+    for (uint32_t k=0; k<crossings.size(); k++) {
+        parents[k] = k;
+        uint32_t e = crossings[k];
+        uint64_t pair = (uint64_t) m_clusters[TriangleMesh::triangleOf(e)] * m_n_clusters +
+                        m_clusters[TriangleMesh::triangleOf(mesh.getTwin(e))];
+        for (uint32_t v : {mesh.getOrigin(e), mesh.getTarget(e)}) {
+            ends.push_back({pair * mesh.getNVertices() + v, k});
+        }
+    }
+    std::sort(ends.begin(), ends.end());
+    for (auto i=1; i<ends.size(); i++) {
+        if (ends[i].first != ends[i-1].first) continue;
+        uint32_t a = find(ends[i].second), b = find(ends[i-1].second);
+        parents[std::max(a, b)] = std::min(a, b);
+    }
+
+    // Doubled midpoints, so that they are exact
+    auto middle = [&mesh](uint32_t e) {
+        Coord a = mesh.getVertex(mesh.getOrigin(e));
+        Coord b = mesh.getVertex(mesh.getTarget(e));
+        return Coord{a.x + b.x, a.y + b.y};
+    };
+    std::vector<int64_t> sum_xs(crossings.size(), 0), sum_ys(crossings.size(), 0);
+    std::vector<int64_t> counts(crossings.size(), 0);
+    for (uint32_t k=0; k<crossings.size(); k++) {
+        uint32_t root = find(k);
+        Coord m = middle(crossings[k]);
+        sum_xs[root] += m.x;
+        sum_ys[root] += m.y;
+        counts[root]++;
+    }
+    std::vector<uint32_t> best(crossings.size(), TriangleMesh::none);
+    std::vector<int64_t> best_distances(crossings.size());
+    for (uint32_t k=0; k<crossings.size(); k++) {
+        uint32_t root = find(k);
+        Coord m = middle(crossings[k]);
+        int64_t x = m.x * counts[root] - sum_xs[root];
+        int64_t y = m.y * counts[root] - sum_ys[root];
+        if (best[root] == TriangleMesh::none || x * x + y * y < best_distances[root]) {
+            best[root] = crossings[k];
+            best_distances[root] = x * x + y * y;
+        }
+    }
+
+    for (uint32_t k=0; k<crossings.size(); k++) {
+        if (find(k) != k) continue;
+        uint32_t e = best[k];
+        Coord m = middle(e);
+        uint32_t t = TriangleMesh::triangleOf(e);
+        uint32_t u = TriangleMesh::triangleOf(mesh.getTwin(e));
+        uint32_t x = m_entrances.size();
+        if (free.empty()) {
+            m_entrances.emplace_back();
+        } else {
+            x = free.back();
+            free.pop_back();
+        }
+        m_entrances[x] = {e, {m.x / 2, m.y / 2}, {m_clusters[t], m_clusters[u]}, {0, 0}, {t, u}};
+        for (uint32_t c : m_entrances[x].clusters) {
+            m_cluster_entrances[c].push_back(x);
+        }
+    }
+}
+
+// By their edges, so that they are in the same order however they were found
+void ClusterGraph::sortEntrances(uint32_t cluster) {
+    std::vector<uint32_t>& entrances = m_cluster_entrances[cluster];
+    std::sort(entrances.begin(), entrances.end(), [this](uint32_t x, uint32_t y) {
+        return m_entrances[x].edge < m_entrances[y].edge;
+    });
+    for (auto i=0; i<entrances.size(); i++) {
+        Entrance& entrance = m_entrances[entrances[i]];
+        entrance.indices[cluster == entrance.clusters[0] ? 0 : 1] = i;
+    }
+}
+
+/* Dijkstra from each entrance over the walkable triangles of the cluster, moving between the
+ * midpoints of the edges crossed as path finding does */
+void ClusterGraph::computeCosts(uint32_t cluster) {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    const std::vector<uint32_t>& entrances = m_cluster_entrances[cluster];
+    std::size_t n = entrances.size();
+    m_costs[cluster].assign(n * n, std::numeric_limits<float>::infinity());
+    if (m_reached.size() < mesh.getNTriangles()) {
+        m_reached.resize(mesh.getNTriangles(), 0);
+        m_distances.resize(mesh.getNTriangles());
+        m_positions.resize(mesh.getNTriangles());
+    }
+    auto greater = [](const std::pair<float, uint32_t>& lhs,
+            const std::pair<float, uint32_t>& rhs) {
+        return lhs.first > rhs.first;
+    };
+
+    for (auto i=0; i<n; i++) {
+        if (++m_search == 0) {
+            std::fill(m_reached.begin(), m_reached.end(), 0);
+            m_search = 1;
+        }
+        uint32_t start = getSide(entrances[i], cluster);
+        m_reached[start] = m_search;
+        m_distances[start] = 0;
+        m_positions[start] = m_entrances[entrances[i]].position;
+        m_open.assign(1, {0, start});
+        while (!m_open.empty()) {
+            std::pop_heap(m_open.begin(), m_open.end(), greater);
+            auto [d, t] = m_open.back();
+            m_open.pop_back();
+            if (d > m_distances[t]) continue;
+            m_nav_mesh->forEachCrossing(t, [&](uint32_t, uint32_t u, Coord middle) {
+                if (m_clusters[u] != cluster) return;
+                float cost = d + distance(m_positions[t], middle);
+                if (m_reached[u] == m_search && cost >= m_distances[u]) return;
+                m_reached[u] = m_search;
+                m_distances[u] = cost;
+                m_positions[u] = middle;
+                m_open.push_back({cost, u});
+                std::push_heap(m_open.begin(), m_open.end(), greater);
+            });
+        }
+        for (auto j=0; j<n; j++) {
+            uint32_t t = getSide(entrances[j], cluster);
+            if (m_reached[t] != m_search) continue;
+            m_costs[cluster][i * n + j] = m_distances[t] +
+                    distance(m_positions[t], m_entrances[entrances[j]].position);
+        }
+    }
+}
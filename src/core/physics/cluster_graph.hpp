@@ -0,0 +1,102 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef CLUSTER_GRAPH_HPP
+#define CLUSTER_GRAPH_HPP
+
+#include "../graphics/coord.hpp"
+#include "../graphics/nav_mesh.hpp"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+namespace adamant {
+namespace physics {
+namespace movement {
+
+/* Abstract graph of a nav mesh for hierarchical path finding (HPA*). Triangles are grouped in
+ * clusters, the squares of a grid their centroids fall in. Each run of walkable edges between
+ * two clusters, joined by their vertices, is an entrance, placed at the midpoint of its most
+ * central edge, and the costs of going between the entrances of a cluster without leaving it
+ * are precomputed. Updates of the nav mesh only recompute the clusters around them */
+class ClusterGraph {
+    public:
+        struct Entrance {
+            uint32_t edge;  // Half-edge in the triangle of the lower cluster
+            graphics::Coord position;
+            uint32_t clusters[2];  // Lower first
+            uint32_t indices[2];  // Within the entrances of each
+            uint32_t sides[2];  // Triangles next to it in each
+        };
+
+        // Clusters of about 256 triangles if no size is given, in pixels
+        ClusterGraph(const graphics::NavMesh* nav_mesh, int_least16_t cluster_size = 0);
+        void rebuild();
+        // Recomputes the clusters around the triangles an obstacle was inserted or removed at
+        void update(const std::vector<uint32_t>& changed);
+        bool isCurrent() const;  // Path finding searches the whole mesh instead otherwise
+        int_least16_t getClusterSize() const;
+        std::size_t getNClusters() const;
+        std::size_t getNEntrances() const;
+
+        uint32_t getCluster(uint32_t t) const {
+            return m_clusters[t];
+        }
+
+        const Entrance& getEntrance(uint32_t entrance) const {
+            return m_entrances[entrance];
+        }
+
+        // Of the cluster, in the order of their indices
+        const std::vector<uint32_t>& getEntrances(uint32_t cluster) const {
+            return m_cluster_entrances[cluster];
+        }
+
+        // Between the i-th and the j-th entrances of the cluster, infinity if disconnected
+        float getCost(uint32_t cluster, uint32_t i, uint32_t j) const {
+            return m_costs[cluster][i * m_cluster_entrances[cluster].size() + j];
+        }
+
+        // Triangle on the cluster's side of the entrance
+        uint32_t getSide(uint32_t entrance, uint32_t cluster) const {
+            const Entrance& e = m_entrances[entrance];
+            return e.sides[cluster == e.clusters[0] ? 0 : 1];
+        }
+
+    private:
+        const graphics::NavMesh* m_nav_mesh;
+        int_least16_t m_cluster_size;
+        uint32_t m_n_columns;
+        uint32_t m_n_clusters;
+        uint32_t m_revision;  // Of the nav mesh, when last built or updated
+        std::vector<uint32_t> m_clusters;  // Per triangle
+        std::vector<std::vector<uint32_t>> m_members;  // Triangles of each cluster
+        std::vector<uint32_t> m_member_indices;  // Per triangle, within the ones of its cluster
+        std::vector<Entrance> m_entrances;
+        std::vector<std::vector<uint32_t>> m_cluster_entrances;
+        std::vector<std::vector<float>> m_costs;  // Per cluster, by pairs of its entrances
+        std::vector<bool> m_dirty;  // Per cluster, during updates
+        std::vector<bool> m_touched;  // Per cluster next to a dirty one, during updates
+        uint32_t m_search;
+        std::vector<uint32_t> m_reached;  // Search in which each triangle was last reached
+        std::vector<float> m_distances;
+        std::vector<graphics::Coord> m_positions;
+        std::vector<std::pair<float, uint32_t>> m_open;
+        uint32_t clusterOf(graphics::Coord coord) const;
+        void addMember(uint32_t t, uint32_t cluster);
+        void removeMember(uint32_t t);
+        bool crosses(uint32_t e) const;
+        void findEntrances(const std::vector<uint32_t>& crossings, std::vector<uint32_t>& free);
+        void sortEntrances(uint32_t cluster);
+        void computeCosts(uint32_t cluster);
+};
+
+}  // namespace movement
+}  // namespace physics
+}  // namespace adamant
+
+#endif
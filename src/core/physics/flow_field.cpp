@@ -0,0 +1,190 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "flow_field.hpp"
+#include "../graphics/triangle_mesh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <functional>
+
+using namespace adamant::physics::movement;
+using namespace adamant::graphics;
+
+FlowField::FlowField(const NavMesh* nav_mesh, Coord goal): m_nav_mesh{nav_mesh}, m_goal{goal} {
+    rebuild();
+}
+
+void FlowField::rebuild() {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    std::size_t n_triangles = mesh.getNTriangles();
+    m_distances.assign(n_triangles, std::numeric_limits<float>::infinity());
+    m_exits.assign(n_triangles, TriangleMesh::none);
+    m_positions.resize(n_triangles);
+    m_revision = m_nav_mesh->getRevision();
+    m_goal_triangle = m_nav_mesh->findTriangle(m_goal);
+    if (m_goal_triangle == TriangleMesh::none || mesh.isBlocked(m_goal_triangle)) return;
+    m_distances[m_goal_triangle] = 0;
+    m_positions[m_goal_triangle] = m_goal;
+    m_open.assign(1, {0, m_goal_triangle});
+    expand();
+}
+
+/* The triangles changed, and the ones whose exits led into them, directly or not, are left
+ * unreachable, and then searched again from the ones around them. As the search lowers the
+ * distance of any triangle it reaches for less, it also finds the shorter ways that removing
+ * an obstacle opens */
+void FlowField::update(const std::vector<uint32_t>& changed) {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    std::size_t n_triangles = mesh.getNTriangles();
+    if (m_revision + 1 != m_nav_mesh->getRevision() ||
+            std::binary_search(changed.begin(), changed.end(), m_goal_triangle)) {
+        rebuild();
+        return;
+    }
+    m_distances.resize(n_triangles, std::numeric_limits<float>::infinity());
+    m_exits.resize(n_triangles, TriangleMesh::none);
+    m_positions.resize(n_triangles);
+    m_revision = m_nav_mesh->getRevision();
+
+    m_invalid.clear();
+    for (uint32_t t : changed) {
+        if (t >= n_triangles) continue;
+        m_distances[t] = std::numeric_limits<float>::infinity();
+        m_exits[t] = TriangleMesh::none;
+        m_invalid.push_back(t);
+    }
+    for (auto i=0; i<m_invalid.size(); i++) {
+        uint32_t t = m_invalid[i];
+        for (auto k=0; k<3; k++) {
+            uint32_t f = mesh.getTwin(3 * t + k);
+            if (f == TriangleMesh::none || m_exits[TriangleMesh::triangleOf(f)] != f) continue;
+            uint32_t u = TriangleMesh::triangleOf(f);
+            m_distances[u] = std::numeric_limits<float>::infinity();
+            m_exits[u] = TriangleMesh::none;
+            m_invalid.push_back(u);
+        }
+    }
+
+    m_open.clear();
+    for (uint32_t t : m_invalid) {
+        for (auto k=0; k<3; k++) {
+            uint32_t f = mesh.getTwin(3 * t + k);
+            if (f == TriangleMesh::none) continue;
+            uint32_t u = TriangleMesh::triangleOf(f);
+            if (m_distances[u] != std::numeric_limits<float>::infinity()) {
+                m_open.push_back({m_distances[u], u});
+            }
+        }
+    }
+    std::make_heap(m_open.begin(), m_open.end(), std::greater<std::pair<float, uint32_t>>());
+    expand();
+}
+
+bool FlowField::isCurrent() const {
+    return m_revision == m_nav_mesh->getRevision();
+}
+
+Coord FlowField::getGoal() const {
+    return m_goal;
+}
+
+/* Once at the midpoint of its exit, which may still be found in the same triangle, the unit
+ * goes on to the one of the triangle past it. Rounded midpoints of thin triangles may lie in
+ * the unit's triangle too, even several triangles further, so the furthest waypoint a few
+ * triangles ahead that it can move straight to within it is taken instead, or it could be sent
+ * back and forth between them */
+Coord FlowField::getWaypoint(Coord position) const {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    uint32_t t = m_nav_mesh->findTriangle(position);
+    if (!isCurrent() || t == TriangleMesh::none ||
+            m_distances[t] == std::numeric_limits<float>::infinity()) return position;
+    auto contains = [&mesh, t](Coord c) {
+        for (auto k=0; k<3; k++) {
+            Coord a = mesh.getVertex(mesh.getOrigin(3 * t + k));
+            Coord b = mesh.getVertex(mesh.getTarget(3 * t + k));
+            if (TriangleMesh::orientation(a, b, c) < 0) return false;
+        }
+        return true;
+    };
+    auto next = [this, &mesh](uint32_t u) {
+        return TriangleMesh::triangleOf(mesh.getTwin(m_exits[u]));
+    };
+    uint32_t furthest = t;
+    uint32_t u = t;
+    for (auto i=0; i<lookahead && u != m_goal_triangle; i++) {
+        u = next(u);
+        Coord c = m_positions[u];
+        if (contains(c) || (c.x == position.x && c.y == position.y)) furthest = u;
+    }
+    Coord waypoint = m_positions[furthest];
+    if (waypoint.x == position.x && waypoint.y == position.y && furthest != m_goal_triangle) {
+        waypoint = m_positions[next(furthest)];
+    }
+    return waypoint;
+}
+
+Direction FlowField::getDirection(Coord position) const {
+    Coord waypoint = getWaypoint(position);
+    float length = distance(position, waypoint);
+    if (length == 0) return {0, 0};
+    return {(waypoint.x - position.x) / length, (waypoint.y - position.y) / length};
+}
+
+// Dijkstra from the open triangles, reaching the walkable ones next to them for less
+void FlowField::expand() {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    auto greater = std::greater<std::pair<float, uint32_t>>();
+    while (!m_open.empty()) {
+        std::pop_heap(m_open.begin(), m_open.end(), greater);
+        auto [d, t] = m_open.back();
+        m_open.pop_back();
+        if (d > m_distances[t]) continue;
+        m_nav_mesh->forEachCrossing(t, [&](uint32_t e, uint32_t u, Coord middle) {
+            float cost = d + distance(m_positions[t], middle);
+            if (cost >= m_distances[u]) return;
+            m_distances[u] = cost;
+            m_exits[u] = mesh.getTwin(e);
+            m_positions[u] = middle;
+            m_open.push_back({cost, u});
+            std::push_heap(m_open.begin(), m_open.end(), greater);
+        });
+    }
+}
+
+FlowFieldCache::FlowFieldCache(const NavMesh* nav_mesh, std::size_t capacity):
+        m_nav_mesh{nav_mesh}, m_capacity{std::max<std::size_t>(capacity, 1)}, m_uses{0} {}
+
+std::shared_ptr<const FlowField> FlowFieldCache::get(Coord goal) {
+    m_uses++;
+    for (auto i=0; i<m_fields.size(); i++) {
+        Coord field_goal = m_fields[i]->getGoal();
+        if (field_goal.x != goal.x || field_goal.y != goal.y) continue;
+        if (!m_fields[i]->isCurrent()) m_fields[i]->rebuild();
+        m_last_uses[i] = m_uses;
+        return m_fields[i];
+    }
+    std::size_t i = m_fields.size();
+    if (i == m_capacity) {
+        i = std::min_element(m_last_uses.begin(), m_last_uses.end()) - m_last_uses.begin();
+        m_fields[i] = std::make_shared<FlowField>(m_nav_mesh, goal);
+    } else {
+        m_fields.push_back(std::make_shared<FlowField>(m_nav_mesh, goal));
+        m_last_uses.push_back(0);
+    }
+    m_last_uses[i] = m_uses;
+    return m_fields[i];
+}
+
+void FlowFieldCache::update(const std::vector<uint32_t>& changed) {
+    for (auto& field : m_fields) {
+        field->update(changed);
+    }
+}
+
+std::size_t FlowFieldCache::getSize() const {
+    return m_fields.size();
+}
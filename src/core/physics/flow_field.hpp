@@ -0,0 +1,93 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef FLOW_FIELD_HPP
+#define FLOW_FIELD_HPP
+
+#include "../graphics/coord.hpp"
+#include "../graphics/nav_mesh.hpp"
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+namespace adamant {
+namespace physics {
+namespace movement {
+
+typedef struct Direction {
+    float x;
+    float y;
+} Direction;
+
+/* Paths from every walkable triangle of a nav mesh to a goal, for many units going to it at
+ * once. A reverse Dijkstra from the goal, moving between the midpoints of the edges crossed as
+ * path finding does, leaves each triangle the edge to leave it through, so that a unit only
+ * has to move straight to its midpoint, and then to the next one. Updates of the nav mesh only
+ * search again the triangles changed and the ones whose way went through them */
+class FlowField {
+    public:
+        FlowField(const graphics::NavMesh* nav_mesh, graphics::Coord goal);
+        void rebuild();
+        // Searches again where the triangles given were changed, or all over if it fell behind
+        void update(const std::vector<uint32_t>& changed);
+        bool isCurrent() const;  // It gives no waypoints otherwise
+        graphics::Coord getGoal() const;
+        // Where to move straight to next, the position itself at the goal or if unreachable
+        graphics::Coord getWaypoint(graphics::Coord position) const;
+        // Unit vector towards the waypoint, zero if there is none
+        Direction getDirection(graphics::Coord position) const;
+
+        // Half-edge to leave the triangle through, none in the goal's or if unreachable
+        uint32_t getExit(uint32_t t) const {
+            return m_exits[t];
+        }
+
+        // Left to go from the midpoint of the triangle's exit, infinity if unreachable
+        float getDistance(uint32_t t) const {
+            return m_distances[t];
+        }
+
+    private:
+        static const unsigned int lookahead = 8;  // Triangles, for waypoints in the same one
+
+        const graphics::NavMesh* m_nav_mesh;
+        graphics::Coord m_goal;
+        uint32_t m_goal_triangle;
+        uint32_t m_revision;  // Of the nav mesh, when last built or updated
+        std::vector<float> m_distances;  // Per triangle
+        std::vector<uint32_t> m_exits;
+        std::vector<graphics::Coord> m_positions;  // Midpoint of the exit, or the goal
+        std::vector<std::pair<float, uint32_t>> m_open;
+        std::vector<uint32_t> m_invalid;
+        void expand();
+};
+
+/* Flow fields by goal, built when first asked for and kept up to date with the nav mesh. The
+ * least recently used one is dropped for a new goal once full. Fields are shared with whoever
+ * holds them, so a dropped one lives on, but is no longer updated, so that it goes stale and
+ * gives no waypoints, until asked for again */
+class FlowFieldCache {
+    public:
+        FlowFieldCache(const graphics::NavMesh* nav_mesh, std::size_t capacity = 16);
+        std::shared_ptr<const FlowField> get(graphics::Coord goal);
+        void update(const std::vector<uint32_t>& changed);  // Of every field kept
+        std::size_t getSize() const;
+
+    private:
+        const graphics::NavMesh* m_nav_mesh;
+        std::size_t m_capacity;
+        uint64_t m_uses;
+        std::vector<std::shared_ptr<FlowField>> m_fields;
+        std::vector<uint64_t> m_last_uses;  // Per field
+};
+
+}  // namespace movement
+}  // namespace physics
+}  // namespace adamant
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "landmarks.hpp"
+#include "../graphics/triangle_mesh.hpp"
+#include <cmath>
+#include <limits>
+#include <functional>
+
+using namespace adamant::physics::movement;
+using namespace adamant::graphics;
+
+Landmarks::Landmarks(const NavMesh* nav_mesh, unsigned int n_landmarks):
+        m_nav_mesh{nav_mesh},
+        m_n_landmarks{std::min(std::max(n_landmarks, 1u), (unsigned int) max_landmarks)} {
+    rebuild();
+}
+
+/* Each landmark is the edge farthest from the ones picked before, the first one from an
+ * arbitrary edge. Edges unreachable from all of them are left for other components */
+void Landmarks::rebuild() {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    std::size_t n_half_edges = mesh.getNHalfEdges();
+    m_revision = m_nav_mesh->getRevision();
+    m_landmarks.clear();
+    m_steps.assign(m_n_landmarks, 0);
+    m_lowers.assign((n_half_edges + 63) / 64, 0);
+    m_ranks.assign(m_lowers.size(), 0);
+    std::size_t n_edges = 0;
+    for (uint32_t e=0; e<n_half_edges; e++) {
+        if (e % 64 == 0) m_ranks[e / 64] = n_edges;
+        if (mesh.getTwin(e) < e) continue;
+        m_lowers[e / 64] |= (uint64_t) 1 << (e % 64);
+        n_edges++;
+    }
+    m_table.assign(n_edges * m_n_landmarks, (uint16_t) unreachable);
+    uint32_t seed = 0;
+    while (seed < n_half_edges && !m_nav_mesh->isCrossable(seed)) seed++;
+    if (seed == n_half_edges) return;
+
+    const float infinity = std::numeric_limits<float>::infinity();
+    std::vector<float> nearest(n_half_edges, infinity);  // To any landmark
+    search(seed);
+    uint32_t landmark = std::max_element(m_distances.begin(), m_distances.end(),
+            [infinity](float lhs, float rhs) {
+        return (lhs == infinity ? -1 : lhs) < (rhs == infinity ? -1 : rhs);
+    }) - m_distances.begin();
+    for (auto l=0; l<m_n_landmarks; l++) {
+        m_landmarks.push_back(landmark);
+        search(landmark);
+        float farthest = 0;
+        for (uint32_t e=0; e<n_half_edges; e++) {
+            if (m_distances[e] != infinity && m_distances[e] > farthest) farthest = m_distances[e];
+        }
+        m_steps[l] = std::max(farthest / (unreachable - 1), 1e-3f);
+        float candidate = -1;
+        for (uint32_t e=0; e<n_half_edges; e++) {
+            if (m_distances[e] == infinity) continue;
+            // Once per half-edge, both with the same distance
+            m_table[rowOf(e) * m_n_landmarks + l] = m_distances[e] / m_steps[l];
+            nearest[e] = std::min(nearest[e], m_distances[e]);
+            if (nearest[e] > candidate) {
+                candidate = nearest[e];
+                landmark = e;
+            }
+        }
+    }
+}
+
+bool Landmarks::isCurrent() const {
+    return m_revision == m_nav_mesh->getRevision();
+}
+
+std::size_t Landmarks::getNLandmarks() const {
+    return m_n_landmarks;
+}
+
+std::size_t Landmarks::getSize() const {
+    return m_table.size() * sizeof(uint16_t) + m_lowers.size() * sizeof(uint64_t) +
+           m_ranks.size() * sizeof(uint32_t);
+}
+
+void Landmarks::aim(uint32_t goal, Target& target) const {
+    for (auto l=0; l<m_n_landmarks; l++) {
+        target.lows[l] = unreachable;
+        target.highs[l] = 0;
+        for (auto k=0; k<3; k++) {
+            uint16_t step = m_table[rowOf(3 * goal + k) * m_n_landmarks + l];
+            if (step == unreachable) continue;
+            target.lows[l] = std::min(target.lows[l], step);
+            target.highs[l] = std::max(target.highs[l], step);
+        }
+        if (target.lows[l] == unreachable) {
+            target.lows[l] = 0;
+            target.highs[l] = unreachable;
+        }
+    }
+}
+
+/* Dijkstra over the crossable edges, going between the midpoints of the ones of a triangle.
+ * Both half-edges of an edge get the same distance */
+void Landmarks::search(uint32_t landmark) {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    m_distances.assign(mesh.getNHalfEdges(), std::numeric_limits<float>::infinity());
+    auto greater = std::greater<std::pair<float, uint32_t>>();
+    m_distances[landmark] = 0;
+    m_distances[mesh.getTwin(landmark)] = 0;
+    m_open.assign(1, {0, landmark});
+    while (!m_open.empty()) {
+        std::pop_heap(m_open.begin(), m_open.end(), greater);
+        auto [d, e] = m_open.back();
+        m_open.pop_back();
+        if (d > m_distances[e]) continue;
+        Coord from = m_nav_mesh->getMidpoint(e);
+        for (uint32_t side : {e, mesh.getTwin(e)}) {
+            m_nav_mesh->forEachCrossing(TriangleMesh::triangleOf(side),
+                    [&](uint32_t f, uint32_t, Coord middle) {
+                if (f == side) return;
+                float cost = d + distance(from, middle);
+                if (cost >= m_distances[f]) return;
+                m_distances[f] = cost;
+                m_distances[mesh.getTwin(f)] = cost;
+                m_open.push_back({cost, f});
+                std::push_heap(m_open.begin(), m_open.end(), greater);
+            });
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef LANDMARKS_HPP
+#define LANDMARKS_HPP
+
+#include "../graphics/nav_mesh.hpp"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+#include <bit>
+
+namespace adamant {
+namespace physics {
+namespace movement {
+
+/* Lower bounds on the cost left to path finding, by the triangle inequality over the distances
+ * from a few landmarks (ALT). The distances are between the midpoints of the edges A* enters
+ * triangles through, along the walkable triangles, as its costs are, so the bounds hold for
+ * them. Landmarks are picked far from each other (farthest-point), and the distances to every
+ * edge are kept in 16 bits per landmark, rounded down to a step of their own. Both half-edges
+ * of an edge share its row, numbered by the rank of the lower one among the lower ones of all
+ * edges, which a bit per half-edge and a count per word of them give. They have to be built
+ * again once the nav mesh changes, until which they are not used */
+class Landmarks {
+    public:
+        static const unsigned int max_landmarks = 16;
+
+        // Distances from each landmark to the edges the goal triangle can be entered through
+        struct Target {
+            uint16_t lows[max_landmarks];
+            uint16_t highs[max_landmarks];
+        };
+
+        Landmarks(const graphics::NavMesh* nav_mesh, unsigned int n_landmarks = 8);
+        void rebuild();
+        bool isCurrent() const;  // Built for the mesh as it is, so that the bounds hold
+        std::size_t getNLandmarks() const;
+        std::size_t getSize() const;  // Of the table and its index, in bytes
+        void aim(uint32_t goal, Target& target) const;
+
+        // Of the cost from the midpoint of the half-edge to the target
+        float getBound(uint32_t e, const Target& target) const {
+            const uint16_t* steps = &m_table[rowOf(e) * m_n_landmarks];
+            float bound = 0;
+            for (auto l=0; l<m_n_landmarks; l++) {
+                /* Each distance is up to a step more than stored. An edge unreachable from a
+                 * landmark the target is reachable from cannot reach it, so it gets a bound
+                 * past any cost, and targets unreachable from one are aimed so it gives none */
+                int below = (int) steps[l] - target.highs[l] - 1;
+                int above = (int) target.lows[l] - steps[l] - 1;
+                bound = std::max(bound, std::max(below, above) * m_steps[l]);
+            }
+            return bound;
+        }
+
+    private:
+        static const uint16_t unreachable = UINT16_MAX;
+
+        const graphics::NavMesh* m_nav_mesh;
+        unsigned int m_n_landmarks;
+        uint32_t m_revision;  // Of the nav mesh, when last built
+        std::vector<uint32_t> m_landmarks;  // Half-edges
+        std::vector<float> m_steps;  // Per landmark
+        std::vector<uint16_t> m_table;  // By edge, then landmark
+        std::vector<uint64_t> m_lowers;  // Bit per half-edge, set for the lower one of its edge
+        std::vector<uint32_t> m_ranks;  // Lower half-edges before each word of them
+        std::vector<float> m_distances;  // From the last landmark searched, while building
+        std::vector<std::pair<float, uint32_t>> m_open;
+        void search(uint32_t landmark);
+
+        std::size_t rowOf(uint32_t e) const {
+            uint32_t f = m_nav_mesh->getMesh().getTwin(e);
+            if (f < e) e = f;
+            uint64_t before = m_lowers[e / 64] & (((uint64_t) 1 << (e % 64)) - 1);
+            return m_ranks[e / 64] + std::popcount(before);
+        }
+};
+
+}  // namespace movement
+}  // namespace physics
+}  // namespace adamant
+
+#endif
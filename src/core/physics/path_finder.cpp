@@ -0,0 +1,510 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include "path_finder.hpp"
+#include "linear_move.hpp"
+#include "../graphics/triangle_mesh.hpp"
+#include "../concurrency/parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace adamant::physics::movement;
+using namespace adamant::graphics;
+using namespace adamant::concurrency;
+
+PathFinder::PathFinder(const NavMesh* nav_mesh, const ClusterGraph* clusters):
+        m_nav_mesh{nav_mesh}, m_clusters{clusters}, m_landmarks{nullptr}, m_hierarchical{true},
+        m_redirection{false}, m_n_expanded{0}, m_query{0},
+        m_abstract_query{0}, m_cache_size{256}, m_cache_hits{0}, m_cache_misses{0},
+        m_cache_revision{nav_mesh->getRevision()} {}
+
+Path PathFinder::findPath(Coord start, Coord target) {
+    Path path;
+    uint32_t first, last;
+    if (!locate(start, target, first, last)) return path;
+    if (!fetch(first, last)) {
+        if (!findCorridor(first, last, start, target)) return path;
+        store(first, last);
+    }
+    follow(start, target, path);
+    return path;
+}
+
+/* Cache hits are served first, on the calling thread, as the cache is not shared. The misses
+ * are then searched across the scheduler's workers, each chunk of them with a path finder
+ * taken from a pool, once per start and goal triangles, and the corridors found are cached
+ * once they are all done. Misses repeating the triangles of an earlier one follow its corridor */
+void PathFinder::findPaths(JobScheduler* scheduler, std::span<const PathRequest> requests,
+        std::span<Path> paths) {
+    m_pending.clear();
+    m_repeats.clear();
+    m_pending_keys.clear();
+    for (auto i=0; i<requests.size(); i++) {
+        paths[i].clear();
+        uint32_t first, last;
+        Coord target = requests[i].target;
+        if (!locate(requests[i].start, target, first, last)) continue;
+        if (fetch(first, last)) {
+            follow(requests[i].start, target, paths[i]);
+            continue;
+        }
+        auto [it, added] = m_pending_keys.try_emplace((uint64_t) first << 32 | last,
+                                                      m_pending.size());
+        Pending pending = {(uint32_t) i, target, first, last, it->second, false, {}};
+        (added ? m_pending : m_repeats).push_back(pending);
+    }
+
+    parallelFor(scheduler, 0, m_pending.size(), 0, [&](std::size_t begin, std::size_t end) {
+        PathFinder* helper = acquireHelper();
+        for (auto k=begin; k<end; k++) {
+            Pending& pending = m_pending[k];
+            const PathRequest& request = requests[pending.index];
+            pending.found = helper->findCorridor(pending.first, pending.last, request.start,
+                                                 pending.target);
+            if (!pending.found) continue;
+            helper->follow(request.start, pending.target, paths[pending.index]);
+            pending.corridor = helper->m_corridor;
+        }
+        releaseHelper(helper);
+    });
+
+    for (const Pending& repeat : m_repeats) {
+        const Pending& leader = m_pending[repeat.leader];
+        if (!leader.found) continue;
+        m_corridor = leader.corridor;
+        follow(requests[repeat.index].start, repeat.target, paths[repeat.index]);
+    }
+    for (Pending& pending : m_pending) {
+        if (!pending.found) continue;
+        m_corridor.swap(pending.corridor);
+        store(pending.first, pending.last);
+    }
+}
+
+void PathFinder::setHierarchical(bool hierarchical) {
+    m_hierarchical = hierarchical;
+}
+
+void PathFinder::setRedirection(bool redirection) {
+    m_redirection = redirection;
+}
+
+/* Only the corridors through the triangles changed are dropped, which keeps the others valid
+ * but not always the shortest, as removing an obstacle may open shorter ones */
+void PathFinder::invalidate(const std::vector<uint32_t>& changed) {
+    uint32_t revision = m_nav_mesh->getRevision();
+    // Missed an update otherwise, so any corridor could go through blocked triangles
+    if (revision != m_cache_revision + 1) clearCache();
+    m_cache_revision = revision;
+    for (uint32_t t : changed) {
+        auto it = m_cache_triangles.find(t);
+        while (it != m_cache_triangles.end()) {
+            evict(m_cache_entries.at(it->second.back()));
+            it = m_cache_triangles.find(t);
+        }
+    }
+}
+
+void PathFinder::setCacheSize(std::size_t cache_size) {
+    m_cache_size = cache_size;
+    while (m_cache.size() > m_cache_size) {
+        evict(std::prev(m_cache.end()));
+    }
+}
+
+std::size_t PathFinder::getCacheHits() const {
+    return m_cache_hits;
+}
+
+std::size_t PathFinder::getCacheMisses() const {
+    return m_cache_misses;
+}
+
+void PathFinder::setLandmarks(const Landmarks* landmarks) {
+    m_landmarks = landmarks;
+}
+
+std::size_t PathFinder::getNExpanded() const {
+    std::size_t n_expanded = m_n_expanded;
+    for (auto& helper : m_helpers) {
+        n_expanded += helper->m_n_expanded;
+    }
+    return n_expanded;
+}
+
+void PathFinder::resetCounters() {
+    m_cache_hits = 0;
+    m_cache_misses = 0;
+    m_n_expanded = 0;
+    for (auto& helper : m_helpers) {
+        helper->m_n_expanded = 0;
+    }
+}
+
+void PathFinder::clearCache() {
+    m_cache.clear();
+    m_cache_entries.clear();
+    m_cache_triangles.clear();
+    m_cache_revision = m_nav_mesh->getRevision();
+}
+
+/* Triangles of the start and the target, if the start is walkable and the target is in its
+ * component, which blocked triangles are in none of. When redirecting, a target elsewhere is
+ * moved to the nearest point in it */
+bool PathFinder::locate(Coord start, Coord& target, uint32_t& first, uint32_t& last) const {
+    first = m_nav_mesh->findTriangle(start);
+    if (first == TriangleMesh::none || m_nav_mesh->getComponent(first) == TriangleMesh::none) {
+        return false;
+    }
+    uint32_t component = m_nav_mesh->getComponent(first);
+    last = m_nav_mesh->findTriangle(target);
+    if (last != TriangleMesh::none && m_nav_mesh->getComponent(last) == component) return true;
+    if (!m_redirection) return false;
+    target = m_nav_mesh->findNearest(target, component);
+    last = m_nav_mesh->findTriangle(target);
+    return last != TriangleMesh::none && m_nav_mesh->getComponent(last) == component;
+}
+
+// Into the corridor, without the cache
+bool PathFinder::findCorridor(uint32_t first, uint32_t last, Coord start, Coord target) {
+    bool found = m_clusters != nullptr && m_hierarchical && m_clusters->isCurrent() &&
+                 m_clusters->getCluster(first) != m_clusters->getCluster(last) &&
+                 searchClusters(first, last, start, target) &&
+                 refine(first, last, start, target);
+    if (found) return true;
+    if (!search(first, last, start, target, whole)) return false;
+    m_corridor.clear();
+    appendCorridor(last);
+    return true;
+}
+
+// The moves along the corridor, pulled tight
+void PathFinder::follow(Coord start, Coord target, Path& path) {
+    pull(start, target);
+    path.clear();
+    for (auto i=1; i<m_waypoints.size(); i++) {
+        path.push_back(LinearMove(m_waypoints[i-1], m_waypoints[i], right_click));
+    }
+}
+
+// Without a cache, and searching as this one does
+PathFinder* PathFinder::acquireHelper() {
+    std::lock_guard<std::mutex> lock(m_helpers_mutex);
+    if (m_idle_helpers.empty()) {
+        m_helpers.emplace_back(new PathFinder(m_nav_mesh, m_clusters));
+        m_helpers.back()->setCacheSize(0);
+        m_idle_helpers.push_back(m_helpers.back().get());
+    }
+    PathFinder* helper = m_idle_helpers.back();
+    m_idle_helpers.pop_back();
+    helper->setHierarchical(m_hierarchical);
+    helper->setLandmarks(m_landmarks);
+    return helper;
+}
+
+void PathFinder::releaseHelper(PathFinder* helper) {
+    std::lock_guard<std::mutex> lock(m_helpers_mutex);
+    m_idle_helpers.push_back(helper);
+}
+
+// Into the corridor, if cached and up to date, making it the most recently used
+bool PathFinder::fetch(uint32_t first, uint32_t last) {
+    if (m_cache_size == 0) return false;
+    if (m_cache_revision != m_nav_mesh->getRevision()) clearCache();
+    auto it = m_cache_entries.find((uint64_t) first << 32 | last);
+    if (it == m_cache_entries.end()) {
+        m_cache_misses++;
+        return false;
+    }
+    m_cache_hits++;
+    m_cache.splice(m_cache.begin(), m_cache, it->second);
+    m_corridor = it->second->corridor;
+    return true;
+}
+
+// The corridor, replacing any other for the same key, or else the least recently used if full
+void PathFinder::store(uint32_t first, uint32_t last) {
+    if (m_cache_size == 0) return;
+    uint64_t key = (uint64_t) first << 32 | last;
+    auto it = m_cache_entries.find(key);
+    if (it != m_cache_entries.end()) {
+        evict(it->second);
+    } else if (m_cache.size() == m_cache_size) {
+        evict(std::prev(m_cache.end()));
+    }
+    m_cache.push_front({key, m_corridor, {first}});
+    m_cache_entries[key] = m_cache.begin();
+    std::vector<uint32_t>& triangles = m_cache.front().triangles;
+    for (uint32_t e : m_corridor) {
+        triangles.push_back(TriangleMesh::triangleOf(m_nav_mesh->getMesh().getTwin(e)));
+    }
+    for (uint32_t t : triangles) {
+        m_cache_triangles[t].push_back(key);
+    }
+}
+
+void PathFinder::evict(std::list<CacheEntry>::iterator entry) {
+    for (uint32_t t : entry->triangles) {
+        auto it = m_cache_triangles.find(t);
+        if (it == m_cache_triangles.end()) continue;
+        std::vector<uint64_t>& keys = it->second;
+        keys.erase(std::remove(keys.begin(), keys.end(), entry->key), keys.end());
+        if (keys.empty()) m_cache_triangles.erase(it);
+    }
+    m_cache_entries.erase(entry->key);
+    m_cache.erase(entry);
+}
+
+/* Triangles are expanded in order of their cost plus a bound of the cost left, the open set
+ * keeping stale entries for triangles reached again for less, which are skipped when closed.
+ * Without a goal, all the triangles in scope are reached, in order of their cost (Dijkstra) */
+bool PathFinder::search(uint32_t start, uint32_t goal, Coord from, Coord to, Scope scope) {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    std::size_t n_triangles = mesh.getNTriangles();
+    if (m_visited.size() < n_triangles) {
+        m_visited.resize(n_triangles, 0);
+        m_closed.resize(n_triangles, 0);
+        m_costs.resize(n_triangles);
+        m_positions.resize(n_triangles);
+        m_entries.resize(n_triangles);
+    }
+    if (++m_query == 0) {
+        // Wrapped around, so old stamps could be taken as current
+        std::fill(m_visited.begin(), m_visited.end(), 0);
+        std::fill(m_closed.begin(), m_closed.end(), 0);
+        m_query = 1;
+    }
+    auto greater = [](const std::pair<float, uint32_t>& lhs,
+            const std::pair<float, uint32_t>& rhs) {
+        return lhs.first > rhs.first;
+    };
+    bool bounded = m_landmarks != nullptr && goal != TriangleMesh::none &&
+                   m_landmarks->isCurrent();
+    if (bounded) m_landmarks->aim(goal, m_target);
+    // Of the cost left from the midpoint of the half-edge
+    auto estimate = [&](uint32_t e, Coord middle) {
+        if (goal == TriangleMesh::none) return 0.0f;
+        float bound = distance(middle, to);
+        return bounded ? std::max(bound, m_landmarks->getBound(e, m_target)) : bound;
+    };
+
+    m_open.clear();
+    m_visited[start] = m_query;
+    m_costs[start] = 0;
+    m_positions[start] = from;
+    m_entries[start] = TriangleMesh::none;
+    m_open.push_back({goal == TriangleMesh::none ? 0 : distance(from, to), start});
+    while (!m_open.empty()) {
+        std::pop_heap(m_open.begin(), m_open.end(), greater);
+        uint32_t t = m_open.back().second;
+        m_open.pop_back();
+        if (m_closed[t] == m_query) continue;
+        m_closed[t] = m_query;
+        m_n_expanded++;
+        if (t == goal) return true;
+        m_nav_mesh->forEachCrossing(t, [&](uint32_t e, uint32_t u, Coord middle) {
+            if (m_closed[u] == m_query) return;
+            if (scope == cluster && m_clusters->getCluster(u) != m_cluster) return;
+            float cost = m_costs[t] + distance(m_positions[t], middle);
+            if (m_visited[u] == m_query && cost >= m_costs[u]) return;
+            m_visited[u] = m_query;
+            m_costs[u] = cost;
+            m_positions[u] = middle;
+            m_entries[u] = e;
+            m_open.push_back({cost + estimate(e, middle), u});
+            std::push_heap(m_open.begin(), m_open.end(), greater);
+        });
+    }
+    return false;
+}
+
+// Costs between the start and the entrances of its cluster, without leaving it
+void PathFinder::searchCluster(uint32_t start, Coord from, std::vector<float>& costs) {
+    m_cluster = m_clusters->getCluster(start);
+    search(start, TriangleMesh::none, from, from, cluster);
+    const std::vector<uint32_t>& entrances = m_clusters->getEntrances(m_cluster);
+    costs.assign(entrances.size(), std::numeric_limits<float>::infinity());
+    for (auto j=0; j<entrances.size(); j++) {
+        uint32_t t = m_clusters->getSide(entrances[j], m_cluster);
+        if (m_visited[t] != m_query) continue;
+        costs[j] = m_costs[t] + distance(m_positions[t],
+                                         m_clusters->getEntrance(entrances[j]).position);
+    }
+}
+
+/* A* over the entrances, with the start and the target as two more nodes, linked to the
+ * entrances of their clusters. The clusters of the path found are marked as its route */
+bool PathFinder::searchClusters(uint32_t first, uint32_t last, Coord start, Coord target) {
+    uint32_t first_cluster = m_clusters->getCluster(first);
+    uint32_t last_cluster = m_clusters->getCluster(last);
+    searchCluster(first, start, m_start_costs);
+    searchCluster(last, target, m_target_costs);
+
+    std::size_t n_entrances = m_clusters->getNEntrances();
+    uint32_t source = n_entrances, sink = n_entrances + 1;
+    if (m_abstract_visited.size() < n_entrances + 2) {
+        m_abstract_visited.resize(n_entrances + 2, 0);
+        m_abstract_costs.resize(n_entrances + 2);
+        m_abstract_parents.resize(n_entrances + 2);
+        m_abstract_clusters.resize(n_entrances + 2);
+    }
+    if (++m_abstract_query == 0) {
+        std::fill(m_abstract_visited.begin(), m_abstract_visited.end(), 0);
+        m_abstract_query = 1;
+    }
+    auto greater = [](const std::pair<float, uint32_t>& lhs,
+            const std::pair<float, uint32_t>& rhs) {
+        return lhs.first > rhs.first;
+    };
+    auto position = [this, source, sink, start, target](uint32_t x) {
+        if (x == source) return start;
+        if (x == sink) return target;
+        return m_clusters->getEntrance(x).position;
+    };
+    auto reach = [&](uint32_t x, uint32_t parent, uint32_t cluster, float cost) {
+        if (cost == std::numeric_limits<float>::infinity()) return;
+        if (m_abstract_visited[x] == m_abstract_query && cost >= m_abstract_costs[x]) return;
+        m_abstract_visited[x] = m_abstract_query;
+        m_abstract_costs[x] = cost;
+        m_abstract_parents[x] = parent;
+        m_abstract_clusters[x] = cluster;
+        m_open.push_back({cost + distance(position(x), target), x});
+        std::push_heap(m_open.begin(), m_open.end(), greater);
+    };
+
+    m_open.clear();
+    reach(source, TriangleMesh::none, first_cluster, 0);
+    bool found = false;
+    while (!m_open.empty() && !found) {
+        std::pop_heap(m_open.begin(), m_open.end(), greater);
+        auto [estimate, x] = m_open.back();
+        m_open.pop_back();
+        float cost = m_abstract_costs[x];
+        // Stale, as it was reached again for less
+        if (estimate > cost + distance(position(x), target)) continue;
+        if (x == sink) {
+            found = true;
+        } else if (x == source) {
+            const std::vector<uint32_t>& entrances = m_clusters->getEntrances(first_cluster);
+            for (auto j=0; j<entrances.size(); j++) {
+                reach(entrances[j], x, first_cluster, m_start_costs[j]);
+            }
+        } else {
+            const ClusterGraph::Entrance& entrance = m_clusters->getEntrance(x);
+            for (auto side=0; side<2; side++) {
+                uint32_t c = entrance.clusters[side];
+                uint32_t i = entrance.indices[side];
+                const std::vector<uint32_t>& entrances = m_clusters->getEntrances(c);
+                for (auto j=0; j<entrances.size(); j++) {
+                    if (j != i) reach(entrances[j], x, c, cost + m_clusters->getCost(c, i, j));
+                }
+                if (c == last_cluster) reach(sink, x, c, cost + m_target_costs[i]);
+            }
+        }
+    }
+    if (!found) return false;
+
+    m_abstract_path.clear();
+    for (uint32_t x = sink; x != source; x = m_abstract_parents[x]) {
+        m_abstract_path.push_back(x);
+    }
+    std::reverse(m_abstract_path.begin(), m_abstract_path.end());
+    return true;
+}
+
+/* Searches the cluster gone through to each node of the abstract path from the triangle the
+ * last search ended at, and crosses the entrance reached unless the path goes on within the
+ * same cluster. The corridors found are joined by the edges of the entrances crossed */
+bool PathFinder::refine(uint32_t first, uint32_t last, Coord start, Coord target) {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    uint32_t sink = m_clusters->getNEntrances() + 1;
+    m_corridor.clear();
+    uint32_t t = first;
+    Coord from = start;
+    for (auto i=0; i<m_abstract_path.size(); i++) {
+        uint32_t x = m_abstract_path[i];
+        m_cluster = m_abstract_clusters[x];
+        uint32_t goal = x == sink ? last : m_clusters->getSide(x, m_cluster);
+        Coord to = x == sink ? target : m_clusters->getEntrance(x).position;
+        if (!search(t, goal, from, to, cluster)) return false;
+        appendCorridor(goal);
+        t = goal;
+        from = to;
+        if (x == sink || m_abstract_clusters[m_abstract_path[i+1]] == m_cluster) continue;
+        uint32_t edge = m_clusters->getEntrance(x).edge;
+        if (m_cluster != m_clusters->getEntrance(x).clusters[0]) edge = mesh.getTwin(edge);
+        m_corridor.push_back(edge);
+        t = TriangleMesh::triangleOf(mesh.getTwin(edge));
+    }
+    return true;
+}
+
+// The half-edges crossed by the last search, from its start to the given triangle
+void PathFinder::appendCorridor(uint32_t last) {
+    std::size_t size = m_corridor.size();
+    for (uint32_t t = last; m_entries[t] != TriangleMesh::none;
+            t = TriangleMesh::triangleOf(m_entries[t])) {
+        m_corridor.push_back(m_entries[t]);
+    }
+    std::reverse(m_corridor.begin() + size, m_corridor.end());
+}
+
+/* Simple stupid funnel: the funnel from the apex is narrowed by the portals of the corridor, one
+ * side at a time, and when a side would cross over the other, the other's end is a corner of
+ * the path and the apex moves there, going back to the portal where it was set. Portals are
+ * the edges crossed, whose origin is on the right when crossing them out of their triangle */
+void PathFinder::pull(Coord from, Coord to) {
+    const TriangleMesh& mesh = m_nav_mesh->getMesh();
+    m_lefts.assign(1, from);
+    m_rights.assign(1, from);
+    for (uint32_t e : m_corridor) {
+        m_lefts.push_back(mesh.getVertex(mesh.getTarget(e)));
+        m_rights.push_back(mesh.getVertex(mesh.getOrigin(e)));
+    }
+    m_lefts.push_back(to);
+    m_rights.push_back(to);
+
+    auto equal = [](Coord a, Coord b) {
+        return a.x == b.x && a.y == b.y;
+    };
+    m_waypoints.assign(1, from);
+    Coord apex = from, left = from, right = from;
+    std::size_t apex_index = 0, left_index = 0, right_index = 0;
+    for (std::size_t i=1; i<m_lefts.size(); i++) {
+        // Narrow the right side, unless it crosses over the left one
+        if (TriangleMesh::orientation(apex, right, m_rights[i]) >= 0) {
+            if (equal(apex, right) || TriangleMesh::orientation(apex, left, m_rights[i]) < 0) {
+                right = m_rights[i];
+                right_index = i;
+            } else {
+                apex = left;
+                apex_index = left_index;
+                if (!equal(m_waypoints.back(), apex)) m_waypoints.push_back(apex);
+                right = left = apex;
+                right_index = left_index = apex_index;
+                i = apex_index;
+                continue;
+            }
+        }
+        // Narrow the left side, unless it crosses over the right one
+        if (TriangleMesh::orientation(apex, left, m_lefts[i]) <= 0) {
+            if (equal(apex, left) || TriangleMesh::orientation(apex, right, m_lefts[i]) > 0) {
+                left = m_lefts[i];
+                left_index = i;
+            } else {
+                apex = right;
+                apex_index = right_index;
+                if (!equal(m_waypoints.back(), apex)) m_waypoints.push_back(apex);
+                right = left = apex;
+                right_index = left_index = apex_index;
+                i = apex_index;
+                continue;
+            }
+        }
+    }
+    if (!equal(m_waypoints.back(), to)) m_waypoints.push_back(to);
+}
@@ -8,9 +8,20 @@
 #define PATH_FINDER_HPP
 
 #include "move.hpp"
+#include "cluster_graph.hpp"
+#include "landmarks.hpp"
 #include "../graphics/coord.hpp"
 #include "../graphics/nav_mesh.hpp"
+#include "../concurrency/job_scheduler.hpp"
 #include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
 
 namespace adamant {
 namespace physics {
@@ -18,13 +29,128 @@ namespace movement {
 
 typedef std::vector<Move> Path;
 
+typedef struct PathRequest {
+    graphics::Coord start;
+    graphics::Coord target;
+} PathRequest;
+
+/* A* over the walkable triangles of a nav mesh, moving between the midpoints of the edges
+ * crossed, and then the funnel algorithm (simple stupid funnel) to pull the corridor found
+ * tight into the shortest chain of straight moves through it. The search state is kept per
+ * triangle between queries, stamped with the query it belongs to, so that nothing is cleared
+ * or allocated per query once it has grown to the mesh. A path finder is for one thread.
+ * Given a cluster graph, paths between clusters are searched first in it, from the start to
+ * the entrances of its cluster and from those of the target's, and then refined into a
+ * corridor by searching each cluster it goes through, from one entrance to the next. If the
+ * graph misses an update of the nav mesh, or finds no path, as it may miss some within
+ * clusters, the whole mesh is searched instead. The corridors found are kept in an LRU cache
+ * by their start and goal triangles, so that repeated queries between the same places only
+ * pull them again for their endpoints. Updates of the nav mesh have to be passed on to drop
+ * the ones through the triangles changed, or the whole cache is dropped. Batches of queries
+ * may be spread across the workers of a scheduler, each one searching with its own state.
+ * Given landmarks, A* also bounds the cost left by them, and not only by the straight line.
+ * Targets in another component of the nav mesh than the start are known to be unreachable
+ * without searching, and may be redirected to the nearest point which is not */
 class PathFinder {
     public:
-        PathFinder(graphics::NavMesh);
+        PathFinder(const graphics::NavMesh* nav_mesh, const ClusterGraph* clusters = nullptr);
+        /* Empty if the start is not walkable, or the target is not walkable or connected to it,
+         * unless redirecting, when the path goes to the nearest point connected instead */
         Path findPath(graphics::Coord start, graphics::Coord target);
+        // Into the paths given, one per request, which the calling thread waits for
+        void findPaths(concurrency::JobScheduler* scheduler,
+                std::span<const PathRequest> requests, std::span<Path> paths);
+        void setHierarchical(bool hierarchical);  // Whether to use the cluster graph, if any
+        void setRedirection(bool redirection);  // Whether to redirect unreachable targets
+        // Drops the cached corridors through the triangles given, or all if one update was missed
+        void invalidate(const std::vector<uint32_t>& changed);
+        void setCacheSize(std::size_t cache_size);  // In corridors, none to disable it
+        void setLandmarks(const Landmarks* landmarks);  // None to bound by the straight line
+        std::size_t getCacheHits() const;
+        std::size_t getCacheMisses() const;
+        std::size_t getNExpanded() const;  // Triangles, including in batches
+        void resetCounters();
 
     private:
-        graphics::NavMesh m_nav_mesh;
+        enum Scope {whole, cluster};  // Triangles searched
+
+        struct CacheEntry {
+            uint64_t key;  // Start triangle, then goal triangle
+            std::vector<uint32_t> corridor;
+            std::vector<uint32_t> triangles;  // Gone through, as when found
+        };
+
+        struct Pending {  // Request of a batch missing the cache
+            uint32_t index;
+            graphics::Coord target;  // Redirected, if so
+            uint32_t first;
+            uint32_t last;
+            uint32_t leader;  // Pending request searched for the same triangles, if a repeat
+            bool found;
+            std::vector<uint32_t> corridor;
+        };
+
+        const graphics::NavMesh* m_nav_mesh;
+        const ClusterGraph* m_clusters;
+        const Landmarks* m_landmarks;
+        Landmarks::Target m_target;  // Of the landmarks, for the goal searched
+        bool m_hierarchical;
+        bool m_redirection;
+        std::size_t m_n_expanded;
+        uint32_t m_query;
+        std::vector<uint32_t> m_visited;  // Query in which each triangle was last reached
+        std::vector<uint32_t> m_closed;  // Query in which each triangle was last expanded
+        std::vector<float> m_costs;  // From the start, to the triangle's position
+        std::vector<graphics::Coord> m_positions;  // Midpoint of the edge entering it
+        std::vector<uint32_t> m_entries;  // Half-edge entering it, in the triangle before
+        std::vector<std::pair<float, uint32_t>> m_open;  // Min-heap by estimated total cost
+        std::vector<uint32_t> m_corridor;  // Half-edges crossed, in order
+        std::vector<graphics::Coord> m_lefts;  // Portals, along the corridor
+        std::vector<graphics::Coord> m_rights;
+        std::vector<graphics::Coord> m_waypoints;
+        uint32_t m_cluster;  // Searched, by cluster scope
+        uint32_t m_abstract_query;
+        std::vector<float> m_start_costs;  // To the entrances of the start's cluster
+        std::vector<float> m_target_costs;  // From the entrances of the target's cluster
+        std::vector<uint32_t> m_abstract_visited;  // Per entrance, then start and target
+        std::vector<float> m_abstract_costs;
+        std::vector<uint32_t> m_abstract_parents;
+        std::vector<uint32_t> m_abstract_clusters;  // Gone through from the parent
+        std::vector<uint32_t> m_abstract_path;  // Entrances, then the target
+        std::size_t m_cache_size;
+        std::size_t m_cache_hits;
+        std::size_t m_cache_misses;
+        uint32_t m_cache_revision;  // Of the nav mesh, as last passed on
+        std::list<CacheEntry> m_cache;  // Most recently used first
+        std::unordered_map<uint64_t, std::list<CacheEntry>::iterator> m_cache_entries;
+        // Keys of the corridors through each triangle
+        std::unordered_map<uint32_t, std::vector<uint64_t>> m_cache_triangles;
+        std::vector<Pending> m_pending;
+        std::vector<Pending> m_repeats;  // Of pending requests, following their corridors
+        std::unordered_map<uint64_t, uint32_t> m_pending_keys;  // Pending request by key
+        std::mutex m_helpers_mutex;
+        std::vector<std::unique_ptr<PathFinder>> m_helpers;  // Search for batches
+        std::vector<PathFinder*> m_idle_helpers;
+        bool locate(graphics::Coord start, graphics::Coord& target, uint32_t& first,
+                uint32_t& last) const;
+        bool findCorridor(uint32_t first, uint32_t last, graphics::Coord start,
+                graphics::Coord target);
+        void follow(graphics::Coord start, graphics::Coord target, Path& path);
+        PathFinder* acquireHelper();
+        void releaseHelper(PathFinder* helper);
+        bool search(uint32_t start, uint32_t goal, graphics::Coord from, graphics::Coord to,
+                Scope scope);
+        void searchCluster(uint32_t start, graphics::Coord from, std::vector<float>& costs);
+        bool searchClusters(uint32_t first, uint32_t last, graphics::Coord start,
+                graphics::Coord target);
+        bool refine(uint32_t first, uint32_t last, graphics::Coord start,
+                graphics::Coord target);
+        void appendCorridor(uint32_t last);
+        void clearCache();
+        bool fetch(uint32_t first, uint32_t last);
+        void store(uint32_t first, uint32_t last);
+        void evict(std::list<CacheEntry>::iterator entry);
+        void pull(graphics::Coord from, graphics::Coord to);
 };
 
 }  // namespace movement
@@ -0,0 +1,131 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#ifndef BOX_MAP_HPP
+#define BOX_MAP_HPP
+
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include "../core/graphics/nav_mesh.hpp"
+#include "../core/graphics/map_size.hpp"
+#include "../core/graphics/coord.hpp"
+#include "../core/graphics/triangle_mesh.hpp"
+#include "../core/logic/elements/terrain.hpp"
+
+typedef struct Box {
+    int x_1, y_1, x_2, y_2;
+} Box;
+
+// Within the box, not on its border, allowing for the rounding of the moves
+inline bool within(const Box& box, float x, float y) {
+    const float margin = 0.01;
+    return x > box.x_1 + margin && x < box.x_2 - margin && y > box.y_1 + margin &&
+           y < box.y_2 - margin;
+}
+
+/* Square map of 40 px cells for the benchmarks, made of boxes of terrain, which are also kept
+ * by the cells they overlap to check moves against. It owns the terrain added to it */
+class BoxMap {
+    public:
+        explicit BoxMap(int_least16_t n_cells): m_n_cells{n_cells},
+                m_size{(int_least16_t) (40 * n_cells), (int_least16_t) (40 * n_cells)},
+                m_boxes(n_cells * n_cells) {}
+
+        adamant::logic::elements::Terrain* addBox(int x_1, int y_1, int x_2, int y_2) {
+            auto s = new adamant::graphics::elements::ConvexPolygon({{x_1, y_1}, {x_1, y_2},
+                    {x_2, y_2}, {x_2, y_1}});
+            int radius = std::hypot(x_2 - x_1, y_2 - y_1) / 2;
+            m_owned.emplace_back(new adamant::logic::elements::Terrain(s,
+                    {(x_1 + x_2) / 2, (y_1 + y_2) / 2}, radius));
+            m_terrains.push_back(m_owned.back().get());
+            for (auto x=x_1 / 40; x<=std::min((x_2 - 1) / 40, m_n_cells - 1); x++) {
+                for (auto y=y_1 / 40; y<=std::min((y_2 - 1) / 40, m_n_cells - 1); y++) {
+                    m_boxes[x * m_n_cells + y].push_back({x_1, y_1, x_2, y_2});
+                }
+            }
+            return m_terrains.back();
+        }
+
+        // A box of random size within each cell, the same ones every time
+        void addGrid() {
+            srand(0);
+            for (auto x=0; x<m_size.x; x+=40) {
+                for (auto y=0; y<m_size.y; y+=40) {
+                    int x_1 = x + 5 + rand() % 10, x_2 = x + 20 + rand() % 15;
+                    int y_1 = y + 5 + rand() % 10, y_2 = y + 20 + rand() % 15;
+                    addBox(x_1, y_1, x_2, y_2);
+                }
+            }
+        }
+
+        // Small boxes in the free space between the cells along the diagonal, to insert later
+        std::vector<adamant::logic::elements::Terrain*> addDiagonal() {
+            std::vector<adamant::logic::elements::Terrain*> obstacles;
+            for (auto x=40; x<m_size.x; x+=40) {
+                obstacles.push_back(addBox(x, x, x+3, x+3));
+            }
+            return obstacles;
+        }
+
+        bool isBlocked(float x, float y) const {
+            int column = std::clamp<int>(x / 40, 0, m_n_cells - 1);
+            int row = std::clamp<int>(y / 40, 0, m_n_cells - 1);
+            for (const Box& box : m_boxes[column * m_n_cells + row]) {
+                if (within(box, x, y)) return true;
+            }
+            return false;
+        }
+
+        int_least16_t getNCells() const {
+            return m_n_cells;
+        }
+
+        adamant::graphics::MapSize getSize() const {
+            return m_size;
+        }
+
+        // Added so far
+        const std::vector<adamant::logic::elements::Terrain*>& getTerrains() const {
+            return m_terrains;
+        }
+
+        // Of the first cell
+        const Box& getFirstBox() const {
+            return m_boxes[0][0];
+        }
+
+    private:
+        int_least16_t m_n_cells;
+        adamant::graphics::MapSize m_size;
+        std::vector<std::unique_ptr<adamant::logic::elements::Terrain>> m_owned;
+        std::vector<adamant::logic::elements::Terrain*> m_terrains;
+        std::vector<std::vector<Box>> m_boxes;  // By cell, column-major
+};
+
+// Corners of the box, then the midpoints of its sides
+inline std::vector<adamant::graphics::Coord> getBorder(const Box& box) {
+    int_fast16_t x_1 = box.x_1, y_1 = box.y_1, x_2 = box.x_2, y_2 = box.y_2;
+    int_fast16_t x_m = (x_1 + x_2) / 2, y_m = (y_1 + y_2) / 2;
+    return {{x_1, y_1}, {x_2, y_1}, {x_2, y_2}, {x_1, y_2},
+            {x_m, y_1}, {x_2, y_m}, {x_m, y_2}, {x_1, y_m}};
+}
+
+// Random coordinates within a walkable triangle
+inline adamant::graphics::Coord findWalkable(const adamant::graphics::NavMesh& nav_mesh) {
+    using adamant::graphics::TriangleMesh;
+    while (true) {
+        adamant::graphics::Coord c = {rand() % nav_mesh.getMapSize().x,
+                                      rand() % nav_mesh.getMapSize().y};
+        uint32_t t = nav_mesh.findTriangle(c);
+        if (t != TriangleMesh::none && !nav_mesh.getMesh().isBlocked(t)) return c;
+    }
+}
+
+#endif
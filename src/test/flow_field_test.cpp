@@ -0,0 +1,206 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include "../core/graphics/nav_mesh.hpp"
+#include "../core/physics/flow_field.hpp"
+#include "../core/physics/path_finder.hpp"
+#include "../core/logic/elements/terrain.hpp"
+#include "box_map.hpp"
+
+using namespace adamant::logic::elements;
+using namespace adamant::graphics;
+using namespace adamant::graphics::elements;
+using namespace adamant::physics::movement;
+
+/* Units following the field from each start, by its waypoints, and how far they went. The ones
+ * an obstacle was inserted on cannot move */
+void follow(const FlowField& field, const std::vector<Coord>& starts, const BoxMap& map,
+        const char* name) {
+    Coord goal = field.getGoal();
+    std::size_t n_arrived = 0, n_blocked = 0, n_hops = 0, n_inside = 0;
+    double stretch = 0;
+    for (Coord start : starts) {
+        if (map.isBlocked(start.x, start.y)) {
+            n_inside++;
+            continue;
+        }
+        Coord position = start;
+        float length = 0;
+        bool blocked = false;
+        for (auto i=0; i<100000; i++) {
+            Coord waypoint = field.getWaypoint(position);
+            if (waypoint.x == position.x && waypoint.y == position.y) break;
+            float distance = std::hypot(waypoint.x - position.x, waypoint.y - position.y);
+            for (float d=0; d<=distance && !blocked; d+=0.25) {
+                float x = position.x + (waypoint.x - position.x) * d / distance;
+                float y = position.y + (waypoint.y - position.y) * d / distance;
+                blocked = map.isBlocked(x, y);
+            }
+            length += distance;
+            position = waypoint;
+            n_hops++;
+        }
+        if (blocked) n_blocked++;
+        if (position.x != goal.x || position.y != goal.y) continue;
+        n_arrived++;
+        stretch += length / std::max(1.0, std::hypot(goal.x - start.x, goal.y - start.y));
+    }
+    std::cout << "  " << name << ": " << n_arrived << " of " << starts.size() - n_inside
+              << " arrived, " << (double) n_hops / starts.size() << " waypoints each, "
+              << stretch / std::max<std::size_t>(n_arrived, 1)
+              << " times the straight distance, " << n_blocked << " through terrain, "
+              << n_inside << " within it" << std::endl;
+}
+
+// Triangles reachable in one but not in the other, or else by how much their distances differ
+void compare(const FlowField& lhs, const FlowField& rhs, std::size_t n_triangles,
+        const char* name) {
+    const float infinity = std::numeric_limits<float>::infinity();
+    std::size_t n_unreachable = 0, n_different = 0;
+    double max_difference = 0;
+    for (uint32_t t=0; t<n_triangles; t++) {
+        float a = lhs.getDistance(t), b = rhs.getDistance(t);
+        if ((a == infinity) != (b == infinity)) n_unreachable++;
+        if (a == infinity || b == infinity || a == b) continue;
+        n_different++;
+        max_difference = std::max<double>(max_difference, std::abs(a - b) / std::max(b, 1.0f));
+    }
+    std::cout << "  " << name << ": " << n_unreachable << " reachable in only one, "
+              << n_different << " at a different distance, by up to " << 100 * max_difference
+              << "%" << std::endl;
+}
+
+/* Many units going to one goal on a grid of random boxes, with a field against a path each,
+ * and the field updated along with the nav mesh */
+void benchmark(int_least16_t n_cells, std::size_t n_units) {
+    BoxMap map(n_cells);
+    map.addGrid();
+    NavMesh nav_mesh(map.getTerrains(), map.getSize());
+    const TriangleMesh& mesh = nav_mesh.getMesh();
+    Coord goal = findWalkable(nav_mesh);
+    std::vector<Coord> starts;
+    for (auto i=0; i<n_units; i++) {
+        starts.push_back(findWalkable(nav_mesh));
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    FlowFieldCache fields(&nav_mesh);
+    std::shared_ptr<const FlowField> held = fields.get(goal);
+    const FlowField& field = *held;
+    auto end = std::chrono::high_resolution_clock::now();
+    double field_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    PathFinder path_finder(&nav_mesh);
+    path_finder.setCacheSize(0);
+    start = std::chrono::high_resolution_clock::now();
+    for (Coord c : starts) {
+        path_finder.findPath(c, goal);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double paths_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    start = std::chrono::high_resolution_clock::now();
+    std::size_t n_still = 0;
+    for (Coord c : starts) {
+        Direction direction = field.getDirection(c);
+        if (direction.x == 0 && direction.y == 0) n_still++;
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double lookup_ns = std::chrono::duration<double, std::nano>(end - start).count() / n_units;
+    std::cout << mesh.getNTriangles() << " triangles: field built in " << field_ms << " ms, "
+              << n_units << " paths found in " << paths_ms << " ms, " << lookup_ns
+              << " ns to look up a direction, " << n_still << " without one" << std::endl;
+    follow(field, starts, map, "Field");
+    if (fields.get(goal) != held || fields.getSize() != 1) {
+        std::cout << "  The cache built the same field again" << std::endl;
+    }
+    // Dropped for another goal while held, a field is kept, but no longer updated
+    FlowFieldCache single(&nav_mesh, 1);
+    std::shared_ptr<const FlowField> dropped = single.get(goal);
+    single.get(starts[0]);
+
+    /* Updated along with the nav mesh, the field reaches the same triangles as if built again,
+     * for about the same distance, as its cost depends on the way the search went */
+    std::vector<Terrain*> obstacles = map.addDiagonal();
+    double update_max = 0;
+    for (auto t : obstacles) {
+        std::vector<uint32_t> changed = nav_mesh.insertObstacle(t);
+        start = std::chrono::high_resolution_clock::now();
+        fields.update(changed);
+        end = std::chrono::high_resolution_clock::now();
+        update_max = std::max(update_max,
+                std::chrono::duration<double, std::micro>(end - start).count());
+        single.update(changed);
+    }
+    Coord position = dropped->getWaypoint(starts[0]);
+    if (dropped->isCurrent() || position.x != starts[0].x || position.y != starts[0].y ||
+            single.get(goal) == dropped || !single.get(goal)->isCurrent()) {
+        std::cout << "  The dropped field was updated or given again" << std::endl;
+    }
+    FlowField rebuilt(&nav_mesh, goal);
+    std::cout << "  " << obstacles.size() << " obstacles: " << update_max
+              << " us max to update" << std::endl;
+    compare(field, rebuilt, mesh.getNTriangles(), "Against rebuilt");
+    follow(field, starts, map, "Field, updated");
+
+    // And again as they are removed, opening shorter ways
+    update_max = 0;
+    for (auto t : obstacles) {
+        std::vector<uint32_t> changed = nav_mesh.removeObstacle(t);
+        start = std::chrono::high_resolution_clock::now();
+        fields.update(changed);
+        end = std::chrono::high_resolution_clock::now();
+        update_max = std::max(update_max,
+                std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    rebuilt.rebuild();
+    std::cout << "  Removed: " << update_max << " us max to update" << std::endl;
+    compare(field, rebuilt, mesh.getNTriangles(), "Against rebuilt");
+}
+
+// Units on the borders of terrain and of an inserted obstacle, and a goal on each of them
+void borders() {
+    BoxMap map(5);
+    map.addBox(80, 80, 120, 120);
+    NavMesh nav_mesh(map.getTerrains(), map.getSize());
+    nav_mesh.insertObstacle(map.addBox(40, 150, 60, 170));
+    std::vector<Coord> points;
+    for (const Box& box : {Box{80, 80, 120, 120}, Box{40, 150, 60, 170}}) {
+        std::vector<Coord> border = getBorder(box);
+        points.insert(points.end(), border.begin(), border.end());
+    }
+    std::cout << "Borders of " << nav_mesh.getMesh().getNTriangles() << " triangles" << std::endl;
+    follow(FlowField(&nav_mesh, {10, 10}), points, map, "From them");
+    std::vector<Coord> open = {{10, 10}, {190, 10}, {190, 190}, {10, 190}};
+    std::size_t n_arrived = 0;
+    for (Coord goal : points) {
+        FlowField field(&nav_mesh, goal);
+        for (Coord start : open) {
+            Coord position = start;
+            for (auto i=0; i<1000; i++) {
+                Coord waypoint = field.getWaypoint(position);
+                if (waypoint.x == position.x && waypoint.y == position.y) break;
+                position = waypoint;
+            }
+            if (position.x == goal.x && position.y == goal.y) n_arrived++;
+        }
+    }
+    std::cout << "  To them: " << n_arrived << " of " << points.size() * open.size()
+              << " arrived" << std::endl;
+}
+
+int main() {
+    benchmark(10, 1000);
+    benchmark(40, 1000);
+    benchmark(112, 1000);
+    borders();
+    return 0;
+}
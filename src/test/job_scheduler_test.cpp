@@ -8,7 +8,17 @@
 #include <mutex>
 #include <thread>
 #include <chrono>
+#include <fstream>
+#include <array>
+#include <atomic>
+#include <vector>
+#include <stdexcept>
 #include "../core/concurrency/job_scheduler.hpp"
+#include "../core/concurrency/parallel.hpp"
+#include "../core/concurrency/job_graph.hpp"
+#include "../core/concurrency/callable_job.hpp"
+#include "../core/concurrency/task.hpp"
+#include "../core/concurrency/timer_wheel.hpp"
 
 using namespace adamant::concurrency;
 
@@ -19,12 +29,81 @@ void action(uintptr_t param) {
     std::cout << "Job " << param << std::endl;
 }
 
+void nothing(uintptr_t) {}
+
+// Node of a recursive fan-out, which kicks a batch of its children and joins it
+struct FanOut {
+    JobScheduler* js;
+    int depth;
+    std::atomic<int>* leaves;
+};
+
+void fanOut(uintptr_t param) {
+    FanOut* node = (FanOut*) param;
+    if (node->depth == 0) {
+        (*node->leaves)++;
+        return;
+    }
+    std::vector<FanOut> children(4, {node->js, node->depth - 1, node->leaves});
+    std::vector<uintptr_t> params;
+    for (FanOut& child : children) {
+        params.push_back((uintptr_t) &child);
+    }
+    JobBatch batch(fanOut, params, medium);
+    node->js->kickJobBatch(&batch);
+    batch.join();
+}
+
+Task<int> square(JobScheduler* js, int x) {
+    co_await js->schedule();
+    co_return x * x;
+}
+
+Task<int> plan(JobScheduler* js) {
+    int total = co_await square(js, 3);
+    JobBatch batch(action, {5, 6}, medium);
+    co_await js->schedule(&batch);
+    co_await js->sleepFor(std::chrono::milliseconds(10));
+    Task<int> a = square(js, 4);
+    Task<int> b = square(js, 5);
+    co_await whenAll(js, &a, &b);
+    co_return total + a.get() + b.get();
+}
+
+Task<int> idle(JobScheduler* js, int i) {
+    co_await js->sleepFor(std::chrono::milliseconds(100));
+    co_return i;
+}
+
+// Fires every period of simulation time
+struct Periodic {
+    TimerWheel* timer_wheel;
+    float period;
+    int fires;
+    Job job;
+    Periodic(TimerWheel* timer_wheel, float period);
+};
+
+void fire(uintptr_t param) {
+    Periodic* periodic = (Periodic*) param;
+    periodic->fires++;
+    periodic->timer_wheel->schedule(&periodic->job, periodic->period);
+}
+
+Periodic::Periodic(TimerWheel* timer_wheel, float period): timer_wheel{timer_wheel},
+        period{period}, fires{0}, job(fire, (uintptr_t) this, medium, nullptr) {
+    timer_wheel->schedule(&job, period);
+}
+
 int main() {
     JobScheduler* js = new JobScheduler();
     
     std::unique_lock<std::mutex> lock(mutex);
     std::cout << "\nN. of CPUs: " << js->getNCpus() << std::endl;
     std::cout << "N. of threads: " << js->getNThreads() << std::endl;
+    const Topology& topology = js->getTopology();
+    std::cout << "N. of cores: " << topology.getNCores() << ", packages: "
+              << topology.getNPackages() << ", NUMA nodes: " << topology.getNNodes() << std::endl;
     std::cout << "\n --- JOB TEST ---\n\n";
     lock.unlock();
     
@@ -49,6 +128,271 @@ int main() {
     batch->join();
 
     lock.lock();
+    std::cout << "\n --- PARALLEL FOR TEST ---\n\n";
+    lock.unlock();
+
+    // Should print the same sum twice
+    std::vector<uint64_t> squares(1000000);
+    parallelFor(js, 0, squares.size(), 0, [&squares](std::size_t begin, std::size_t end) {
+        for (auto i=begin; i<end; i++) {
+            squares[i] = i * i;
+        }
+    });
+    uint64_t sum = parallelReduce(js, 0, squares.size(), 4096, (uint64_t) 0,
+        [&squares](std::size_t begin, std::size_t end) {
+            uint64_t partial = 0;
+            for (auto i=begin; i<end; i++) {
+                partial += squares[i];
+            }
+            return partial;
+        }, [](uint64_t lhs, uint64_t rhs) { return lhs + rhs; });
+    uint64_t expected = 0;
+    for (uint64_t i=0; i<squares.size(); i++) {
+        expected += i * i;
+    }
+    // Of bools, whose partial results must not be packed into shared words
+    bool all_squares = parallelReduce(js, 0, squares.size(), 1000, true,
+        [&squares](std::size_t begin, std::size_t end) {
+            for (auto i=begin; i<end; i++) {
+                if (squares[i] != i * i) return false;
+            }
+            return true;
+        }, [](bool lhs, bool rhs) { return lhs && rhs; });
+    lock.lock();
+    std::cout << "Sum of squares: " << sum << " (expected " << expected << ")" << std::endl;
+    std::cout << "All squares: " << (all_squares ? "yes" : "no") << " (expected yes)" << std::endl;
+    std::cout << "\n --- JOB GRAPH TEST ---\n\n";
+    lock.unlock();
+
+    // Should print 1, then 2 and 3 in any order, then 4, and a DOT graph with times
+    JobGraph graph;
+    auto first = graph.addJob("first", action, 1, low);
+    auto left = graph.addJob("left", action, 2, low);
+    auto right = graph.addJob("right", action, 3, low);
+    auto last = graph.addJob("last", action, 4, low);
+    graph.addDependency(first, left);
+    graph.addDependency(first, right);
+    graph.addDependency(left, last);
+    graph.addDependency(right, last);
+    graph.kick(js);
+    graph.join();
+    lock.lock();
+    graph.dump(std::cout);
+    std::cout << "\n --- JOIN TEST ---\n\n";
+
+    // Joining a finished batch should only take an atomic load
+    std::vector<uintptr_t> nothing_params(64, 0);
+    const int n_batches = 10000;
+    float kick_join_time = 0;
+    float rejoin_time = 0;
+    for (auto i=0; i<n_batches; i++) {
+        JobBatch* batch = new JobBatch(nothing, nothing_params, medium);
+        auto t0 = std::chrono::steady_clock::now();
+        js->kickJobBatch(batch);
+        batch->join();
+        auto t1 = std::chrono::steady_clock::now();
+        batch->join();
+        auto t2 = std::chrono::steady_clock::now();
+        kick_join_time += std::chrono::duration<float, std::micro>(t1 - t0).count();
+        rejoin_time += std::chrono::duration<float, std::nano>(t2 - t1).count();
+        delete batch;
+    }
+    std::cout << "Kick and join: " << kick_join_time / n_batches << " us per batch of "
+              << nothing_params.size() << std::endl;
+    std::cout << "Join when finished: " << rejoin_time / n_batches << " ns" << std::endl;
+    // Should reach every leaf, with the joins nested 4 deep, even on a single worker
+    for (unsigned int n_threads : {1, 2, 4}) {
+        SchedulerConfig nested_config;
+        nested_config.n_threads = n_threads;
+        JobScheduler* nested = new JobScheduler(nested_config);
+        std::atomic<int> leaves(0);
+        FanOut root = {nested, 4, &leaves};
+        Job* job = new Job(fanOut, (uintptr_t) &root, medium);
+        nested->kickJob(job);
+        job->join();
+        delete job;
+        delete nested;
+        std::cout << "Nested joins on " << n_threads << " threads: " << leaves
+                  << " leaves (expected 256)" << std::endl;
+    }
+    std::cout << "\n --- CALLABLE JOB TEST ---\n\n";
+
+    // Should print 42 and 499500, the first callable stored inline and the second one not
+    int base = 40;
+    CallableJob answer([base]{ return base + 2; }, high);
+    std::vector<int> numbers(1000);
+    for (auto i=0; i<numbers.size(); i++) {
+        numbers[i] = i;
+    }
+    std::array<int, 64> padding = {};
+    CallableJob total([&numbers, padding]{
+        int result = padding[0];
+        for (int n : numbers) {
+            result += n;
+        }
+        return result;
+    });
+    CallableJob<void> failure([]{ throw std::runtime_error("Job exception"); });
+    lock.unlock();
+    js->kickJob(&answer);
+    js->kickJob(&total);
+    js->kickJob(&failure);
+    int answer_result = answer.get();
+    int total_result = total.get();
+    lock.lock();
+    std::cout << answer_result << (answer.isInline() ? " (inline)" : " (heap)") << std::endl;
+    std::cout << total_result << (total.isInline() ? " (inline)" : " (heap)") << std::endl;
+    try {
+        failure.get();
+    } catch (const std::runtime_error& e) {
+        std::cout << e.what() << std::endl;
+    }
+    std::cout << "\n --- COROUTINE TEST ---\n\n";
+
+    // Should print 5 and 6 in any order, then 50
+    lock.unlock();
+    Task<int> plan_task = plan(js);
+    plan_task.start(js);
+    int plan_result = plan_task.get();
+    lock.lock();
+    std::cout << plan_result << std::endl;
+    // Suspended tasks take no thread nor fiber, so thousands of them may sleep at once
+    const int n_tasks = 10000;
+    std::vector<Task<int>> idle_tasks;
+    for (auto i=0; i<n_tasks; i++) {
+        idle_tasks.push_back(idle(js, i));
+        idle_tasks.back().start(js);
+    }
+    long long idle_sum = 0;
+    for (auto& task : idle_tasks) {
+        idle_sum += task.get();
+    }
+    std::cout << idle_sum << " (expected " << (long long) n_tasks * (n_tasks - 1) / 2 << ")"
+              << std::endl;
+    std::cout << "\n --- TIMER WHEEL TEST ---\n\n";
+
+    // Should print 6, 4, 2 and 1 in order (3 and 5 are cancelled), then 7 once kicked
+    TimerWheel* timer_wheel = new TimerWheel(js);
+    std::vector<Job*> ordered = {new Job(action, 1, medium), new Job(action, 2, medium),
+                                 new Job(action, 3, medium), new Job(action, 4, medium),
+                                 new Job(action, 5, medium), new Job(action, 6, medium)};
+    float delays[] = {5, 10, 20, 300, 400000, 100000000};  // The last ones cascade down
+    std::vector<TimerWheel::TimerId> timers;
+    for (auto i=0; i<ordered.size(); i++) {
+        timers.push_back(timer_wheel->schedule(ordered[i], delays[5 - i]));
+    }
+    timer_wheel->cancel(timers[2]);
+    timer_wheel->cancel(timers[4]);
+    std::cout << "Cancelling twice: " << timer_wheel->cancel(timers[4]) << std::endl;
+    std::vector<Job*> expired;
+    while (timer_wheel->getNPending() > 0) {
+        timer_wheel->advance(1000, expired);
+    }
+    lock.unlock();
+    for (Job* job : expired) {
+        job->getAction()(job->getParam());
+    }
+    for (Job* job : ordered) {
+        delete job;
+    }
+    Job* kicked = new Job(action, 7, medium);
+    timer_wheel->schedule(kicked, 100);
+    timer_wheel->advance(100);
+    kicked->join();
+    lock.lock();
+    delete kicked;
+    // Thousands of periodic timers, such as AI turns, cost nothing while they are not due
+    delete timer_wheel;
+    timer_wheel = new TimerWheel(js);
+    const int n_timers = 10000;
+    std::vector<Periodic*> periodics;
+    int expected_fires = 0;
+    for (auto i=0; i<n_timers; i++) {
+        int period = 100 + i % 400;
+        periodics.push_back(new Periodic(timer_wheel, period));
+        // They fire on the frame they expire in, and are rescheduled from its end
+        for (int due = period; (due + 15) / 16 * 16 <= 10000; due = (due + 15) / 16 * 16 + period) {
+            expected_fires++;
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (auto frame=0; frame<625; frame++) {  // 10 s of simulation at 16 ms per frame
+        expired.clear();
+        timer_wheel->advance(16, expired);
+        for (Job* job : expired) {
+            job->getAction()(job->getParam());
+        }
+    }
+    std::chrono::duration<float, std::milli> advancing = std::chrono::steady_clock::now() - start;
+    int fires = 0;
+    for (Periodic* periodic : periodics) {
+        fires += periodic->fires;
+        delete periodic;
+    }
+    std::cout << fires << " fires (expected " << expected_fires << ") in " << advancing.count()
+              << " ms" << std::endl;
+    delete timer_wheel;
+    std::cout << "\n --- CONFIG TEST ---\n\n";
+
+    // Should print every worker pinned to a single CPU, after the reserved one
+    SchedulerConfig config;
+    config.n_threads = 2;
+    config.pinning = scatter;
+    config.n_reserved_cpus = 1;
+    JobScheduler* pinned = new JobScheduler(config);
+    std::cout << "Reserved CPUs:";
+    for (unsigned int id : pinned->getReservedCpus()) {
+        std::cout << " " << id;
+    }
+    std::cout << std::endl;
+    for (auto i=0; i<pinned->getNThreads(); i++) {
+        std::cout << "Worker " << i << " CPUs:";
+        for (unsigned int id : pinned->getWorkerCpus(i)) {
+            std::cout << " " << id;
+        }
+        std::cout << std::endl;
+    }
+    lock.unlock();
+    JobBatch* pinned_batch = new JobBatch(action, {1, 2, 3}, medium);
+    pinned->kickJobBatch(pinned_batch);
+    pinned_batch->join();
+    delete pinned_batch;
+    delete pinned;
+    lock.lock();
+    // Should be rejected
+    config.pinning = explicit_cpus;
+    config.cpus = {CPU_SETSIZE};
+    try {
+        pinned = new JobScheduler(config);
+        delete pinned;
+    } catch (const JobScheduler::InvalidConfigException& e) {
+        std::cout << e.what() << std::endl;
+    }
+    std::cout << "\n --- WORKER METRICS ---\n\n";
+    std::vector<WorkerMetrics> metrics = js->getWorkerMetrics();
+    for (auto i=0; i<metrics.size(); i++) {
+        std::cout << "Worker " << i << ": " << metrics[i].jobs_executed << " executed, "
+                  << metrics[i].jobs_stolen << " stolen, " << metrics[i].jobs_injected
+                  << " injected, " << metrics[i].failed_steals << "/"
+                  << metrics[i].steal_attempts << " failed steals, " << metrics[i].sleeps
+                  << " sleeps, " << metrics[i].queue_depth << " queued" << std::endl;
+#ifdef ADAMANT_PROFILING
+        std::cout << "    idle: " << metrics[i].idle_time / 1000000.0 << " ms, fiber switches: "
+                  << metrics[i].fiber_switches << std::endl;
+        const char* names[] = {"low", "medium", "high"};
+        for (auto p=0; p<=high; p++) {
+            const LatencyHistogram& latency = metrics[i].wait_latencies[p];
+            std::cout << "    " << names[p] << " wait to start: " << latency.getCount()
+                      << " jobs, p50 < " << latency.getPercentile(0.5) << " ns, p99 < "
+                      << latency.getPercentile(0.99) << " ns" << std::endl;
+        }
+#endif
+    }
+#ifdef ADAMANT_PROFILING
+    // To be loaded in chrome://tracing or Perfetto
+    std::ofstream trace("job_scheduler_trace.json");
+    Tracer::dump(trace);
+#endif
     std::cout << "\nFinishing...\n\n";
     lock.unlock();
 
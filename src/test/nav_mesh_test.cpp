@@ -6,9 +6,18 @@
 
 #include <vector>
 #include <thread>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
 #include <SFML/Graphics.hpp>
 #include "../core/graphics/nav_mesh.hpp"
 #include "../core/logic/elements/terrain.hpp"
+#include "box_map.hpp"
 
 using namespace adamant::logic::elements;
 using namespace adamant::graphics;
@@ -27,21 +36,22 @@ void drawTerrain(sf::RenderWindow& window, std::vector<Terrain*> terrains) {
     }
 }
 
-void drawNodes(sf::RenderWindow& window, std::vector<Node*> nodes) {
-    for (Node* n : nodes) {
+void drawNodes(sf::RenderWindow& window, std::vector<Coord> nodes) {
+    for (Coord n : nodes) {
         sf::CircleShape s = sf::CircleShape(5.0);
-        s.setPosition(n->coord.x, n->coord.y);
+        s.setPosition(n.x, n.y);
         s.setFillColor(sf::Color::Green);
         window.draw(s);
     }
 }
 
-void drawTriangle(sf::RenderWindow& window, Triangle* t, sf::Color outline_color) {
-    std::vector<Node*> nodes = t->nodes;
+void drawTriangle(sf::RenderWindow& window, const TriangleMesh& mesh, uint32_t t,
+        sf::Color outline_color) {
     sf::ConvexShape convex;
-    convex.setPointCount(nodes.size());
-    for (auto i=0; i<nodes.size(); i++) {
-        convex.setPoint(i, sf::Vector2f(nodes[i]->coord.x, nodes[i]->coord.y));
+    convex.setPointCount(3);
+    for (auto i=0; i<3; i++) {
+        Coord coord = mesh.getVertex(mesh.getOrigin(3 * t + i));
+        convex.setPoint(i, sf::Vector2f(coord.x, coord.y));
     }
     convex.setFillColor(sf::Color::Transparent);
     convex.setOutlineColor(outline_color);
@@ -49,14 +59,378 @@ void drawTriangle(sf::RenderWindow& window, Triangle* t, sf::Color outline_color
     window.draw(convex);
 }
 
-void drawNavMesh(sf::RenderWindow& window, TriangleMesh mesh) {
-    for (auto i=0; i<mesh.size(); i++) {
-        if (i == mesh.size()-1) drawTriangle(window, mesh[i], sf::Color::Red);
-        else drawTriangle(window, mesh[i], sf::Color::Green);
+void drawNavMesh(sf::RenderWindow& window, const TriangleMesh& mesh, std::size_t n_triangles) {
+    for (auto t=0; t<n_triangles; t++) {
+        if (mesh.isBlocked(t)) continue;
+        if (t == n_triangles-1) drawTriangle(window, mesh, t, sf::Color::Red);
+        else drawTriangle(window, mesh, t, sf::Color::Green);
     }
 }
 
+// Smallest angle of the triangle, in degrees
+double minAngle(const TriangleMesh& mesh, uint32_t t) {
+    double min = 180;
+    for (auto i=0; i<3; i++) {
+        Coord a = mesh.getVertex(mesh.getOrigin(3 * t + i));
+        Coord b = mesh.getVertex(mesh.getOrigin(3 * t + (i + 1) % 3));
+        Coord c = mesh.getVertex(mesh.getOrigin(3 * t + (i + 2) % 3));
+        double angle = std::abs(std::atan2(TriangleMesh::orientation(a, b, c),
+                (double) (b.x - a.x) * (c.x - a.x) + (double) (b.y - a.y) * (c.y - a.y)));
+        min = std::min(min, angle * 180 / M_PI);
+    }
+    return min;
+}
+
+/* Walkable triangles labelled unlike a neighbour they connect to, plus components whose
+ * triangles do not all reach each other. The number of components is left in the argument */
+std::size_t countMislabelled(const NavMesh& nav_mesh, std::size_t& n_components) {
+    const TriangleMesh& mesh = nav_mesh.getMesh();
+    auto crossable = [&mesh](uint32_t e) {
+        uint32_t f = mesh.getTwin(e);
+        return f != TriangleMesh::none && !mesh.isConstrained(e) &&
+               !mesh.isBlocked(TriangleMesh::triangleOf(f));
+    };
+    std::size_t n_mislabelled = 0;
+    std::unordered_map<uint32_t, std::size_t> sizes;
+    std::unordered_map<uint32_t, uint32_t> seeds;
+    for (uint32_t t=0; t<mesh.getNTriangles(); t++) {
+        uint32_t component = nav_mesh.getComponent(t);
+        if (mesh.isBlocked(t) != (component == TriangleMesh::none)) n_mislabelled++;
+        if (mesh.isBlocked(t)) continue;
+        sizes[component]++;
+        seeds.emplace(component, t);
+        for (auto i=0; i<3; i++) {
+            if (!crossable(3 * t + i)) continue;
+            uint32_t neighbour = TriangleMesh::triangleOf(mesh.getTwin(3 * t + i));
+            if (nav_mesh.getComponent(neighbour) != component) n_mislabelled++;
+        }
+    }
+    std::vector<bool> reached(mesh.getNTriangles(), false);
+    for (auto [component, seed] : seeds) {
+        std::vector<uint32_t> pending = {seed};
+        std::size_t n_reached = 1;
+        reached[seed] = true;
+        while (!pending.empty()) {
+            uint32_t t = pending.back();
+            pending.pop_back();
+            for (auto i=0; i<3; i++) {
+                if (!crossable(3 * t + i)) continue;
+                uint32_t neighbour = TriangleMesh::triangleOf(mesh.getTwin(3 * t + i));
+                if (reached[neighbour]) continue;
+                reached[neighbour] = true;
+                n_reached++;
+                pending.push_back(neighbour);
+            }
+        }
+        if (n_reached != sizes[component]) n_mislabelled++;
+    }
+    n_components = seeds.size();
+    return n_mislabelled;
+}
+
+// Corners of a box terrain, its nodes being sorted around its center
+std::pair<Coord, Coord> boxOf(Terrain* t) {
+    Coord a = t->getShape()->nodes[0]->coord, b = t->getShape()->nodes[2]->coord;
+    return {{std::min(a.x, b.x), std::min(a.y, b.y)}, {std::max(a.x, b.x), std::max(a.y, b.y)}};
+}
+
+/* Whether the segment goes through the inside of the box, given by two corners, by clipping it
+ * to it (Liang-Barsky), and not only along or across its border */
+bool crosses(Coord min, Coord max, Coord a, Coord b) {
+    double t_0 = 0, t_1 = 1;
+    double d[2] = {(double) (b.x - a.x), (double) (b.y - a.y)};
+    double lows[2] = {(double) (min.x - a.x), (double) (min.y - a.y)};
+    double highs[2] = {(double) (max.x - a.x), (double) (max.y - a.y)};
+    for (auto i=0; i<2; i++) {
+        if (d[i] == 0) {
+            if (lows[i] >= 0 || highs[i] <= 0) return false;
+            continue;
+        }
+        double t_low = lows[i] / d[i], t_high = highs[i] / d[i];
+        if (t_low > t_high) std::swap(t_low, t_high);
+        t_0 = std::max(t_0, t_low);
+        t_1 = std::min(t_1, t_high);
+    }
+    return t_0 < t_1;
+}
+
+// Build time and triangle quality on a grid of random boxes
+void benchmark(int_least16_t n_cells) {
+    BoxMap map(n_cells);
+    map.addGrid();
+    int_least16_t size = map.getSize().x;
+    std::vector<Terrain*> terrains = map.getTerrains();  // Without the obstacles added later
+    auto start = std::chrono::high_resolution_clock::now();
+    NavMesh nav_mesh(terrains, map.getSize());
+    auto end = std::chrono::high_resolution_clock::now();
+    const TriangleMesh& mesh = nav_mesh.getMesh();
+    double angle_sum = 0;
+    std::size_t n_skinny = 0;
+    for (auto t=0; t<mesh.getNTriangles(); t++) {
+        double angle = minAngle(mesh, t);
+        angle_sum += angle;
+        if (angle < 10) n_skinny++;
+    }
+    std::cout << mesh.getNVertices() << " vertices: "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms, "
+              << mesh.getNTriangles() << " triangles, " << mesh.getNIllegalEdges()
+              << " illegal edges, " << angle_sum / mesh.getNTriangles()
+              << " mean min angle, " << n_skinny << " under 10 degrees" << std::endl;
+
+    // Baked and mapped again, with the same arrays
+    const char* path = "nav_mesh_test.bin";
+    nav_mesh.bake(path);
+    start = std::chrono::high_resolution_clock::now();
+    NavMesh loaded(path);
+    end = std::chrono::high_resolution_clock::now();
+    std::remove(path);  // Still mapped
+    const TriangleMesh::Arrays& baked = mesh.getArrays();
+    const TriangleMesh::Arrays& mapped = loaded.getMesh().getArrays();
+    std::size_t n_vertices = baked.n_vertices, n_half_edges = 3 * baked.n_triangles;
+    bool identical = mapped.n_vertices == n_vertices && mapped.n_triangles == baked.n_triangles &&
+            std::memcmp(mapped.xs, baked.xs, n_vertices * sizeof(int_least16_t)) == 0 &&
+            std::memcmp(mapped.ys, baked.ys, n_vertices * sizeof(int_least16_t)) == 0 &&
+            std::memcmp(mapped.vertex_edges, baked.vertex_edges, n_vertices * 4) == 0 &&
+            std::memcmp(mapped.origins, baked.origins, n_half_edges * 4) == 0 &&
+            std::memcmp(mapped.twins, baked.twins, n_half_edges * 4) == 0 &&
+            std::memcmp(mapped.flags, baked.flags, baked.n_triangles) == 0;
+    for (uint32_t t=0; t<baked.n_triangles && identical; t++) {
+        identical = loaded.getComponent(t) == nav_mesh.getComponent(t);
+    }
+    std::cout << "Loaded in " << std::chrono::duration<double, std::micro>(end - start).count()
+              << " us, " << (identical ? "identical" : "DIFFERENT") << std::endl;
+
+    // Small obstacles in the free space between cells, added to the loaded one at runtime
+    std::vector<Terrain*> obstacles = map.addDiagonal();
+    double first_insert = 0, insert_max = 0, remove_max = 0;
+    std::size_t n_changed = 0, n_components = 0;
+    for (auto t : obstacles) {
+        start = std::chrono::high_resolution_clock::now();
+        n_changed += loaded.insertObstacle(t).size();
+        end = std::chrono::high_resolution_clock::now();
+        double elapsed = std::chrono::duration<double, std::micro>(end - start).count();
+        // The first one copies the mapped mesh
+        if (t == obstacles.front()) first_insert = elapsed;
+        else insert_max = std::max(insert_max, elapsed);
+    }
+    for (auto t : obstacles) {
+        start = std::chrono::high_resolution_clock::now();
+        loaded.removeObstacle(t);
+        end = std::chrono::high_resolution_clock::now();
+        remove_max = std::max(remove_max,
+                std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    std::cout << obstacles.size() << " obstacles: " << first_insert << " us to insert the first, "
+              << insert_max << " us max to insert, "
+              << remove_max << " us max to remove, " << (double) n_changed / obstacles.size()
+              << " triangles changed each, " << loaded.getMesh().getNIllegalEdges()
+              << " illegal edges, " << loaded.getMesh().getNTriangles() << " triangles left, "
+              << countMislabelled(loaded, n_components) << " mislabelled in " << n_components
+              << " components" << std::endl;
+
+    // Units spread over the map, located at once, and each checked to be within its triangle
+    const TriangleMesh& updated = loaded.getMesh();
+    std::vector<Coord> units;
+    for (auto i=0; i<10000; i++) {
+        units.push_back({rand() % (size + 1), rand() % (size + 1)});
+    }
+    std::vector<uint32_t> triangles;
+    start = std::chrono::high_resolution_clock::now();
+    loaded.findTriangles(units, triangles);
+    end = std::chrono::high_resolution_clock::now();
+    std::size_t n_wrong = 0;
+    for (auto i=0; i<units.size(); i++) {
+        uint32_t t = triangles[i];
+        bool within = t != TriangleMesh::none && t == loaded.findTriangle(units[i]);
+        for (auto j=0; j<3 && within; j++) {
+            within = TriangleMesh::orientation(updated.getVertex(updated.getOrigin(3 * t + j)),
+                    updated.getVertex(updated.getTarget(3 * t + j)), units[i]) >= 0;
+        }
+        if (!within) n_wrong++;
+    }
+    std::cout << units.size() << " units located in "
+              << std::chrono::duration<double, std::micro>(end - start).count() << " us, "
+              << n_wrong << " wrong" << std::endl;
+
+    /* Rays fanned out by casters, within a skillshot's range, walked through the mesh one by
+     * one and at once, against testing every one against every box */
+    std::vector<Ray> rays;
+    for (auto i=0; i<10000; i++) {
+        Coord from = units[i / 100 * 100];
+        Coord to = {std::clamp<int_fast16_t>(from.x + rand() % 601 - 300, 0, size),
+                    std::clamp<int_fast16_t>(from.y + rand() % 601 - 300, 0, size)};
+        rays.push_back({from, to});
+    }
+    std::vector<RayHit> hits;
+    start = std::chrono::high_resolution_clock::now();
+    for (const Ray& ray : rays) {
+        nav_mesh.raycast(ray.from, ray.to);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double one_us = std::chrono::duration<double, std::micro>(end - start).count();
+    start = std::chrono::high_resolution_clock::now();
+    nav_mesh.raycast(rays, hits);
+    end = std::chrono::high_resolution_clock::now();
+    double batch_us = std::chrono::duration<double, std::micro>(end - start).count();
+    std::vector<bool> blocked(rays.size(), false);
+    start = std::chrono::high_resolution_clock::now();
+    for (auto i=0; i<rays.size(); i++) {
+        for (auto t : terrains) {
+            auto [min, max] = boxOf(t);
+            if (crosses(min, max, rays[i].from, rays[i].to)) {
+                blocked[i] = true;
+                break;
+            }
+        }
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double brute_us = std::chrono::duration<double, std::micro>(end - start).count();
+    std::size_t n_blocked = 0, n_disagreeing = 0, n_off = 0;
+    for (auto i=0; i<rays.size(); i++) {
+        if (hits[i].blocked) n_blocked++;
+        if (hits[i].blocked != blocked[i]) n_disagreeing++;
+        // Short of the hit, the ray is clear, unless cast from within a box
+        Coord from = rays[i].from, point = hits[i].point;
+        if (hits[i].blocked && (point.x != from.x || point.y != from.y)) {
+            for (auto t : terrains) {
+                auto [min, max] = boxOf(t);
+                if (!crosses({min.x + 1, min.y + 1}, {max.x - 1, max.y - 1}, from, point)) {
+                    continue;
+                }
+                n_off++;
+                break;
+            }
+        }
+    }
+    std::cout << rays.size() << " rays cast in " << one_us << " us, " << batch_us
+              << " us at once, " << brute_us << " us against every box, " << n_blocked
+              << " blocked, " << n_disagreeing << " disagreeing, " << n_off
+              << " hitting past a box" << std::endl;
+}
+
+/* Walls across the whole map between rows of random boxes, each splitting a component in two
+ * as it is inserted, and joining them again as it is removed */
+void splitComponents(int_least16_t n_cells) {
+    BoxMap map(n_cells);
+    map.addGrid();
+    NavMesh nav_mesh(map.getTerrains(), map.getSize());
+    int_least16_t size = map.getSize().x;
+    std::vector<Terrain*> walls;
+    std::size_t n_mislabelled = 0, n_components = 0, n_expected = 1;
+    double insert_max = 0, remove_max = 0;
+    for (auto y=40 * (n_cells / 4); y<size; y+=40 * (n_cells / 4)) {
+        walls.push_back(map.addBox(0, y, size, y+3));
+        auto start = std::chrono::high_resolution_clock::now();
+        nav_mesh.insertObstacle(walls.back());
+        auto end = std::chrono::high_resolution_clock::now();
+        insert_max = std::max(insert_max,
+                std::chrono::duration<double, std::micro>(end - start).count());
+        n_mislabelled += countMislabelled(nav_mesh, n_components);
+        if (n_components != ++n_expected) n_mislabelled++;
+    }
+    for (auto t : walls) {
+        auto start = std::chrono::high_resolution_clock::now();
+        nav_mesh.removeObstacle(t);
+        auto end = std::chrono::high_resolution_clock::now();
+        remove_max = std::max(remove_max,
+                std::chrono::duration<double, std::micro>(end - start).count());
+        n_mislabelled += countMislabelled(nav_mesh, n_components);
+        if (n_components != --n_expected) n_mislabelled++;
+    }
+    std::cout << walls.size() << " walls across " << nav_mesh.getMesh().getNTriangles()
+              << " triangles: " << insert_max << " us max to insert, " << remove_max
+              << " us max to remove, " << n_mislabelled << " mislabelled" << std::endl;
+}
+
+/* Rays through the corners and along the sides of a box, both ways, which the walk passes
+ * through vertices for */
+void raycastCorners() {
+    BoxMap map(5);
+    map.addBox(50, 50, 100, 100);
+    NavMesh nav_mesh(map.getTerrains(), map.getSize());
+    typedef struct Case {
+        Ray ray;
+        bool blocked;
+        Coord point;
+    } Case;
+    std::vector<Case> cases = {
+        {{{10, 10}, {150, 150}}, true, {50, 50}},  // Diagonal, through two corners
+        {{{150, 150}, {10, 10}}, true, {100, 100}},
+        {{{50, 50}, {90, 90}}, true, {50, 50}},  // From a corner, into the box
+        {{{50, 50}, {150, 100}}, true, {50, 50}},
+        {{{100, 100}, {10, 10}}, true, {100, 100}},
+        {{{50, 50}, {0, 0}}, false, {0, 0}},  // From a corner, away from the box
+        {{{0, 100}, {100, 0}}, false, {100, 0}},  // Grazing a corner
+        {{{100, 0}, {0, 100}}, false, {0, 100}},
+        {{{50, 20}, {50, 150}}, false, {50, 150}},  // Along a side
+        {{{50, 150}, {50, 20}}, false, {50, 20}},
+        {{{150, 50}, {0, 50}}, false, {0, 50}},
+        {{{0, 75}, {200, 75}}, true, {50, 75}},  // Across the box
+        {{{200, 75}, {0, 75}}, true, {100, 75}},
+        {{{75, 75}, {150, 150}}, true, {75, 75}},  // From within it
+        {{{20, 180}, {180, 20}}, false, {180, 20}},
+        {{{0, 25}, {150, 100}}, true, {50, 50}},  // Through a corner, off the diagonal
+        {{{150, 125}, {0, 50}}, true, {100, 100}}
+    };
+    std::vector<Ray> rays;
+    for (const Case& c : cases) {
+        rays.push_back(c.ray);
+    }
+    std::vector<RayHit> hits;
+    nav_mesh.raycast(rays, hits);
+    std::size_t n_wrong = 0;
+    for (auto i=0; i<cases.size(); i++) {
+        RayHit hit = nav_mesh.raycast(rays[i].from, rays[i].to);
+        bool right = hit.blocked == cases[i].blocked && hit.point.x == cases[i].point.x &&
+                     hit.point.y == cases[i].point.y && hit.blocked == hits[i].blocked &&
+                     hit.point.x == hits[i].point.x && hit.point.y == hits[i].point.y;
+        if (!right) n_wrong++;
+    }
+    std::cout << cases.size() << " rays through corners, " << n_wrong << " wrong" << std::endl;
+}
+
+/* Obstacles against terrain, inserted and removed. One overlapping it is ignored, so removing
+ * it leaves the mesh as it was. One touching it is inserted, and walkable again once removed,
+ * though its vertices on the side of the terrain are kept */
+void overlapping() {
+    BoxMap map(10);
+    map.addBox(100, 100, 200, 200);
+    NavMesh nav_mesh(map.getTerrains(), map.getSize());
+    const TriangleMesh& mesh = nav_mesh.getMesh();
+    std::size_t n_triangles = mesh.getNTriangles(), n_vertices = mesh.getNVertices();
+    Coord inside = {230, 150};
+    auto isBlocked = [&nav_mesh, inside]() {
+        return nav_mesh.getComponent(nav_mesh.findTriangle(inside)) == TriangleMesh::none;
+    };
+
+    Terrain* overlapping = map.addBox(150, 120, 250, 180);
+    std::size_t n_changed = nav_mesh.insertObstacle(overlapping).size();
+    bool blocked = isBlocked();
+    n_changed += nav_mesh.removeObstacle(overlapping).size();
+    bool same = mesh.getNTriangles() == n_triangles && mesh.getNVertices() == n_vertices;
+    std::cout << "Overlapping: " << n_changed << " triangles changed, "
+              << (blocked ? "" : "not ") << "blocked, " << (same ? "same" : "DIFFERENT")
+              << " mesh once removed" << std::endl;
+
+    Terrain* touching = map.addBox(200, 120, 250, 180);
+    n_changed = nav_mesh.insertObstacle(touching).size();
+    blocked = isBlocked();
+    nav_mesh.removeObstacle(touching);
+    std::cout << "Touching: " << n_changed << " triangles changed, " << (blocked ? "" : "NOT ")
+              << "blocked, " << (isBlocked() ? "still blocked" : "walkable") << " once removed"
+              << std::endl;
+}
+
 int main() {
+    benchmark(10);
+    benchmark(40);
+    benchmark(112);
+    splitComponents(10);
+    splitComponents(40);
+    splitComponents(112);
+    raycastCorners();
+    overlapping();
+
     MapSize map_size = {750, 750};
     std::vector<Terrain*> terrains;
 
@@ -105,11 +479,11 @@ int main() {
     sf::RenderWindow window(sf::VideoMode(map_size.x, map_size.y), "Loading...");
     while (window.isOpen()) {
         // Display naked map for a few seconds
-        std::vector<Node*> nodes;
+        std::vector<Coord> nodes;
         drawTerrain(window, terrains);
         for (auto t : terrains) {
             for (auto n : t->getShape()->nodes) {
-                nodes.push_back(n);
+                nodes.push_back(n->coord);
             }
         }
         drawNodes(window, nodes);
@@ -128,11 +502,13 @@ int main() {
         }
 
         // Display triangulation
-        std::vector<Triangle*> mesh = nav_mesh->getMesh();
-        for (auto i=0; i<mesh.size(); i++) {
+        const TriangleMesh& mesh = nav_mesh->getMesh();
+        std::cout << mesh.getNTriangles() << " triangles, " << mesh.getNVertices()
+                  << " vertices, " << mesh.getMemoryUsage() << " bytes" << std::endl;
+        for (auto i=0; i<mesh.getNTriangles(); i++) {
             window.clear();
             drawTerrain(window, terrains);
-            drawNavMesh(window, std::vector<Triangle*>(mesh.begin(), mesh.begin() + i+1));
+            drawNavMesh(window, mesh, i+1);
             /* drawNodes(window, nav_mesh->getNodes()); */
             window.display();
             std::this_thread::sleep_for(std::chrono::milliseconds(50));
@@ -0,0 +1,337 @@
+/**
+ * Copyright (C) Sergio Hernandez - All Rights Reserved
+ * Author: Sergio Hernandez <contact.sergiohernandez@gmail.com>
+ * Date  : 30.07.2020
+ */
+
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include "../core/graphics/nav_mesh.hpp"
+#include "../core/physics/path_finder.hpp"
+#include "../core/physics/cluster_graph.hpp"
+#include "../core/physics/landmarks.hpp"
+#include "../core/logic/elements/terrain.hpp"
+#include "../core/concurrency/job_scheduler.hpp"
+#include "box_map.hpp"
+
+using namespace adamant::logic::elements;
+using namespace adamant::graphics;
+using namespace adamant::graphics::elements;
+using namespace adamant::physics::movement;
+using namespace adamant::concurrency;
+
+/* Queries per second, and how the paths found compare to the straight line. Given a scheduler,
+ * the queries are made in batches of 200 */
+void measure(PathFinder& path_finder, const std::vector<Coord>& starts,
+        const std::vector<Coord>& targets, const BoxMap& map, const char* name,
+        JobScheduler* scheduler = nullptr) {
+    std::size_t n_queries = starts.size();
+    path_finder.resetCounters();
+    std::vector<Path> paths(n_queries);
+    std::vector<PathRequest> requests(n_queries);
+    for (auto i=0; i<n_queries; i++) {
+        requests[i] = {starts[i], targets[i]};
+    }
+    const std::size_t batch_size = 200;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto i=0; i<n_queries && scheduler == nullptr; i++) {
+        paths[i] = path_finder.findPath(starts[i], targets[i]);
+    }
+    for (auto i=0; i<n_queries && scheduler != nullptr; i+=batch_size) {
+        std::size_t n = std::min(batch_size, n_queries - i);
+        path_finder.findPaths(scheduler, {requests.data() + i, n}, {paths.data() + i, n});
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    // Every move is checked for going through a box, and every path for being connected
+    std::size_t n_moves = 0, n_blocked = 0, n_broken = 0, n_empty = 0;
+    double stretch = 0;
+    for (auto i=0; i<n_queries; i++) {
+        Path& path = paths[i];
+        if (path.empty()) {
+            if (starts[i].x != targets[i].x || starts[i].y != targets[i].y) n_empty++;
+            continue;
+        }
+        n_moves += path.size();
+        float length = 0;
+        Coord previous = starts[i];
+        bool blocked = false;
+        for (Move& move : path) {
+            if (move.start.x != previous.x || move.start.y != previous.y) n_broken++;
+            previous = move.target;
+            length += move.distance;
+            for (float d=0; d<=move.distance && !blocked; d+=0.25) {
+                float x = move.start.x + move.unit_travel[0] * d;
+                float y = move.start.y + move.unit_travel[1] * d;
+                blocked = map.isBlocked(x, y);
+            }
+        }
+        if (previous.x != targets[i].x || previous.y != targets[i].y) n_broken++;
+        if (blocked) n_blocked++;
+        stretch += length / std::hypot(targets[i].x - starts[i].x, targets[i].y - starts[i].y);
+    }
+    std::cout << "  " << name << ": " << n_queries / seconds << " queries per second, "
+              << (double) n_moves / n_queries << " moves each, " << stretch / n_queries
+              << " times the straight distance, "
+              << (double) path_finder.getNExpanded() / n_queries << " triangles expanded each, "
+              << n_blocked << " through terrain, "
+              << n_broken << " broken, " << n_empty << " not found";
+    std::size_t n_lookups = path_finder.getCacheHits() + path_finder.getCacheMisses();
+    if (n_lookups > 0) {
+        std::cout << ", " << 100.0 * path_finder.getCacheHits() / n_lookups << "% cache hits";
+    }
+    std::cout << std::endl;
+}
+
+/* Between random walkable points of a grid of random boxes, flat and hierarchical, and then
+ * cached, between a few of them over and over */
+void benchmark(JobScheduler* scheduler, int_least16_t n_cells, std::size_t n_queries) {
+    BoxMap map(n_cells);
+    map.addGrid();
+    NavMesh nav_mesh(map.getTerrains(), map.getSize());
+    const TriangleMesh& mesh = nav_mesh.getMesh();
+    std::vector<Coord> starts, targets;
+    for (auto i=0; i<n_queries; i++) {
+        starts.push_back(findWalkable(nav_mesh));
+        targets.push_back(findWalkable(nav_mesh));
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    ClusterGraph clusters(&nav_mesh);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << mesh.getNTriangles() << " triangles, " << clusters.getNClusters()
+              << " clusters, " << clusters.getNEntrances() << " entrances, built in "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+              << std::endl;
+    PathFinder path_finder(&nav_mesh, &clusters);
+    path_finder.setCacheSize(0);
+    path_finder.setHierarchical(false);
+    measure(path_finder, starts, targets, map, "Flat");
+    Landmarks landmarks(&nav_mesh);
+    path_finder.setLandmarks(&landmarks);
+    measure(path_finder, starts, targets, map, "Flat, landmarks");
+    path_finder.setLandmarks(nullptr);
+    path_finder.setHierarchical(true);
+    measure(path_finder, starts, targets, map, "Hierarchical");
+    measure(path_finder, starts, targets, map, "Hierarchical, batched", scheduler);
+    std::vector<Coord> repeated_starts, repeated_targets;
+    for (auto i=0; i<n_queries; i++) {
+        int k = rand() % 100;
+        repeated_starts.push_back(starts[k]);
+        repeated_targets.push_back(targets[k]);
+    }
+    path_finder.setCacheSize(256);
+    measure(path_finder, repeated_starts, repeated_targets, map, "Cached");
+    /* Emptied, so that batches repeat the start and goal triangles of the misses, from other
+     * points of them, which may find other corridors, before the cache is invalidated */
+    auto nearby = [&nav_mesh, &mesh](Coord c) {
+        uint32_t t = nav_mesh.findTriangle(c);
+        for (auto i=0; i<20; i++) {
+            int weights[3] = {1 + rand() % 10, 1 + rand() % 10, 1 + rand() % 10};
+            int x = 0, y = 0, total = weights[0] + weights[1] + weights[2];
+            for (auto k=0; k<3; k++) {
+                x += weights[k] * mesh.getX(mesh.getOrigin(3 * t + k));
+                y += weights[k] * mesh.getY(mesh.getOrigin(3 * t + k));
+            }
+            Coord d = {x / total, y / total};
+            if (nav_mesh.findTriangle(d) == t) return d;
+        }
+        return c;
+    };
+    std::vector<Coord> nearby_starts, nearby_targets;
+    for (auto i=0; i<n_queries; i++) {
+        nearby_starts.push_back(nearby(repeated_starts[i]));
+        nearby_targets.push_back(nearby(repeated_targets[i]));
+    }
+    path_finder.setCacheSize(0);
+    path_finder.setCacheSize(256);
+    measure(path_finder, nearby_starts, nearby_targets, map, "Cached, batched",
+            scheduler);
+
+    // Into a box
+    const Box& box = map.getFirstBox();
+    Coord inside = {(box.x_1 + box.x_2) / 2, (box.y_1 + box.y_2) / 2};
+    if (!path_finder.findPath(starts[0], inside).empty()) {
+        std::cout << "Found a path into terrain" << std::endl;
+    }
+
+    // Updated along with the nav mesh, the graph is the same as if built again
+    auto compare = [&nav_mesh, &clusters]() {
+        ClusterGraph rebuilt(&nav_mesh, clusters.getClusterSize());
+        bool same = rebuilt.getNEntrances() == clusters.getNEntrances();
+        for (uint32_t c=0; c<clusters.getNClusters() && same; c++) {
+            std::size_t n = clusters.getEntrances(c).size();
+            same = n == rebuilt.getEntrances(c).size();
+            for (uint32_t i=0; i<n * n && same; i++) {
+                same = clusters.getCost(c, i / n, i % n) == rebuilt.getCost(c, i / n, i % n);
+            }
+        }
+        return same ? "same as rebuilt" : "DIFFERENT FROM REBUILT";
+    };
+    std::vector<Terrain*> obstacles = map.addDiagonal();
+    double update_max = 0;
+    for (auto t : obstacles) {
+        std::vector<uint32_t> changed = nav_mesh.insertObstacle(t);
+        start = std::chrono::high_resolution_clock::now();
+        clusters.update(changed);
+        end = std::chrono::high_resolution_clock::now();
+        update_max = std::max(update_max,
+                std::chrono::duration<double, std::micro>(end - start).count());
+        path_finder.invalidate(changed);
+    }
+    std::cout << "  " << obstacles.size() << " obstacles: " << update_max
+              << " us max to update, " << compare() << std::endl;
+    // Only the paths through the obstacles are found again
+    measure(path_finder, repeated_starts, repeated_targets, map, "Cached, updated");
+
+    // Removing them shrinks the mesh
+    update_max = 0;
+    for (auto t : obstacles) {
+        std::vector<uint32_t> changed = nav_mesh.removeObstacle(t);
+        start = std::chrono::high_resolution_clock::now();
+        clusters.update(changed);
+        end = std::chrono::high_resolution_clock::now();
+        update_max = std::max(update_max,
+                std::chrono::duration<double, std::micro>(end - start).count());
+        path_finder.invalidate(changed);
+    }
+    std::cout << "  Removed: " << update_max << " us max to update, " << compare()
+              << std::endl;
+}
+
+/* Between random walkable points of a map crossed by long walls, each open at the opposite end
+ * of the one before, with random pillars between them, with and without landmarks */
+void benchmarkWalls(int_least16_t n_cells, std::size_t n_queries) {
+    BoxMap map(n_cells);
+    MapSize map_size = map.getSize();
+    srand(0);
+    for (auto y=80, i=0; y<map_size.y; y+=80, i++) {
+        int x_1 = i % 2 == 0 ? 0 : 80, x_2 = i % 2 == 0 ? map_size.x - 80 : map_size.x;
+        map.addBox(x_1, y, x_2, y+8);
+    }
+    for (auto x=0; x<map_size.x; x+=40) {
+        for (auto y=0; y<map_size.y; y+=40) {
+            int x_1 = x + 5 + rand() % 10, x_2 = x + 20 + rand() % 15;
+            int y_1 = y + 15 + rand() % 5, y_2 = y + 25 + rand() % 10;
+            map.addBox(x_1, y_1, x_2, y_2);
+        }
+    }
+    NavMesh nav_mesh(map.getTerrains(), map_size);
+    const TriangleMesh& mesh = nav_mesh.getMesh();
+    std::vector<Coord> starts, targets;
+    for (auto i=0; i<n_queries; i++) {
+        starts.push_back(findWalkable(nav_mesh));
+        targets.push_back(findWalkable(nav_mesh));
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    Landmarks landmarks(&nav_mesh);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << mesh.getNTriangles() << " triangles with " << (map_size.y - 1) / 80
+              << " walls, "
+              << landmarks.getNLandmarks() << " landmarks, built in "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms, "
+              << landmarks.getSize() / 1024 << " KiB" << std::endl;
+    PathFinder path_finder(&nav_mesh);
+    path_finder.setCacheSize(0);
+    measure(path_finder, starts, targets, map, "Flat");
+    path_finder.setLandmarks(&landmarks);
+    measure(path_finder, starts, targets, map, "Flat, landmarks");
+}
+
+/* Between random walkable points of a grid of random boxes split in two by a wall across it,
+ * inserted at runtime, so that about half of the targets are unreachable. Without redirection
+ * they are rejected, and with it the paths end at the nearest points on the start's side */
+void benchmarkSplit(int_least16_t n_cells, std::size_t n_queries) {
+    BoxMap map(n_cells);
+    map.addGrid();
+    NavMesh nav_mesh(map.getTerrains(), map.getSize());
+    int_least16_t size = map.getSize().x;
+    int wall_y = 40 * (n_cells / 2);
+    nav_mesh.insertObstacle(map.addBox(0, wall_y, size, wall_y+3));
+    const TriangleMesh& mesh = nav_mesh.getMesh();
+    // On its top border too, which is walkable from above
+    auto above = [wall_y](Coord c) {
+        return c.y <= wall_y;
+    };
+    std::vector<Coord> starts, targets;
+    std::size_t n_across = 0;
+    for (auto i=0; i<n_queries; i++) {
+        starts.push_back(findWalkable(nav_mesh));
+        targets.push_back(findWalkable(nav_mesh));
+        if (above(starts[i]) != above(targets[i])) n_across++;
+    }
+    std::cout << mesh.getNTriangles() << " triangles split by a wall, " << n_across << " of "
+              << n_queries << " targets across it" << std::endl;
+    PathFinder path_finder(&nav_mesh);
+    path_finder.setCacheSize(0);
+    measure(path_finder, starts, targets, map, "Rejected");
+
+    // Redirected paths are checked for staying on the start's side, and by how far they end
+    path_finder.setRedirection(true);
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<Path> paths;
+    for (auto i=0; i<n_queries; i++) {
+        paths.push_back(path_finder.findPath(starts[i], targets[i]));
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::size_t n_empty = 0, n_crossed = 0;
+    double off_max = 0;
+    for (auto i=0; i<n_queries; i++) {
+        if (paths[i].empty()) {
+            if (starts[i].x != targets[i].x || starts[i].y != targets[i].y) n_empty++;
+            continue;
+        }
+        Coord last = paths[i].back().target;
+        if ((last.y < wall_y + 2) != above(starts[i])) n_crossed++;
+        // Past the wall, the nearest point is on its side, right across
+        int wall_side = above(starts[i]) ? wall_y : wall_y + 3;
+        double off = std::hypot(last.x - targets[i].x, last.y - targets[i].y) -
+                     (above(starts[i]) != above(targets[i]) ?
+                      std::abs(targets[i].y - wall_side) : 0);
+        off_max = std::max(off_max, off);
+    }
+    std::cout << "  Redirected: " << n_queries / std::chrono::duration<double>(end - start).count()
+              << " queries per second, " << n_empty << " not found, " << n_crossed
+              << " ending across the wall, up to " << off_max
+              << " px further than the wall from the target" << std::endl;
+}
+
+// Between open ground and the borders of terrain and of an inserted obstacle, both ways
+void borders() {
+    BoxMap map(5);
+    map.addBox(80, 80, 120, 120);
+    NavMesh nav_mesh(map.getTerrains(), map.getSize());
+    nav_mesh.insertObstacle(map.addBox(40, 150, 60, 170));
+    PathFinder path_finder(&nav_mesh);
+    Coord open = {10, 10};
+    std::size_t n_paths = 0, n_empty = 0;
+    for (const Box& box : {Box{80, 80, 120, 120}, Box{40, 150, 60, 170}}) {
+        for (Coord c : getBorder(box)) {
+            if (path_finder.findPath(c, open).empty()) n_empty++;
+            if (path_finder.findPath(open, c).empty()) n_empty++;
+            n_paths += 2;
+        }
+    }
+    std::cout << n_paths << " paths from and to borders, " << n_empty << " not found"
+              << std::endl;
+}
+
+int main() {
+    JobScheduler* scheduler = new JobScheduler();
+    std::cout << scheduler->getNThreads() << " workers" << std::endl;
+    benchmark(scheduler, 10, 10000);
+    benchmark(scheduler, 40, 10000);
+    benchmark(scheduler, 112, 2000);
+    benchmarkWalls(40, 2000);
+    benchmarkWalls(112, 500);
+    benchmarkSplit(40, 2000);
+    benchmarkSplit(112, 500);
+    borders();
+    delete scheduler;
+    return 0;
+}